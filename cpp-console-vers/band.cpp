@@ -1,14 +1,23 @@
-// THE MARCHING DATABASE (v1.2.0) - SQLite + C++ console app 
+// THE MARCHING DATABASE (v1.2.0) - SQLite + C++ console app
 // Recent Updates: shirt/shoe sizes, uniforms sizes, etc
 //
+// This file is the console front-end: prompts, menus and report layout. All
+// database work goes through libbanddb (banddb.h / banddb.cpp).
+//
 // Compile (Linux/Mac):
-//   g++ band.cpp -o band -lsqlite3
+//   g++ -std=c++17 -pthread band.cpp banddb.cpp -o band -lsqlite3
+// or with the bundled sqlite3.c, built multi-thread (no global mutex around
+// the allocator either; --threading=serialized still works on this build):
+//   gcc -O2 -c -DSQLITE_THREADSAFE=2 -DSQLITE_DEFAULT_MEMSTATUS=0 sqlite3.c
+//   g++ -std=c++17 -O2 -pthread -I. band.cpp banddb.cpp sqlite3.o -o band -ldl
 //
 // Run:
-//   ./band
+//   ./band            (interactive menus)
+//   ./band <command>  (batch commands, ./band help lists them)
+
+#include "banddb.h"
 
 #include <cstdlib>
-#include <sqlite3.h>
 #include <iostream>
 #include <string>
 #include <limits>
@@ -16,257 +25,257 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <string_view>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
+using namespace banddb;
+
+static Database db;
+static StudentRepo students(db);
+static InventoryRepo inventory(db);
+static ComplianceRepo compliance(db);
+
+static void commitPoint();
+static void endOfInput();
+
+// ---------- Input ----------
+// Standard input is pulled in 64 KB blocks and handed out one line at a time,
+// with numbers parsed by from_chars. Every prompt consumes exactly one line,
+// whether someone is typing at the menus or a script is piping commands in.
+
+struct InputBuffer {
+    int fd = 0;
+    char data[1 << 16];
+    size_t pos = 0, len = 0;
+    bool eof = false;
+    string spill;     // holds a line that straddles two blocks
+};
+
+static InputBuffer stdinBuffer;
+
+// More input is buffered, or already waiting on the descriptor.
+static bool inputPending(const InputBuffer& in) {
+    if (in.pos < in.len) return true;
+    if (in.eof) return false;
+#ifdef _WIN32
+    return false;
+#else
+    pollfd p = {in.fd, POLLIN, 0};
+    return poll(&p, 1, 0) > 0 && (p.revents & POLLIN);
+#endif
+}
 
-sqlite3* db = nullptr;
+static bool fillInput(InputBuffer& in) {
+    if (in.eof) return false;
+    cout.flush();   // the prompt has to be on screen before we block
+#ifdef _WIN32
+    int n = _read(in.fd, in.data, (unsigned)sizeof(in.data));
+#else
+    ssize_t n;
+    do n = read(in.fd, in.data, sizeof(in.data)); while (n < 0 && errno == EINTR);
+#endif
+    in.pos = 0;
+    in.len = n > 0 ? (size_t)n : 0;
+    in.eof = n <= 0;
+    return n > 0;
+}
 
-static void clearInputLine() {
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+// The view stays valid until the next call on the same buffer.
+static bool nextLine(InputBuffer& in, string_view& line) {
+    in.spill.clear();
+    while (true) {
+        if (in.pos == in.len && !fillInput(in)) {
+            if (in.spill.empty()) return false;
+            line = in.spill;
+            break;
+        }
+        const char* start = in.data + in.pos;
+        size_t avail = in.len - in.pos;
+        const char* nl = (const char*)memchr(start, '\n', avail);
+        if (!nl) {
+            in.spill.append(start, avail);
+            in.pos = in.len;
+            continue;
+        }
+        in.pos += (size_t)(nl - start) + 1;
+        if (in.spill.empty()) {
+            line = string_view(start, (size_t)(nl - start));
+        } else {
+            in.spill.append(start, nl);
+            line = in.spill;
+        }
+        break;
+    }
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return true;
 }
 
-static string trim(const string& s) {
-    size_t a = 0, b = s.size();
-    while (a < b && isspace((unsigned char)s[a])) a++;
-    while (b > a && isspace((unsigned char)s[b - 1])) b--;
-    return s.substr(a, b - a);
+static string_view promptLine(const string& prompt) {
+    commitPoint();
+    cout << prompt;
+    string_view line;
+    if (!nextLine(stdinBuffer, line)) endOfInput();
+    return line;
 }
 
-static string upperCopy(string s) {
-    for (char& c : s) c = (char)toupper((unsigned char)c);
-    return s;
+static string readText(const string& prompt) {
+    return string(promptLine(prompt));
 }
 
 static int readIntInRange(const string& prompt, int lo, int hi) {
     while (true) {
-        cout << prompt;
         int x;
-        if (cin >> x) {
+        if (parseNumber(promptLine(prompt), x)) {
             if (x >= lo && x <= hi) return x;
             cout << "Nope. Enter " << lo << "-" << hi << ".\n";
         } else {
             cout << "Nope. Enter a number please!.\n";
-            cin.clear();
         }
-        clearInputLine();
     }
 }
 
+static int readInt(const string& prompt) {
+    return readIntInRange(prompt, numeric_limits<int>::min(), numeric_limits<int>::max());
+}
+
 static int readBool01(const string& prompt) {
     while (true) {
-        cout << prompt;
         int x;
-        if (cin >> x) {
-            if (x == 0 || x == 1) return x;
-            cout << "Nope. Enter 1 or 0, please.\n";
-        } else {
-            cout << "Nope. Enter 1 or 0, please.\n";
-            cin.clear();
-        }
-        clearInputLine();
+        if (parseNumber(promptLine(prompt), x) && (x == 0 || x == 1)) return x;
+        cout << "Nope. Enter 1 or 0, please.\n";
     }
 }
 
 static double readDoubleInRange(const string& prompt, double lo, double hi) {
     while (true) {
-        cout << prompt;
         double x;
-        if (cin >> x) {
+        if (parseNumber(promptLine(prompt), x)) {
             if (x >= lo && x <= hi) return x;
             cout << "Nope. Enter " << lo << "-" << hi << ".\n";
         } else {
             cout << "Nope. Enter a number.\n";
-            cin.clear();
         }
-        clearInputLine();
     }
 }
 
-static bool execSQL(const string& sql) {
-    char* errMsg = nullptr;
-    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
-    if (rc != SQLITE_OK) {
-        cout << "SQL error: " << (errMsg ? errMsg : "Unknown error") << "\n";
-        sqlite3_free(errMsg);
-        return false;
-    }
-    return true;
-}
-
-static const char* colText(sqlite3_stmt* s, int i) {
-    const unsigned char* t = sqlite3_column_text(s, i);
-    return t ? (const char*)t : "";
-}
-
-static bool studentExists(int studentId) {
-    const char* sql = "SELECT 1 FROM STUDENTS WHERE STUDENT_ID=?;";
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-    sqlite3_bind_int(stmt, 1, studentId);
-    bool ok = (sqlite3_step(stmt) == SQLITE_ROW);
-    sqlite3_finalize(stmt);
-    return ok;
-}
-
-static bool getStudentSection(int studentId, string& outSection) {
-    outSection = "";
-    const char* sql = "SELECT SECTION FROM STUDENTS WHERE STUDENT_ID=?;";
-    sqlite3_stmt* stmt = nullptr;
+static string readSectionValidated(const string& prompt) {
+    while (true) {
+        string s = upperCopy(string(trimView(promptLine(prompt))));
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-    sqlite3_bind_int(stmt, 1, studentId);
+        if (isValidSection(s)) return s;
 
-    bool ok = false;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        outSection = colText(stmt, 0);
-        ok = true;
+        cout << "Invalid selection. Please try again: WOODWIND, BRASS, PERCUSSION, AUXILIARY, DM.\n";
     }
-    sqlite3_finalize(stmt);
-
-    if (!ok) outSection = "";
-    return ok;
 }
 
-static bool columnExists(const string& table, const string& col) {
-    string sql = "PRAGMA table_info(" + table + ");";
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+static void printError() {
+    cout << db.lastError() << "\n";
+}
 
-    bool found = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        string name = colText(stmt, 1); 
-        if (upperCopy(name) == upperCopy(col)) {
-            found = true;
-            break;
+// ---------- Report cache ----------
+// Rendered report text is reused until the database changes. PRAGMA data_version
+// moves when another connection commits; total_changes moves on our own writes.
+struct ReportCache {
+    bool valid = false;
+    sqlite3_int64 dataVersion = 0;
+    sqlite3_int64 totalChanges = 0;
+    string text;
+};
+
+static void printCachedReport(ReportCache& cache, bool (*render)(ostream&)) {
+    sqlite3_int64 version = db.dataVersion();
+    sqlite3_int64 changes = db.totalChanges();
+
+    bool fresh = cache.valid && version != -1 &&
+                 cache.dataVersion == version && cache.totalChanges == changes;
+    if (!fresh) {
+        ostringstream out;
+        if (!render(out)) {
+            cache.valid = false;
+            return;
         }
+        cache.text = out.str();
+        cache.dataVersion = version;
+        cache.totalChanges = changes;
+        cache.valid = true;
     }
-    sqlite3_finalize(stmt);
-    return found;
+    cout << cache.text;
 }
 
-static string readSectionValidated(const string& prompt) {
-    static const vector<string> allowed = {"WOODWIND","BRASS","PERCUSSION","AUXILIARY","DM"};
-    while (true) {
-        cout << prompt;
-        string s;
-        getline(cin, s);
-        s = upperCopy(trim(s));
-
-        if (find(allowed.begin(), allowed.end(), s) != allowed.end()) return s;
+// ---------- Durability ----------
+// Chosen with --durability=NAME or BAND_DURABILITY, default "full"; checkpoints
+// with --checkpoint=passive|restart|truncate|off (or BAND_CHECKPOINT).
+//
+// Called before every prompt. With a commit interval, a write batch is opened only
+// while more input is already buffered (scripted or scanner-speed entry) and
+// committed once the interval is up or the input runs dry, so a person
+// typing at the menus still gets one commit per action.
+static void commitPoint() {
+    db.commitPoint(inputPending(stdinBuffer));
+}
 
-        cout << "Invalid selection. Please try again: WOODWIND, BRASS, PERCUSSION, AUXILIARY, DM.\n";
+static void showDatabaseStats() {
+    DatabaseStats st = db.stats();
+    const DurabilityProfile& p = *st.durability;
+    const CheckpointStats& cp = st.checkpoints;
+
+    cout << "\n--------- DATABASE STATS ---------\n";
+    cout << "Durability profile: " << p.name << " (synchronous=" << p.synchronous;
+    if (p.commitIntervalMs) cout << ", commits every " << p.commitIntervalMs << " ms";
+    cout << ")\n";
+    cout << "Bulk commits: " << describeCommitPolicy(st.commitPolicy) << "\n";
+    cout << "COMPLIANCE layout: " << complianceLayoutName(st.complianceLayout) << "\n";
+    cout << "Dates stored as: " << dateEncodingName(st.dateEncoding) << "\n";
+    cout << "Threading: " << threadingModeName(st.threading) << " (SQLITE_THREADSAFE=" << st.sqliteThreadsafe << ")\n";
+    cout << "Database file: " << st.databaseBytes << " bytes\n";
+    cout << "WAL file: " << st.walBytes << " bytes, " << st.walFramesPending << " frames pending\n";
+    cout << "Checkpoint mode: " << st.checkpointMode;
+    if (st.backgroundCheckpoints)
+        cout << " (background, at " << st.checkpointThresholdPages << " pages or every "
+             << st.checkpointIdleMs / 1000 << " s)";
+    cout << "\n";
+    cout << "Checkpoints this session: " << cp.runs << " (" << cp.busy << " skipped busy), "
+         << cp.framesCopied << " frames copied\n";
+    if (cp.runs) {
+        cout << fixed << setprecision(2)
+             << "Checkpoint time: last " << cp.lastMs << " ms, avg " << cp.totalMs / cp.runs
+             << " ms, max " << cp.maxMs << " ms\n";
     }
 }
 
-static void ensureTables() {
-    execSQL("PRAGMA foreign_keys = ON;");
-
-    execSQL(
-        "CREATE TABLE IF NOT EXISTS STUDENTS ("
-        "  STUDENT_ID INTEGER PRIMARY KEY,"
-        "  FNAME TEXT NOT NULL,"
-        "  LNAME TEXT NOT NULL,"
-        "  CLASSIFICATION TEXT,"  
-        "  SECTION TEXT NOT NULL "
-        "    CHECK (SECTION IN ('WOODWIND','BRASS','PERCUSSION','AUXILIARY','DM')),"
-        "  SHIRT_SIZE TEXT,"      
-        "  SHOE_SIZE TEXT"        
-        ");"
-    );
-
-    // COMPLIANCE table
-    execSQL(
-        "CREATE TABLE IF NOT EXISTS COMPLIANCE ("
-        "  STUDENT_ID INTEGER PRIMARY KEY,"
-        "  CREDIT_HOURS INTEGER NOT NULL DEFAULT 0 CHECK (CREDIT_HOURS >= 0),"
-        "  GPA REAL NOT NULL DEFAULT 0.0,"
-        "  DUES_PAID INTEGER NOT NULL DEFAULT 0 CHECK (DUES_PAID IN (0,1)),"
-        "  LAST_VERIFIED_DATE TEXT,"
-        "  FOREIGN KEY (STUDENT_ID) REFERENCES STUDENTS(STUDENT_ID) ON DELETE CASCADE"
-        ");"
-    );
-
-    
-    if (!columnExists("STUDENTS", "SHIRT_SIZE")) 
-        execSQL("ALTER TABLE STUDENTS ADD COLUMN SHIRT_SIZE TEXT;");
-    if (!columnExists("STUDENTS", "SHOE_SIZE")) 
-        execSQL("ALTER TABLE STUDENTS ADD COLUMN SHOE_SIZE TEXT;");
-    
-    if (!columnExists("UNIFORMS", "COAT_SIZE")) {
-        execSQL("DROP TABLE IF EXISTS UNIFORMS_OLD;");
-        execSQL("ALTER TABLE UNIFORMS RENAME TO UNIFORMS_OLD;");
-        
-        execSQL(
-            "CREATE TABLE UNIFORMS ("
-            "  UNIFORM_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
-            "  COAT_SIZE TEXT,"        
-            "  PANT_SIZE TEXT,"       
-            "  COAT_NUMBER TEXT,"      
-            "  PANT_NUMBER TEXT,"      
-            "  CONDITION_NOTES TEXT,"
-            "  CHECKED_OUT_TO INTEGER UNIQUE,"
-            "  CHECKED_OUT_DATE TEXT,"
-            "  FOREIGN KEY (CHECKED_OUT_TO) REFERENCES STUDENTS(STUDENT_ID)"
-            ");"
-        );
-        
-        execSQL("INSERT INTO UNIFORMS (UNIFORM_ID, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE) "
-                "SELECT UNIFORM_ID, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE "
-                "FROM UNIFORMS_OLD;");
-    }
-
-    execSQL(
-        "CREATE TABLE IF NOT EXISTS INSTRUMENT_TYPES ("
-        "  TYPE_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "  TYPE_NAME TEXT UNIQUE NOT NULL,"
-        "  SECTION TEXT NOT NULL CHECK (SECTION IN ('WOODWIND','BRASS','PERCUSSION','AUXILIARY','DM'))"
-        ");"
-    );
-
-    execSQL(
-        "CREATE TABLE IF NOT EXISTS INSTRUMENTS ("
-        "  INSTRUMENT_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "  TYPE_ID INTEGER NOT NULL,"
-        "  SERIAL TEXT UNIQUE,"
-        "  CONDITION_NOTES TEXT,"
-        "  CHECKED_OUT_TO INTEGER UNIQUE,"
-        "  CHECKED_OUT_DATE TEXT,"
-        "  FOREIGN KEY (TYPE_ID) REFERENCES INSTRUMENT_TYPES(TYPE_ID),"
-        "  FOREIGN KEY (CHECKED_OUT_TO) REFERENCES STUDENTS(STUDENT_ID)"
-        ");"
-    );
-
-    execSQL(
-        "CREATE TABLE IF NOT EXISTS SHAKOS ("
-        "  SHAKO_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "  SIZE TEXT,"
-        "  CONDITION_NOTES TEXT,"
-        "  CHECKED_OUT_TO INTEGER UNIQUE,"
-        "  CHECKED_OUT_DATE TEXT,"
-        "  FOREIGN KEY (CHECKED_OUT_TO) REFERENCES STUDENTS(STUDENT_ID)"
-        ");"
-    );
-
-    execSQL(
-        "CREATE TABLE IF NOT EXISTS SECTION_LEADERS ("
-        "  SECTION TEXT PRIMARY KEY CHECK (SECTION IN ('WOODWIND','BRASS','PERCUSSION','AUXILIARY','DM')),"
-        "  LEADER_STUDENT_ID INTEGER NOT NULL,"
-        "  FOREIGN KEY (LEADER_STUDENT_ID) REFERENCES STUDENTS(STUDENT_ID)"
-        ");"
-    );
-
-    execSQL(
-        "INSERT OR IGNORE INTO INSTRUMENT_TYPES (TYPE_NAME, SECTION) VALUES "
-        "('PICCOLO','WOODWIND'),"
-        "('CLARINET','WOODWIND'),"
-        "('SAXOPHONE','WOODWIND'),"
-        "('TRUMPET','BRASS'),"
-        "('TROMBONE','BRASS'),"
-        "('SOUSAPHONE','BRASS'),"
-        "('MELLOPHONE','BRASS'),"
-        "('PERCUSSION','PERCUSSION'),"
-        "('COLOR_GUARD','AUXILIARY');"
-    );
+// The journal is kept in UNDO_LOG, so a change made in one session (or by a
+// batch command) can still be undone from the next one.
+static bool undoLastChange(bool redoing) {
+    string label;
+    Outcome o = redoing ? db.undo().redo(label) : db.undo().undo(label);
+    switch (o) {
+        case Outcome::Done:
+            cout << (redoing ? "Redone: " : "Undone: ") << label << "\n";
+            return true;
+        case Outcome::NotFound:
+            cout << (redoing ? "Nothing to redo.\n" : "Nothing to undo.\n");
+            return true;
+        case Outcome::Failed: printError(); break;
+    }
+    return false;
 }
 
 static void studentsMenu();
@@ -280,6 +289,10 @@ static void addStudent();
 static void viewAllStudents();
 static void findStudentById();
 static void setSectionLeader();
+static void importRoster();
+static void showLeaderRollup();
+static void removeStudents();
+static void mergeStudents();
 
 // Instruments
 static void checkoutInstrument();
@@ -297,18 +310,85 @@ static void checkoutShako();
 static void returnShako();
 static void viewShakoAssignments();
 
+// Inventory bulk loads
+static void bulkLoadInstruments();
+static void bulkLoadUniforms();
+static void bulkLoadShakos();
+
 // Compliance
 static void updateStudentCompliance();
 static void showEligibilityReport();
+static void showEligibilityChanges();
+static void importRegistrarFile();
+static void showAnalytics();
+
+// Batch commands
+static int runCommand(int argc, char** argv);
 
 // ---------- Main ----------
-int main() {
-    if (sqlite3_open("band.db", &db) != SQLITE_OK) {
-        cout << "Can't open database: " << sqlite3_errmsg(db) << "\n";
+int main(int argc, char** argv) {
+    // --durability=NAME, --checkpoint=MODE, --threading=MODE and
+    // --commit=POLICY may appear anywhere; they are removed before dispatch.
+    const char* profileName = getenv("BAND_DURABILITY");
+    const char* checkpointMode = getenv("BAND_CHECKPOINT");
+    const char* threadingName = getenv("BAND_THREADING");
+    const char* commitName = getenv("BAND_COMMIT");
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--durability=", 0) == 0) profileName = argv[i] + 13;
+        else if (arg.rfind("--checkpoint=", 0) == 0) checkpointMode = argv[i] + 13;
+        else if (arg.rfind("--threading=", 0) == 0) threadingName = argv[i] + 12;
+        else if (arg.rfind("--commit=", 0) == 0) commitName = argv[i] + 9;
+        else argv[kept++] = argv[i];
+    }
+    argc = kept;
+    const DurabilityProfile* profile = &DURABILITY_PROFILES[0];
+    if (profileName && *profileName) {
+        profile = findDurabilityProfile(profileName);
+        if (!profile) {
+            cout << "Unknown durability profile '" << profileName << "' (full, normal, batched, off).\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (checkpointMode && *checkpointMode && !db.setCheckpointMode(checkpointMode)) {
+        cout << "Unknown checkpoint mode '" << checkpointMode << "' (passive, restart, truncate, off).\n";
         return EXIT_FAILURE;
     }
+    if (threadingName && *threadingName) {
+        ThreadingMode mode;
+        if (!findThreadingMode(threadingName, mode)) {
+            cout << "Unknown threading mode '" << threadingName << "' (serialized, multi).\n";
+            return EXIT_FAILURE;
+        }
+        if (!setThreadingMode(mode)) {
+            cout << "This SQLite build has no mutexes (SQLITE_THREADSAFE=0).\n";
+            return EXIT_FAILURE;
+        }
+    }
 
-    ensureTables();
+    if (commitName && *commitName) {
+        CommitPolicy policy;
+        if (!parseCommitPolicy(commitName, policy)) {
+            cout << "Unknown commit policy '" << commitName << "' (single, auto, auto:MS, ROWS, ROWS/MS).\n";
+            return EXIT_FAILURE;
+        }
+        db.setCommitPolicy(policy);
+    }
+
+    ios::sync_with_stdio(false);
+
+    db.undo().setPersistent(true);
+    if (!db.open("band.db", *profile)) {
+        printError();
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 1) {
+        int rc = runCommand(argc, argv);
+        db.close();
+        return rc;
+    }
 
     while (true) {
         cout << "\n========================================\n";
@@ -319,23 +399,36 @@ int main() {
         cout << "[3] Uniforms\n";
         cout << "[4] Shakos\n";
         cout << "[5] Compliance Reports\n";
-        cout << "[6] Exit\n";
+        cout << "[6] Database stats\n";
+        cout << "[7] Undo last change\n";
+        cout << "[8] Redo\n";
+        cout << "[9] Exit\n";
 
-        int choice = readIntInRange("\nChoice: ", 1, 6);
+        int choice = readIntInRange("\nChoice: ", 1, 9);
 
         if (choice == 1) studentsMenu();
         else if (choice == 2) instrumentsMenu();
         else if (choice == 3) uniformsMenu();
         else if (choice == 4) shakosMenu();
         else if (choice == 5) complianceMenu();
+        else if (choice == 6) showDatabaseStats();
+        else if (choice == 7) undoLastChange(false);
+        else if (choice == 8) undoLastChange(true);
         else {
-            sqlite3_close(db);
+            db.close();
             cout << "Goodbye!\n";
             return EXIT_SUCCESS;
         }
     }
 }
 
+// Piped scripts (and Ctrl-D at a prompt) end the session the same way Exit does.
+static void endOfInput() {
+    db.close();
+    cout << "\n";
+    exit(EXIT_SUCCESS);
+}
+
 // ---------- Menus ----------
 static void studentsMenu() {
     while (true) {
@@ -344,16 +437,24 @@ static void studentsMenu() {
         cout << "[2] View all students\n";
         cout << "[3] Find student by ID\n";
         cout << "[4] Assign section leader\n";
-        cout << "[5] Back\n";
+        cout << "[5] Import roster file\n";
+        cout << "[6] Section leader roll-up\n";
+        cout << "[7] Remove students\n";
+        cout << "[8] Merge duplicate students\n";
+        cout << "[9] Back\n";
 
-        int choice = readIntInRange("Choice: ", 1, 5);
+        int choice = readIntInRange("Choice: ", 1, 9);
 
         switch (choice) {
             case 1: addStudent(); break;
             case 2: viewAllStudents(); break;
             case 3: findStudentById(); break;
             case 4: setSectionLeader(); break;
-            case 5: return;
+            case 5: importRoster(); break;
+            case 6: showLeaderRollup(); break;
+            case 7: removeStudents(); break;
+            case 8: mergeStudents(); break;
+            case 9: return;
         }
     }
 }
@@ -365,14 +466,16 @@ static void instrumentsMenu() {
         cout << "[2] Return instrument\n";
         cout << "[3] View instrument assignments\n";
         cout << "[4] Add instrument to inventory\n";
-        cout << "[5] Back\n";
+        cout << "[5] Bulk load instruments from file\n";
+        cout << "[6] Back\n";
 
-        int choice = readIntInRange("Choice: ", 1, 5);
+        int choice = readIntInRange("Choice: ", 1, 6);
 
         if (choice == 1) checkoutInstrument();
         else if (choice == 2) returnInstrument();
         else if (choice == 3) viewInstrumentAssignments();
         else if (choice == 4) addInstrumentToInventory();
+        else if (choice == 5) bulkLoadInstruments();
         else return;
     }
 }
@@ -383,13 +486,15 @@ static void uniformsMenu() {
         cout << "[1] Check out uniform\n";
         cout << "[2] Return uniform\n";
         cout << "[3] View uniform assignments\n";
-        cout << "[4] Back\n";
+        cout << "[4] Bulk load uniforms from file\n";
+        cout << "[5] Back\n";
 
-        int choice = readIntInRange("Choice: ", 1, 4);
+        int choice = readIntInRange("Choice: ", 1, 5);
 
         if (choice == 1) checkoutUniform();
         else if (choice == 2) returnUniform();
         else if (choice == 3) viewUniformAssignments();
+        else if (choice == 4) bulkLoadUniforms();
         else return;
     }
 }
@@ -400,13 +505,15 @@ static void shakosMenu() {
         cout << "[1] Check out shako\n";
         cout << "[2] Return shako\n";
         cout << "[3] View shako assignments\n";
-        cout << "[4] Back\n";
+        cout << "[4] Bulk load shakos from file\n";
+        cout << "[5] Back\n";
 
-        int choice = readIntInRange("Choice: ", 1, 4);
+        int choice = readIntInRange("Choice: ", 1, 5);
 
         if (choice == 1) checkoutShako();
         else if (choice == 2) returnShako();
         else if (choice == 3) viewShakoAssignments();
+        else if (choice == 4) bulkLoadShakos();
         else return;
     }
 }
@@ -416,281 +523,195 @@ static void complianceMenu() {
         cout << "\n------ COMPLIANCE REPORTS ------\n";
         cout << "[1] Show eligibility report\n";
         cout << "[2] Update student compliance\n";
-        cout << "[3] Back\n";
+        cout << "[3] Show recent eligibility changes\n";
+        cout << "[4] Import registrar GPA/credits file\n";
+        cout << "[5] GPA/credit analytics\n";
+        cout << "[6] Back\n";
 
-        int choice = readIntInRange("Choice: ", 1, 3);
+        int choice = readIntInRange("Choice: ", 1, 6);
 
         if (choice == 1) showEligibilityReport();
         else if (choice == 2) updateStudentCompliance();
+        else if (choice == 3) showEligibilityChanges();
+        else if (choice == 4) importRegistrarFile();
+        else if (choice == 5) showAnalytics();
         else return;
     }
 }
 
 // ---------- STUDENTS ----------
 static void addStudent() {
-    int id;
-    string fname, lname, classification, section, shirtSize, shoeSize;
+    Student s;
 
-    cout << "\nStudent ID (number): ";
-    cin >> id;
-    clearInputLine();
+    s.id = readInt("\nStudent ID (number): ");
 
-    cout << "First name: ";
-    getline(cin, fname);
-    cout << "Last name: ";
-    getline(cin, lname);
+    s.fname = readText("First name: ");
+    s.lname = readText("Last name: ");
 
-    cout << "Class (Freshman/Sophomore/Junior/Senior): "; 
-    getline(cin, classification);
-    classification = trim(classification);
+    s.classification = trim(readText("Class (Freshman/Sophomore/Junior/Senior): "));
 
-    section = readSectionValidated("Section (WOODWIND/BRASS/PERCUSSION/AUXILIARY/DM): ");
+    s.section = readSectionValidated("Section (WOODWIND/BRASS/PERCUSSION/AUXILIARY/DM): ");
 
-    cout << "Shirt size (optional, XS/S/M/L/XL/XXL): ";
-    getline(cin, shirtSize);
-    shirtSize = trim(shirtSize);
-    
-    cout << "Shoe size (optional, numeric): ";
-    getline(cin, shoeSize);
-    shoeSize = trim(shoeSize);
+    s.shirtSize = trim(readText("Shirt size (optional, XS/S/M/L/XL/XXL): "));
 
-    const char* sql =
-        "INSERT INTO STUDENTS (STUDENT_ID, FNAME, LNAME, CLASSIFICATION, SECTION, SHIRT_SIZE, SHOE_SIZE) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?);";
+    s.shoeSize = trim(readText("Shoe size (optional, numeric): "));
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
-    }
+    if (students.add(s)) cout << "Student added.\n";
+    else printError();
+}
 
-    sqlite3_bind_int(stmt, 1, id);
-    sqlite3_bind_text(stmt, 2, fname.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, lname.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, classification.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 5, section.c_str(), -1, SQLITE_TRANSIENT);
-    
-    if (shirtSize.empty()) 
-        sqlite3_bind_null(stmt, 6);
-    else 
-        sqlite3_bind_text(stmt, 6, shirtSize.c_str(), -1, SQLITE_TRANSIENT);
-        
-    if (shoeSize.empty()) 
-        sqlite3_bind_null(stmt, 7);
-    else 
-        sqlite3_bind_text(stmt, 7, shoeSize.c_str(), -1, SQLITE_TRANSIENT);
-
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        cout << "Insert failed: " << sqlite3_errmsg(db) << "\n";
-        sqlite3_finalize(stmt);
-        return;
+static bool renderAllStudents(ostream& out) {
+    vector<StudentProfile> rows;
+    if (!students.list(rows)) {
+        printError();
+        return false;
     }
-    sqlite3_finalize(stmt);
-
-    const char* csql =
-        "INSERT OR IGNORE INTO COMPLIANCE "
-        "(STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
-        "VALUES (?, 0, 0.0, 0, date('now'));";
 
-    sqlite3_stmt* cstmt = nullptr;
-    if (sqlite3_prepare_v2(db, csql, -1, &cstmt, nullptr) == SQLITE_OK) {
-        sqlite3_bind_int(cstmt, 1, id);
-        sqlite3_step(cstmt);
-        sqlite3_finalize(cstmt);
+    out << "\nID   NAME                 CLASS          SECTION     SHIRT SHOE  HRS  GPA   DUES  ELIG\n";
+    out << "----------------------------------------------------------------------------------------\n";
+    for (const StudentProfile& p : rows) {
+        const Student& s = p.student;
+        const Compliance& c = p.compliance;
+
+        out << left
+            << setw(5)  << s.id
+            << setw(21) << s.fname + " " + s.lname
+            << setw(15) << s.classification
+            << setw(12) << s.section
+            << setw(6)  << s.shirtSize
+            << setw(6)  << s.shoeSize
+            << setw(5)  << c.creditHours
+            << setw(6)  << fixed << setprecision(2) << c.gpa
+            << setw(6)  << (c.duesPaid ? "YES" : "NO")
+            << (c.eligible() ? "YES" : "NO")
+            << "\n";
     }
-
-    cout << "Student added.\n";
+    return true;
 }
 
 static void viewAllStudents() {
-    const char* sql =
-        "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, s.CLASSIFICATION, s.SECTION, "
-        "       COALESCE(s.SHIRT_SIZE,''), COALESCE(s.SHOE_SIZE,''), "
-        "       COALESCE(c.CREDIT_HOURS,0), COALESCE(c.GPA,0.0), COALESCE(c.DUES_PAID,0), "
-        "       (COALESCE(c.CREDIT_HOURS,0) >= 12 AND COALESCE(c.GPA,0.0) >= 3.0 AND COALESCE(c.DUES_PAID,0)=1) AS ELIGIBLE "
-        "FROM STUDENTS s "
-        "LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID "
-        "ORDER BY s.SECTION, s.LNAME, s.FNAME;";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
-    }
-
-    cout << "\nID   NAME                 CLASS          SECTION     SHIRT SHOE  HRS  GPA   DUES  ELIG\n";
-    cout << "----------------------------------------------------------------------------------------\n";
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);
-        string name = string(colText(stmt, 1)) + " " + colText(stmt, 2);
-        string classif = colText(stmt, 3);
-
-        int hrs = sqlite3_column_int(stmt, 7);
-        double gpa = sqlite3_column_double(stmt, 8);
-        int dues = sqlite3_column_int(stmt, 9);
-        int elig = sqlite3_column_int(stmt, 10);
-
-        cout << left
-             << setw(5)  << id
-             << setw(21) << name
-             << setw(15) << classif
-             << setw(12) << colText(stmt, 4)  
-             << setw(6)  << colText(stmt, 5)  
-             << setw(6)  << colText(stmt, 6)  
-             << setw(5)  << hrs
-             << setw(6)  << fixed << setprecision(2) << gpa
-             << setw(6)  << (dues ? "YES" : "NO")
-             << (elig ? "YES" : "NO")
-             << "\n";
-    }
-
-    sqlite3_finalize(stmt);
+    static ReportCache cache;
+    printCachedReport(cache, renderAllStudents);
 }
 
 static void findStudentById() {
-    int id;
-    cout << "\nStudent ID: ";
-    cin >> id;
-
-    const char* sql =
-        "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, s.CLASSIFICATION, s.SECTION, "
-        "       COALESCE(s.SHIRT_SIZE,''), COALESCE(s.SHOE_SIZE,''), "
-        "       COALESCE(c.CREDIT_HOURS,0), COALESCE(c.GPA,0.0), COALESCE(c.DUES_PAID,0), "
-        "       COALESCE(c.LAST_VERIFIED_DATE,'') "
-        "FROM STUDENTS s "
-        "LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID "
-        "WHERE s.STUDENT_ID=?;";
+    int id = readInt("\nStudent ID: ");
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+    StudentProfile p;
+    Outcome found = students.find(id, p);
+    if (found == Outcome::Failed) {
+        printError();
         return;
     }
-
-    sqlite3_bind_int(stmt, 1, id);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        int hrs = sqlite3_column_int(stmt, 7);
-        double gpa = sqlite3_column_double(stmt, 8);
-        int dues = sqlite3_column_int(stmt, 9);
-        bool eligible = (hrs >= 12 && gpa >= 3.0 && dues == 1);
-
-        cout << "\n--- STUDENT PROFILE ---\n";
-        cout << "ID: " << sqlite3_column_int(stmt, 0) << "\n";
-        cout << "Name: " << colText(stmt, 1) << " " << colText(stmt, 2) << "\n";
-        cout << "Class: " << colText(stmt, 3) << "\n";  
-        cout << "Section: " << colText(stmt, 4) << "\n";
-        cout << "Shirt Size: " << colText(stmt, 5) << "\n";
-        cout << "Shoe Size: " << colText(stmt, 6) << "\n";
-        cout << "Credit Hours: " << hrs << "\n";
-        cout << "GPA: " << fixed << setprecision(2) << gpa << "\n";
-        cout << "Dues Paid: " << (dues ? "YES" : "NO") << "\n";
-        cout << "Eligible to march: " << (eligible ? "YES" : "NO") << "\n";
-        cout << "Last Verified: " << colText(stmt, 10) << "\n";
-    } else {
+    if (found == Outcome::NotFound) {
         cout << "No student found with that ID.\n";
+        return;
     }
 
-    sqlite3_finalize(stmt);
+    const Student& s = p.student;
+    const Compliance& c = p.compliance;
+    cout << "\n--- STUDENT PROFILE ---\n";
+    cout << "ID: " << s.id << "\n";
+    cout << "Name: " << s.fname << " " << s.lname << "\n";
+    cout << "Class: " << s.classification << "\n";
+    cout << "Section: " << s.section << "\n";
+    cout << "Shirt Size: " << s.shirtSize << "\n";
+    cout << "Shoe Size: " << s.shoeSize << "\n";
+    cout << "Credit Hours: " << c.creditHours << "\n";
+    cout << "GPA: " << fixed << setprecision(2) << c.gpa << "\n";
+    cout << "Dues Paid: " << (c.duesPaid ? "YES" : "NO") << "\n";
+    cout << "Eligible to march: " << (c.eligible() ? "YES" : "NO") << "\n";
+    cout << "Last Verified: " << c.lastVerified << "\n";
 }
 
 static void setSectionLeader() {
-    clearInputLine();
     string section = readSectionValidated("\nSection (WOODWIND/BRASS/PERCUSSION/AUXILIARY/DM): ");
 
-    cout << "Leader student ID: ";
-    int leaderId;
-    cin >> leaderId;
+    int leaderId = readInt("Leader student ID: ");
 
-    if (!studentExists(leaderId)) {
-        cout << "This student ID doesn'texist. Please add the student first.\n";
-        return;
+    switch (students.setSectionLeader(section, leaderId)) {
+        case Outcome::Done: cout << "Section leader saved.\n"; break;
+        case Outcome::NotFound: cout << "This student ID doesn'texist. Please add the student first.\n"; break;
+        case Outcome::Failed: printError(); break;
     }
+}
 
-    const char* sql =
-        "INSERT INTO SECTION_LEADERS (SECTION, LEADER_STUDENT_ID) "
-        "VALUES (?, ?) "
-        "ON CONFLICT(SECTION) DO UPDATE SET LEADER_STUDENT_ID=excluded.LEADER_STUDENT_ID;";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+static bool renderLeaderRollup(ostream& out) {
+    vector<LeaderRollupRow> rows;
+    if (!students.leaderRollup(rows)) {
+        printError();
+        return false;
     }
 
-    sqlite3_bind_text(stmt, 1, section.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 2, leaderId);
+    out << "\nSECTION LEADER ROLL-UP\n";
+    out << "SECTION     LEADER                     MEMBERS  ELIG  NOT ELIG  NO INSTR  NO UNIF  NO SHAKO\n";
+    out << "-------------------------------------------------------------------------------------------\n";
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        cout << "Set leader failed: " << sqlite3_errmsg(db) << "\n";
-    } else {
-        cout << "Section leader saved.\n";
-    }
+    bool mismatch = false;
+    for (const LeaderRollupRow& r : rows) {
+        string leader = "(no leader)";
+        if (r.hasLeader) {
+            leader = to_string(r.leaderId) + " " + r.leaderName;
+            if (r.leaderOutsideSection) {
+                leader += " *";
+                mismatch = true;
+            }
+        }
 
-    sqlite3_finalize(stmt);
+        out << left
+            << setw(12) << r.section
+            << setw(27) << leader
+            << setw(9)  << r.members
+            << setw(6)  << r.eligible
+            << setw(10) << r.members - r.eligible
+            << setw(10) << r.noInstrument
+            << setw(9)  << r.noUniform
+            << r.noShako
+            << "\n";
+    }
+    if (mismatch) out << "* leader is not a member of this section\n";
+    return true;
+}
+
+static void showLeaderRollup() {
+    static ReportCache cache;
+    printCachedReport(cache, renderLeaderRollup);
 }
 
 // ---------- INSTRUMENTS ----------
 static void addInstrumentToInventory() {
     cout << "\nInstrument Types:\n";
-    const char* listSql = "SELECT TYPE_ID, TYPE_NAME, SECTION FROM INSTRUMENT_TYPES ORDER BY SECTION, TYPE_NAME;";
-    sqlite3_stmt* listStmt = nullptr;
-
-    if (sqlite3_prepare_v2(db, listSql, -1, &listStmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
-    }
-    while (sqlite3_step(listStmt) == SQLITE_ROW) {
-        cout << sqlite3_column_int(listStmt, 0) << ". "
-             << colText(listStmt, 1) << " (" << colText(listStmt, 2) << ")\n";
-    }
-    sqlite3_finalize(listStmt);
-
-    int typeId;
-    cout << "\nChoose TYPE_ID: ";
-    cin >> typeId;
-    clearInputLine();
-
-    string serial, notes;
-    cout << "Serial (optional): ";
-    getline(cin, serial);
-    cout << "Condition notes (optional): ";
-    getline(cin, notes);
+    for (const InstrumentType& t : db.instrumentTypes())
+        cout << t.id << ". " << t.name << " (" << t.section << ")\n";
 
-    const char* sql =
-        "INSERT INTO INSTRUMENTS (TYPE_ID, SERIAL, CONDITION_NOTES) "
-        "VALUES (?, ?, ?);";
+    int typeId = readInt("\nChoose TYPE_ID: ");
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+    if (!db.findInstrumentType(typeId)) {
+        cout << "No instrument type with that ID.\n";
         return;
     }
 
-    sqlite3_bind_int(stmt, 1, typeId);
-    if (serial.empty()) sqlite3_bind_null(stmt, 2);
-    else sqlite3_bind_text(stmt, 2, serial.c_str(), -1, SQLITE_TRANSIENT);
-
-    if (notes.empty()) sqlite3_bind_null(stmt, 3);
-    else sqlite3_bind_text(stmt, 3, notes.c_str(), -1, SQLITE_TRANSIENT);
+    string serial, notes;
+    serial = readText("Serial (optional): ");
+    notes = readText("Condition notes (optional): ");
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        cout << "Add failed: " << sqlite3_errmsg(db) << "\n";
-    } else {
-        cout << "Instrument added to inventory.\n";
+    switch (inventory.addInstrument(typeId, serial, notes)) {
+        case Outcome::Done: cout << "Instrument added to inventory.\n"; break;
+        case Outcome::NotFound: cout << "No instrument type with that ID.\n"; break;
+        case Outcome::Failed: printError(); break;
     }
-
-    sqlite3_finalize(stmt);
 }
 
 static void checkoutInstrument() {
-    int studentId;
-    cout << "\nStudent ID: ";
-    cin >> studentId;
-    clearInputLine();
+    int studentId = readInt("\nStudent ID: ");
 
     string studentSection;
-    if (!getStudentSection(studentId, studentSection)) {
+    Outcome found = students.section(studentId, studentSection);
+    if (found == Outcome::Failed) {
+        printError();
+        return;
+    }
+    if (found == Outcome::NotFound) {
         cout << "This student ID does not exist. Please add the student first.\n";
         return;
     }
@@ -698,33 +719,16 @@ static void checkoutInstrument() {
     cout << "\nFilter available instruments by student's SECTION (" << studentSection << ")?\n";
     int filter = readIntInRange("[1] Yes  [2] No\nChoice: ", 1, 2);
 
-    const char* sqlFiltered =
-        "SELECT i.INSTRUMENT_ID, t.TYPE_NAME, COALESCE(i.SERIAL,''), COALESCE(i.CONDITION_NOTES,'') "
-        "FROM INSTRUMENTS i "
-        "JOIN INSTRUMENT_TYPES t ON t.TYPE_ID=i.TYPE_ID "
-        "WHERE i.CHECKED_OUT_TO IS NULL AND t.SECTION=? "
-        "ORDER BY t.TYPE_NAME, i.INSTRUMENT_ID;";
-
-    const char* sqlAll =
-        "SELECT i.INSTRUMENT_ID, t.TYPE_NAME, COALESCE(i.SERIAL,''), COALESCE(i.CONDITION_NOTES,'') "
-        "FROM INSTRUMENTS i "
-        "JOIN INSTRUMENT_TYPES t ON t.TYPE_ID=i.TYPE_ID "
-        "WHERE i.CHECKED_OUT_TO IS NULL "
-        "ORDER BY t.SECTION, t.TYPE_NAME, i.INSTRUMENT_ID;";
-
-    sqlite3_stmt* stmt = nullptr;
+    vector<Instrument> rows;
+    if (!inventory.instruments(Holding::Available, rows)) {
+        printError();
+        return;
+    }
 
     if (filter == 1) {
-        if (sqlite3_prepare_v2(db, sqlFiltered, -1, &stmt, nullptr) != SQLITE_OK) {
-            cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-            return;
-        }
-        sqlite3_bind_text(stmt, 1, studentSection.c_str(), -1, SQLITE_TRANSIENT);
-    } else {
-        if (sqlite3_prepare_v2(db, sqlAll, -1, &stmt, nullptr) != SQLITE_OK) {
-            cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-            return;
-        }
+        rows.erase(remove_if(rows.begin(), rows.end(),
+                             [&](const Instrument& r) { return r.section != studentSection; }),
+                   rows.end());
     }
 
     cout << "\nAvailable Instruments";
@@ -734,64 +738,40 @@ static void checkoutInstrument() {
     cout << "ID   TYPE         SERIAL        CONDITION NOTES\n";
     cout << "------------------------------------------------\n";
 
-    bool any = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        any = true;
+    for (const Instrument& r : rows) {
         cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(13) << colText(stmt, 1)
-             << setw(13) << colText(stmt, 2)
-             << colText(stmt, 3)
+             << setw(5) << r.id
+             << setw(13) << r.type
+             << setw(13) << r.serial
+             << r.notes
              << "\n";
     }
-    sqlite3_finalize(stmt);
 
-    if (!any) {
+    if (rows.empty()) {
         cout << "No instruments available for that view.\n";
         return;
     }
 
-    cout << "\nEnter INSTRUMENT_ID to check out: ";
-    int instrumentId;
-    cin >> instrumentId;
-
-    const char* upd =
-        "UPDATE INSTRUMENTS "
-        "SET CHECKED_OUT_TO=?, CHECKED_OUT_DATE=date('now') "
-        "WHERE INSTRUMENT_ID=? AND CHECKED_OUT_TO IS NULL;";
-
-    sqlite3_stmt* updStmt = nullptr;
-    if (sqlite3_prepare_v2(db, upd, -1, &updStmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
-    }
+    int instrumentId = readInt("\nEnter INSTRUMENT_ID to check out: ");
 
-    sqlite3_bind_int(updStmt, 1, studentId);
-    sqlite3_bind_int(updStmt, 2, instrumentId);
-
-    if (sqlite3_step(updStmt) != SQLITE_DONE) {
-        cout << "Checkout failed: " << sqlite3_errmsg(db) << "\n";
-        cout << "Note: student can only hold ONE instrument at a time.\n";
-    } else {
-        int changes = sqlite3_changes(db);
-        if (!changes) cout << "Invaild. Instrument already checked out OR that ID doesn't exist!\n";
-        else cout << "Instrument checked out.\n";
+    switch (inventory.checkoutInstrument(instrumentId, studentId)) {
+        case Outcome::Done:
+            cout << "Instrument checked out.\n";
+            break;
+        case Outcome::NotFound:
+            cout << "Invaild. Instrument already checked out OR that ID doesn't exist!\n";
+            break;
+        case Outcome::Failed:
+            printError();
+            cout << "Note: student can only hold ONE instrument at a time.\n";
+            break;
     }
-
-    sqlite3_finalize(updStmt);
 }
 
 static void returnInstrument() {
-    const char* sql =
-        "SELECT i.INSTRUMENT_ID, t.TYPE_NAME, COALESCE(i.SERIAL,''), i.CHECKED_OUT_TO, COALESCE(i.CHECKED_OUT_DATE,'') "
-        "FROM INSTRUMENTS i "
-        "JOIN INSTRUMENT_TYPES t ON t.TYPE_ID=i.TYPE_ID "
-        "WHERE i.CHECKED_OUT_TO IS NOT NULL "
-        "ORDER BY i.INSTRUMENT_ID;";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+    vector<Instrument> rows;
+    if (!inventory.instruments(Holding::CheckedOut, rows)) {
+        printError();
         return;
     }
 
@@ -799,474 +779,1920 @@ static void returnInstrument() {
     cout << "ID   TYPE         SERIAL        STUDENT   DATE\n";
     cout << "------------------------------------------------\n";
 
-    bool any = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        any = true;
+    for (const Instrument& r : rows) {
         cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(13) << colText(stmt, 1)
-             << setw(13) << colText(stmt, 2)
-             << setw(10) << sqlite3_column_int(stmt, 3)
-             << colText(stmt, 4)
+             << setw(5) << r.id
+             << setw(13) << r.type
+             << setw(13) << r.serial
+             << setw(10) << r.studentId
+             << r.date
              << "\n";
     }
-    sqlite3_finalize(stmt);
 
-    if (!any) {
+    if (rows.empty()) {
         cout << "None.\n";
         return;
     }
 
-    cout << "\nEnter INSTRUMENT_ID to return: ";
-    int instrumentId;
-    cin >> instrumentId;
+    int instrumentId = readInt("\nEnter INSTRUMENT_ID to return: ");
 
-    const char* upd =
-        "UPDATE INSTRUMENTS "
-        "SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL "
-        "WHERE INSTRUMENT_ID=?;";
+    switch (inventory.returnInstrument(instrumentId)) {
+        case Outcome::Done: cout << "Instrument returned.\n"; break;
+        case Outcome::NotFound: cout << "No instrument with that ID.\n"; break;
+        case Outcome::Failed: printError(); break;
+    }
+}
 
-       sqlite3_stmt* updStmt = nullptr;
-    if (sqlite3_prepare_v2(db, upd, -1, &updStmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+static bool renderInstrumentAssignments(ostream& out) {
+    vector<Instrument> rows;
+    if (!inventory.instruments(Holding::All, rows)) {
+        printError();
+        return false;
     }
 
-    sqlite3_bind_int(updStmt, 1, instrumentId);
+    out << "\nINSTRUMENT ASSIGNMENTS\n";
+    out << "ID   TYPE         SERIAL        STUDENT   DATE       CONDITION NOTES\n";
+    out << "---------------------------------------------------------------------\n";
 
-    if (sqlite3_step(updStmt) != SQLITE_DONE) {
-        cout << "Return failed: " << sqlite3_errmsg(db) << "\n";
-    } else {
-        cout << (sqlite3_changes(db) ? "Instrument returned.\n" : "No instrument with that ID.\n");
+    for (const Instrument& r : rows) {
+        out << left
+            << setw(5) << r.id
+            << setw(13) << r.type
+            << setw(13) << r.serial
+            << setw(10) << r.studentId
+            << setw(12) << r.date
+            << r.notes
+            << "\n";
     }
-
-    sqlite3_finalize(updStmt);
+    return true;
 }
 
 static void viewInstrumentAssignments() {
-    const char* sql =
-        "SELECT i.INSTRUMENT_ID, t.TYPE_NAME, COALESCE(i.SERIAL,''), "
-        "       COALESCE(i.CHECKED_OUT_TO,0), COALESCE(i.CHECKED_OUT_DATE,''), "
-        "       COALESCE(i.CONDITION_NOTES,'') "
-        "FROM INSTRUMENTS i "
-        "JOIN INSTRUMENT_TYPES t ON t.TYPE_ID=i.TYPE_ID "
-        "ORDER BY (i.CHECKED_OUT_TO IS NULL) DESC, t.SECTION, t.TYPE_NAME, i.INSTRUMENT_ID;";
+    static ReportCache cache;
+    printCachedReport(cache, renderInstrumentAssignments);
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+// ---------- UNIFORMS ----------
+static void checkoutUniform() {
+    int studentId = readInt("\nStudent ID: ");
+
+    if (!students.exists(studentId)) {
+        cout << "This student ID doesn't exist. Please add the student first!\n";
         return;
     }
 
-    cout << "\nINSTRUMENT ASSIGNMENTS\n";
-    cout << "ID   TYPE         SERIAL        STUDENT   DATE       CONDITION NOTES\n";
-    cout << "---------------------------------------------------------------------\n";
+    Uniform u;
+    u.coatSize = readText("Coat size (optional): ");
+    u.pantSize = readText("Pant size (optional): ");
+    u.coatNumber = readText("Coat number (optional): ");
+    u.pantNumber = readText("Pant number (optional): ");
+    u.notes = readText("Condition notes (optional): ");
+
+    switch (inventory.checkoutUniform(studentId, u)) {
+        case Outcome::Done:
+            cout << "Uniform checked out.\n";
+            break;
+        case Outcome::NotFound:
+            cout << "This student ID doesn't exist. Please add the student first!\n";
+            break;
+        case Outcome::Failed:
+            printError();
+            cout << "Note: a student can only have ONE uniform at a time.\n";
+            break;
+    }
+}
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+static void returnUniform() {
+    vector<Uniform> rows;
+    if (!inventory.uniforms(Holding::CheckedOut, rows)) {
+        printError();
+        return;
+    }
+
+    cout << "\nChecked-Out Uniforms:\n";
+    cout << "ID   COAT  PANT  C#   P#   STUDENT   DATE\n";
+    cout << "-----------------------------------------\n";
+
+    for (const Uniform& u : rows) {
         cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(13) << colText(stmt, 1)
-             << setw(13) << colText(stmt, 2)
-             << setw(10) << sqlite3_column_int(stmt, 3)
-             << setw(12) << colText(stmt, 4)
-             << colText(stmt, 5)
+             << setw(5) << u.id
+             << setw(6) << u.coatSize
+             << setw(6) << u.pantSize
+             << setw(5) << u.coatNumber
+             << setw(5) << u.pantNumber
+             << setw(10) << u.studentId
+             << u.date
              << "\n";
     }
 
-    sqlite3_finalize(stmt);
+    if (rows.empty()) {
+        cout << "None.\n";
+        return;
+    }
+
+    int uniformId = readInt("\nEnter UNIFORM_ID to return: ");
+
+    switch (inventory.returnUniform(uniformId)) {
+        case Outcome::Done: cout << "Uniform returned.\n"; break;
+        case Outcome::NotFound: cout << "No uniform with that ID.\n"; break;
+        case Outcome::Failed: printError(); break;
+    }
 }
 
-// ---------- UNIFORMS ----------
-static void checkoutUniform() {
-    int studentId;
-    cout << "\nStudent ID: ";
-    cin >> studentId;
-    clearInputLine();
+static bool renderUniformAssignments(ostream& out) {
+    vector<Uniform> rows;
+    if (!inventory.uniforms(Holding::All, rows)) {
+        printError();
+        return false;
+    }
 
-    if (!studentExists(studentId)) {
-        cout << "This student ID doesn't exist. Please add the student first!\n";
-        return;
+    out << "\nUNIFORM ASSIGNMENTS\n";
+    out << "ID   COAT  PANT  C#   P#   STUDENT   DATE       CONDITION NOTES\n";
+    out << "----------------------------------------------------------------\n";
+
+    for (const Uniform& u : rows) {
+        out << left
+            << setw(5) << u.id
+            << setw(6) << u.coatSize
+            << setw(6) << u.pantSize
+            << setw(5) << u.coatNumber
+            << setw(5) << u.pantNumber
+            << setw(10) << u.studentId
+            << setw(12) << u.date
+            << u.notes
+            << "\n";
     }
+    return true;
+}
 
-    string coatSize, pantSize, coatNumber, pantNumber, notes;
-    cout << "Coat size (optional): ";
-    getline(cin, coatSize);
-    cout << "Pant size (optional): ";
-    getline(cin, pantSize);
-    cout << "Coat number (optional): ";
-    getline(cin, coatNumber);
-    cout << "Pant number (optional): ";
-    getline(cin, pantNumber);
-    cout << "Condition notes (optional): ";
-    getline(cin, notes);
+static void viewUniformAssignments() {
+    static ReportCache cache;
+    printCachedReport(cache, renderUniformAssignments);
+}
 
-    const char* sql =
-        "INSERT INTO UNIFORMS (COAT_SIZE, PANT_SIZE, COAT_NUMBER, PANT_NUMBER, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE) "
-        "VALUES (?, ?, ?, ?, ?, ?, date('now'));";
+// ---------- SHAKOS ----------
+static void checkoutShako() {
+    int studentId = readInt("\nStudent ID: ");
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+    if (!students.exists(studentId)) {
+        cout << "This student ID doesn't exist. Please add the student first!\n";
         return;
     }
 
-    int col = 1;
-    if (coatSize.empty()) sqlite3_bind_null(stmt, col++);
-    else sqlite3_bind_text(stmt, col++, coatSize.c_str(), -1, SQLITE_TRANSIENT);
-    
-    if (pantSize.empty()) sqlite3_bind_null(stmt, col++);
-    else sqlite3_bind_text(stmt, col++, pantSize.c_str(), -1, SQLITE_TRANSIENT);
-    
-    if (coatNumber.empty()) sqlite3_bind_null(stmt, col++);
-    else sqlite3_bind_text(stmt, col++, coatNumber.c_str(), -1, SQLITE_TRANSIENT);
-    
-    if (pantNumber.empty()) sqlite3_bind_null(stmt, col++);
-    else sqlite3_bind_text(stmt, col++, pantNumber.c_str(), -1, SQLITE_TRANSIENT);
-    
-    if (notes.empty()) sqlite3_bind_null(stmt, col++);
-    else sqlite3_bind_text(stmt, col++, notes.c_str(), -1, SQLITE_TRANSIENT);
-    
-    sqlite3_bind_int(stmt, col++, studentId);
-
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        cout << "Checkout failed: " << sqlite3_errmsg(db) << "\n";
-        cout << "Note: a student can only have ONE uniform at a time.\n";
-    } else {
-        cout << "Uniform checked out.\n";
-    }
+    Shako s;
+    s.size = readText("Shako size (optional): ");
+    s.notes = readText("Condition notes (optional): ");
 
-    sqlite3_finalize(stmt);
+    switch (inventory.checkoutShako(studentId, s)) {
+        case Outcome::Done:
+            cout << "Shako checked out.\n";
+            break;
+        case Outcome::NotFound:
+            cout << "This student ID doesn't exist. Please add the student first!\n";
+            break;
+        case Outcome::Failed:
+            printError();
+            cout << "Note: a student may only hold ONE shako at a time.\n";
+            break;
+    }
 }
 
-static void returnUniform() {
-    const char* sql =
-        "SELECT UNIFORM_ID, COALESCE(COAT_SIZE,''), COALESCE(PANT_SIZE,''), "
-        "       COALESCE(COAT_NUMBER,''), COALESCE(PANT_NUMBER,''), "
-        "       CHECKED_OUT_TO, COALESCE(CHECKED_OUT_DATE,'') "
-        "FROM UNIFORMS WHERE CHECKED_OUT_TO IS NOT NULL ORDER BY UNIFORM_ID;";
-
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+static void returnShako() {
+    vector<Shako> rows;
+    if (!inventory.shakos(Holding::CheckedOut, rows)) {
+        printError();
         return;
     }
 
-    cout << "\nChecked-Out Uniforms:\n";
-    cout << "ID   COAT  PANT  C#   P#   STUDENT   DATE\n";
-    cout << "-----------------------------------------\n";
+    cout << "\nChecked-Out Shakos:\n";
+    cout << "ID   SIZE         STUDENT   DATE       CONDITION NOTES\n";
+    cout << "-------------------------------------------------------\n";
 
-    bool any = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        any = true;
+    for (const Shako& s : rows) {
         cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(6) << colText(stmt, 1)
-             << setw(6) << colText(stmt, 2)
-             << setw(5) << colText(stmt, 3)
-             << setw(5) << colText(stmt, 4)
-             << setw(10) << sqlite3_column_int(stmt, 5)
-             << colText(stmt, 6)
+             << setw(5) << s.id
+             << setw(13) << s.size
+             << setw(10) << s.studentId
+             << setw(12) << s.date
+             << s.notes
              << "\n";
     }
-    sqlite3_finalize(stmt);
 
-    if (!any) {
+    if (rows.empty()) {
         cout << "None.\n";
         return;
     }
 
-    cout << "\nEnter UNIFORM_ID to return: ";
-    int uniformId;
-    cin >> uniformId;
+    int shakoId = readInt("\nEnter SHAKO_ID to return: ");
+
+    switch (inventory.returnShako(shakoId)) {
+        case Outcome::Done: cout << "Shako returned.\n"; break;
+        case Outcome::NotFound: cout << "No shako with that ID.\n"; break;
+        case Outcome::Failed: printError(); break;
+    }
+}
+
+static bool renderShakoAssignments(ostream& out) {
+    vector<Shako> rows;
+    if (!inventory.shakos(Holding::All, rows)) {
+        printError();
+        return false;
+    }
+
+    out << "\nSHAKO ASSIGNMENTS\n";
+    out << "ID   SIZE         STUDENT   DATE       CONDITION NOTES\n";
+    out << "-------------------------------------------------------\n";
+
+    for (const Shako& s : rows) {
+        out << left
+            << setw(5) << s.id
+            << setw(13) << s.size
+            << setw(10) << s.studentId
+            << setw(12) << s.date
+            << s.notes
+            << "\n";
+    }
+    if (rows.empty()) out << "(none)\n";
+    return true;
+}
+
+static void viewShakoAssignments() {
+    static ReportCache cache;
+    printCachedReport(cache, renderShakoAssignments);
+}
 
-    const char* upd =
-        "UPDATE UNIFORMS SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL WHERE UNIFORM_ID=?;";
+// ---------- COMPLIANCE ----------
+static void updateStudentCompliance() {
+    int id = readInt("\nStudent ID: ");
 
-    sqlite3_stmt* updStmt = nullptr;
-    if (sqlite3_prepare_v2(db, upd, -1, &updStmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+    if (!students.exists(id)) {
+        cout << "This student ID doesn't exist. Please add the student first!\n";
         return;
     }
 
-    sqlite3_bind_int(updStmt, 1, uniformId);
+    int hours = readIntInRange("Credit hours (0-30): ", 0, 30);
+    double gpa = readDoubleInRange("GPA (0.00-4.00): ", 0.0, 4.0);
+    int dues = readBool01("Dues paid? (1=yes, 0=no): ");
 
-    if (sqlite3_step(updStmt) != SQLITE_DONE) {
-        cout << "Return failed: " << sqlite3_errmsg(db) << "\n";
-    } else {
-        cout << (sqlite3_changes(db) ? "Uniform returned.\n" : "No uniform with that ID.\n");
+    switch (compliance.update(id, hours, gpa, dues == 1)) {
+        case Outcome::Done: cout << "Compliance saved.\n"; break;
+        case Outcome::NotFound: cout << "This student ID doesn't exist. Please add the student first!\n"; break;
+        case Outcome::Failed: printError(); break;
+    }
+}
+
+static bool renderEligibilityReport(ostream& out) {
+    vector<StudentProfile> rows;
+    if (!compliance.eligibilityReport(rows)) {
+        printError();
+        return false;
     }
 
-    sqlite3_finalize(updStmt);
+    out << "\nELIGIBILITY REPORT (needs: >=12 hrs, >=3.0 GPA, dues paid)\n";
+    out << "ID   NAME                 CLASS      SECTION     HRS  GPA   DUES  OK_H OK_G OK_D ELIG  VERIFIED\n";
+    out << "-----------------------------------------------------------------------------------------------\n";
+
+    for (const StudentProfile& p : rows) {
+        const Student& s = p.student;
+        const Compliance& c = p.compliance;
+
+        out << left
+            << setw(6)  << s.id
+            << setw(21) << s.fname + " " + s.lname
+            << setw(11) << s.classification
+            << setw(12) << s.section
+            << setw(5)  << c.creditHours
+            << setw(6)  << fixed << setprecision(2) << c.gpa
+            << setw(6)  << (c.duesPaid ? "YES" : "NO")
+            << setw(5)  << (c.hoursOk() ? "Y" : "N")
+            << setw(5)  << (c.gpaOk() ? "Y" : "N")
+            << setw(5)  << (c.duesPaid ? "Y" : "N")
+            << setw(6)  << (c.eligible() ? "YES" : "NO")
+            << c.lastVerified
+            << "\n";
+    }
+    return true;
 }
 
-static void viewUniformAssignments() {
-    const char* sql =
-        "SELECT UNIFORM_ID, COALESCE(COAT_SIZE,''), COALESCE(PANT_SIZE,''), "
-        "       COALESCE(COAT_NUMBER,''), COALESCE(PANT_NUMBER,''), "
-        "       COALESCE(CONDITION_NOTES,''), "
-        "       COALESCE(CHECKED_OUT_TO,0), COALESCE(CHECKED_OUT_DATE,'') "
-        "FROM UNIFORMS ORDER BY (CHECKED_OUT_TO IS NULL) DESC, UNIFORM_ID;";
+static void showEligibilityReport() {
+    static ReportCache cache;
+    printCachedReport(cache, renderEligibilityReport);
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
+static void showEligibilityChanges() {
+    vector<EligibilityEvent> events;
+    if (!compliance.recentChanges(25, events)) {
+        printError();
         return;
     }
 
-    cout << "\nUNIFORM ASSIGNMENTS\n";
-    cout << "ID   COAT  PANT  C#   P#   STUDENT   DATE       CONDITION NOTES\n";
-    cout << "----------------------------------------------------------------\n";
+    cout << "\nRECENT ELIGIBILITY CHANGES (newest first)\n";
+    cout << "EVENT  ID    NAME                 CHANGE     WHEN\n";
+    cout << "------------------------------------------------------------\n";
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    for (const EligibilityEvent& e : events) {
         cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(6) << colText(stmt, 1)
-             << setw(6) << colText(stmt, 2)
-             << setw(5) << colText(stmt, 3)
-             << setw(5) << colText(stmt, 4)
-             << setw(10) << sqlite3_column_int(stmt, 6)
-             << setw(12) << colText(stmt, 7)
-             << colText(stmt, 5)
+             << setw(7)  << e.eventId
+             << setw(6)  << e.studentId
+             << setw(21) << (e.name.empty() ? "(deleted)" : e.name)
+             << setw(11) << (e.isEligible ? "NO -> YES" : "YES -> NO")
+             << e.changedAt
              << "\n";
     }
+    if (events.empty()) cout << "(none)\n";
+}
+
+// ---------- ANALYTICS ----------
+static void printGroupRow(ostream& out, const string& name, const GroupSummary& g) {
+    out << left << setw(12) << name << right << setw(9) << g.count;
+    if (!g.count) {
+        out << "\n";
+        return;
+    }
+    out << fixed << setprecision(2)
+        << setw(7) << g.gpaSum / g.count
+        << setw(6) << g.percentile(0.10)
+        << setw(6) << g.percentile(0.25)
+        << setw(6) << g.percentile(0.50)
+        << setw(6) << g.percentile(0.75)
+        << setw(6) << g.percentile(0.90)
+        << setprecision(1) << setw(6) << (double)g.hourSum / g.count
+        << setw(9) << g.countBetween(280, 320)
+        << setw(8) << g.countBetween(0, 199)
+        << setw(8) << g.countBetween(200, 249)
+        << setw(8) << g.countBetween(250, 299)
+        << setw(8) << g.countBetween(300, 349)
+        << setw(8) << g.countBetween(350, 400)
+        << "\n";
+}
+
+static void printDistributions(ostream& out, const DistributionStats& st) {
+    const char* header =
+        "GROUP           COUNT   MEAN   P10   P25   P50   P75   P90   HRS  AT-RISK   <2.00  2.00-   2.50-   3.00-   3.50+\n";
+    const char* rule =
+        "--------------------------------------------------------------------------------------------------------------\n";
+
+    GroupSummary all;
+    out << "\nBY SECTION (AT-RISK = GPA within 0.20 of 3.00)\n" << header << rule;
+    for (int s = 0; s < ANALYTICS_NUM_SECTIONS; s++) {
+        GroupSummary g;
+        for (int c = 0; c < ANALYTICS_NUM_CLASSES; c++) g.addCell(st, s * ANALYTICS_NUM_CLASSES + c);
+        printGroupRow(out, ANALYTICS_SECTIONS[s], g);
+    }
 
-    sqlite3_finalize(stmt);
+    out << "\nBY CLASS\n" << header << rule;
+    for (int c = 0; c < ANALYTICS_NUM_CLASSES; c++) {
+        GroupSummary g;
+        for (int s = 0; s < ANALYTICS_NUM_SECTIONS; s++) g.addCell(st, s * ANALYTICS_NUM_CLASSES + c);
+        printGroupRow(out, ANALYTICS_CLASSES[c], g);
+    }
+
+    for (int i = 0; i < ANALYTICS_NUM_CELLS; i++) all.addCell(st, i);
+    out << rule;
+    printGroupRow(out, "ALL", all);
 }
 
-// ---------- SHAKOS ----------
-static void checkoutShako() {
-    int studentId;
-    cout << "\nStudent ID: ";
-    cin >> studentId;
-    clearInputLine();
+static bool runAnalytics(size_t syntheticRows) {
+    ComplianceSnapshot snap;
+    auto t0 = chrono::steady_clock::now();
+    if (syntheticRows) buildSyntheticSnapshot(snap, syntheticRows);
+    else if (!compliance.snapshot(snap)) {
+        printError();
+        return false;
+    }
+    auto t1 = chrono::steady_clock::now();
 
-    if (!studentExists(studentId)) {
-        cout << "This student ID doesn't exist. Please add the student first!\n";
-        return;
+    DistributionStats st;
+    computeDistributions(snap, st);
+    auto t2 = chrono::steady_clock::now();
+
+    printDistributions(cout, st);
+    cout << "\n" << snap.gpa.size() << (syntheticRows ? " synthetic" : "") << " students; "
+         << (syntheticRows ? "generate " : "snapshot ")
+         << fixed << setprecision(1) << chrono::duration<double, milli>(t1 - t0).count() << " ms, "
+         << "analysis " << chrono::duration<double, milli>(t2 - t1).count() << " ms\n";
+    return true;
+}
+
+static void showAnalytics() {
+    runAnalytics(0);
+}
+
+// ---------- IMPORTS ----------
+static void printParseErrors(const vector<ParseError>& errors) {
+    if (errors.empty()) return;
+    cout << errors.size() << " line(s) skipped:\n";
+    for (size_t i = 0; i < errors.size() && i < 20; i++)
+        cout << "  line " << errors[i].line << ": " << errors[i].message << "\n";
+    if (errors.size() > 20) cout << "  ... and " << errors.size() - 20 << " more\n";
+}
+
+// Rows from batches committed before a failure stay in the database.
+static void printImportFailure(const ImportResult& r, const char* what) {
+    printError();
+    if (r.added) cout << r.added << " " << what << " committed before the failure were kept.\n";
+    else cout << "Nothing was imported.\n";
+}
+
+static void printImportCommits(const ImportResult& r) {
+    cout << r.commits << " commit(s)";
+    if (db.commitPolicy().autoTune) cout << ", batch size now " << r.batchRows << " rows";
+    cout << ", longest batch held the write lock " << fixed << setprecision(1) << r.maxBatchMs << " ms.\n";
+}
+
+// Existence checks the key filter answered without going to the table.
+static void printKeyChecks(const ImportResult& r) {
+    size_t checks = r.keysCleared + r.keysProbed;
+    if (!checks) return;
+    cout << "Key filter cleared " << r.keysCleared << " of " << checks << " existence check(s) without a lookup; "
+         << r.falsePositives << " of the " << r.keysProbed << " looked up were false positives.\n";
+}
+
+static bool importRosterFile(const string& path) {
+    ImportResult r;
+    if (!students.importFile(path, r)) {
+        printImportFailure(r, "students");
+        return false;
     }
+    cout << "Added " << r.added << " students in " << fixed << setprecision(3) << r.writeSec << "s";
+    cout << " (parsed in " << r.parseSec << "s on " << r.threads << " thread(s); writer waited " << r.waitSec << "s).\n";
+    printImportCommits(r);
+    printKeyChecks(r);
+    printParseErrors(r.errors);
+    return true;
+}
 
-    string size, notes;
-    cout << "Shako size (optional): ";
-    getline(cin, size);
-    cout << "Condition notes (optional): ";
-    getline(cin, notes);
+static void importRoster() {
+    string path = trim(readText("\nRoster file path (STUDENT_ID,FNAME,LNAME,CLASS,SECTION[,SHIRT,SHOE]): "));
+    if (path.empty()) return;
+    importRosterFile(path);
+}
 
-    const char* sql =
-        "INSERT INTO SHAKOS (SIZE, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE) "
-        "VALUES (?, ?, ?, date('now'));";
+// IDs typed at a prompt or given on the command line, with spaces or commas
+// between. Anything that is not a whole number is refused, naming it.
+static bool parseIdList(string_view text, vector<int>& out) {
+    auto separator = [](char c) { return c == ',' || isspace((unsigned char)c); };
+    size_t i = 0;
+    while (i < text.size()) {
+        if (separator(text[i])) {
+            i++;
+            continue;
+        }
+        size_t j = i;
+        while (j < text.size() && !separator(text[j])) j++;
+        int id;
+        if (!parseNumber(text.substr(i, j - i), id)) {
+            cout << "'" << text.substr(i, j - i) << "' is not a student ID.\n";
+            return false;
+        }
+        out.push_back(id);
+        i = j;
+    }
+    return true;
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+// ID files are delimited like the imports. Removal reads the first column of
+// each line; a merge file has exactly two columns, DUPLICATE_ID,KEEP_ID. A
+// header line is skipped; any other line that does not fit fails the whole
+// file, so nothing is removed on a guess.
+static bool readIdFile(const string& path, size_t columns, vector<int>& out) {
+    MappedFile file;
+    if (!file.open(path)) {
+        cout << "Can't read " << path << "\n";
+        return false;
+    }
+    DelimitedReader reader(file.data, file.data + file.size, detectDelimiter(file.data, file.size));
+    while (reader.next()) {
+        if (reader.blank()) continue;
+        const vector<string_view>& f = reader.fields;
+        int id;
+        if (reader.line == 1 && !parseNumber(f[0], id)) continue;
+
+        bool ok = columns == 1 || f.size() == columns;
+        for (size_t i = 0; ok && i < columns; i++) {
+            ok = parseNumber(f[i], id);
+            if (ok) out.push_back(id);
+        }
+        if (!ok) {
+            cout << path << ", line " << reader.line << ": expected "
+                 << (columns == 1 ? "a STUDENT_ID first" : "DUPLICATE_ID,KEEP_ID") << ".\n";
+            return false;
+        }
     }
+    return true;
+}
 
-    if (size.empty()) sqlite3_bind_null(stmt, 1);
-    else sqlite3_bind_text(stmt, 1, size.c_str(), -1, SQLITE_TRANSIENT);
+// Batches past the undo journal's limit are permanent. The menus always ask;
+// the command line asks only for those, unless given --yes. End of input is
+// a no.
+static bool confirmStudentBatch(const char* verb, size_t count) {
+    bool permanent = count > StudentRepo::UNDO_BATCH_LIMIT;
+    commitPoint();
+    cout << verb << " " << count << " student(s)?" << (permanent ? " This is too many to undo." : "") << " [y/N] ";
+    string_view answer;
+    if (!nextLine(stdinBuffer, answer)) {
+        cout << "\n";
+        return false;
+    }
+    answer = trimView(answer);
+    return answer == "y" || answer == "Y" || answer == "yes";
+}
 
-    if (notes.empty()) sqlite3_bind_null(stmt, 2);
-    else sqlite3_bind_text(stmt, 2, notes.c_str(), -1, SQLITE_TRANSIENT);
+static void printCleanup(const StudentCleanup& c, double sec) {
+    cout << "Removed " << c.students << " students in " << fixed << setprecision(3) << sec << "s";
+    if (c.missing) cout << " (" << c.missing << " IDs not found)";
+    cout << ".\n";
+    if (c.gearReassigned) cout << "Gear moved to kept students: " << c.gearReassigned << "\n";
+    if (c.gearReleased) cout << "Gear checked back in: " << c.gearReleased << "\n";
+    if (c.leadersReassigned) cout << "Sections now led by kept students: " << c.leadersReassigned << "\n";
+    if (c.leadersCleared) cout << "Sections left without a leader: " << c.leadersCleared << "\n";
+    if (c.complianceMerged) cout << "Compliance records taken from duplicates: " << c.complianceMerged << "\n";
+    if (c.students && !c.undoable) cout << "(Too many students to undo.)\n";
+}
 
-    sqlite3_bind_int(stmt, 3, studentId);
+static bool removeStudentIds(const vector<int>& ids) {
+    StudentCleanup c;
+    auto t0 = chrono::steady_clock::now();
+    if (!students.remove(ids, c)) {
+        printError();
+        return false;
+    }
+    printCleanup(c, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+    return true;
+}
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        cout << "Checkout failed: " << sqlite3_errmsg(db) << "\n";
-        cout << "Note: a student may only hold ONE shako at a time.\n";
-    } else {
-        cout << "Shako checked out.\n";
+// pairs are (duplicate, kept)
+static bool mergeStudentPairs(const vector<pair<int, int>>& pairs) {
+    StudentCleanup c;
+    auto t0 = chrono::steady_clock::now();
+    if (!students.merge(pairs, c)) {
+        printError();
+        return false;
     }
+    printCleanup(c, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+    return true;
+}
 
-    sqlite3_finalize(stmt);
+static void removeStudents() {
+    vector<int> ids;
+    if (!parseIdList(readText("\nStudent IDs to remove (spaces or commas between): "), ids) || ids.empty()) return;
+    if (!confirmStudentBatch("Remove", ids.size())) return;
+    removeStudentIds(ids);
 }
 
-static void returnShako() {
-    const char* sql =
-        "SELECT SHAKO_ID, COALESCE(SIZE,''), CHECKED_OUT_TO, COALESCE(CHECKED_OUT_DATE,''), "
-        "       COALESCE(CONDITION_NOTES,'') "
-        "FROM SHAKOS WHERE CHECKED_OUT_TO IS NOT NULL ORDER BY SHAKO_ID;";
+static void mergeStudents() {
+    int keep = readInt("\nStudent ID to keep: ");
+    vector<int> dups;
+    if (!parseIdList(readText("Duplicate IDs to merge into it: "), dups) || dups.empty()) return;
+    if (!confirmStudentBatch("Merge away", dups.size())) return;
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+    vector<pair<int, int>> pairs;
+    for (int d : dups) pairs.push_back({d, keep});
+    mergeStudentPairs(pairs);
+}
+
+static bool importInventoryFile(const string& path, InventoryKind kind) {
+    ImportResult r;
+    const char* what = kind == InventoryKind::Instruments ? "instruments"
+                     : kind == InventoryKind::Uniforms ? "uniforms" : "shakos";
+    if (!inventory.importFile(path, kind, r)) {
+        printImportFailure(r, what);
+        return false;
     }
+    cout << "Added " << r.added << " " << what << " to inventory in " << fixed << setprecision(3) << r.writeSec << "s.\n";
+    printImportCommits(r);
+    printKeyChecks(r);
+    if (r.duplicates) cout << r.duplicates << " duplicate serial(s) were not added.\n";
+    printParseErrors(r.errors);
+    return true;
+}
 
-    cout << "\nChecked-Out Shakos:\n";
-    cout << "ID   SIZE         STUDENT   DATE       CONDITION NOTES\n";
-    cout << "-------------------------------------------------------\n";
+static void bulkLoadInventory(InventoryKind kind, const char* format) {
+    string path = trim(readText(string("\nInventory file path (") + format + "): "));
+    if (path.empty()) return;
+    importInventoryFile(path, kind);
+}
 
-    bool any = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        any = true;
-        cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(13) << colText(stmt, 1)
-             << setw(10) << sqlite3_column_int(stmt, 2)
-             << setw(12) << colText(stmt, 3)
-             << colText(stmt, 4)
-             << "\n";
+static void bulkLoadInstruments() {
+    bulkLoadInventory(InventoryKind::Instruments, "TYPE_NAME,SERIAL[,NOTES]");
+}
+
+static void bulkLoadUniforms() {
+    bulkLoadInventory(InventoryKind::Uniforms, "COAT_SIZE,PANT_SIZE,COAT_NUMBER,PANT_NUMBER[,NOTES]");
+}
+
+static void bulkLoadShakos() {
+    bulkLoadInventory(InventoryKind::Shakos, "SIZE[,NOTES]");
+}
+
+static bool importComplianceFile(const string& path, unsigned threads) {
+    ImportResult r;
+    if (!compliance.importFile(path, threads, r)) {
+        printImportFailure(r, "compliance rows");
+        return false;
     }
-    sqlite3_finalize(stmt);
 
-    if (!any) {
-        cout << "None.\n";
-        return;
+    cout << "Parsed " << r.parsed << " rows in " << fixed << setprecision(3) << r.parseSec << "s";
+    if (r.parseSec > 0) cout << " (" << setprecision(0) << r.parsed / r.parseSec << " rows/s, " << r.threads << " threads)";
+    cout << "\n";
+    cout << "Applied " << r.added << " compliance rows in " << setprecision(3) << r.writeSec << "s.\n";
+    printImportCommits(r);
+    if (r.duplicates) cout << r.duplicates << " repeated student line(s); the last one in the file was used.\n";
+
+    printParseErrors(r.errors);
+    if (!r.unknownIds.empty()) {
+        cout << r.unknownIds.size() << " unknown student ID(s) skipped:";
+        for (size_t i = 0; i < r.unknownIds.size() && i < 20; i++) cout << " " << r.unknownIds[i];
+        if (r.unknownIds.size() > 20) cout << " ... and " << r.unknownIds.size() - 20 << " more";
+        cout << "\n";
     }
+    return true;
+}
 
-    cout << "\nEnter SHAKO_ID to return: ";
-    int shakoId;
-    cin >> shakoId;
+static void importRegistrarFile() {
+    string path = trim(readText("\nRegistrar file path (STUDENT_ID,CREDIT_HOURS,GPA per line): "));
+    if (path.empty()) return;
+    importComplianceFile(path, 0);
+}
 
-    const char* upd =
-        "UPDATE SHAKOS SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL WHERE SHAKO_ID=?;";
+// ---------- BATCH COMMANDS ----------
+// Prints eligibility events after `afterId` as tab-separated lines:
+// EVENT_ID, STUDENT_ID, WAS_ELIGIBLE, IS_ELIGIBLE, CHANGED_AT.
+// Returns the id of the last event printed (or afterId if none).
+static sqlite3_int64 printEligibilityEvents(sqlite3_int64 afterId) {
+    vector<EligibilityEvent> events;
+    if (!compliance.eventsAfter(afterId, events)) {
+        cerr << db.lastError() << "\n";
+        return afterId;
+    }
+
+    sqlite3_int64 last = afterId;
+    for (const EligibilityEvent& e : events) {
+        last = e.eventId;
+        cout << e.eventId << '\t'
+             << e.studentId << '\t'
+             << e.wasEligible << '\t'
+             << e.isEligible << '\t'
+             << e.changedAt << '\n';
+    }
+    cout.flush();
+    return last;
+}
 
-    sqlite3_stmt* updStmt = nullptr;
-    if (sqlite3_prepare_v2(db, upd, -1, &updStmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+// band feed [AFTER_EVENT_ID] [--follow]
+// With --follow the command keeps running and prints new events as other
+// connections commit them (detected through PRAGMA data_version).
+static int feedCommand(int argc, char** argv) {
+    sqlite3_int64 afterId = 0;
+    bool follow = false;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--follow") follow = true;
+        else afterId = atoll(arg.c_str());
     }
 
-    sqlite3_bind_int(updStmt, 1, shakoId);
+    afterId = printEligibilityEvents(afterId);
+    if (!follow) return EXIT_SUCCESS;
 
-    if (sqlite3_step(updStmt) != SQLITE_DONE) {
-        cout << "Return failed: " << sqlite3_errmsg(db) << "\n";
-    } else {
-        cout << (sqlite3_changes(db) ? "Shako returned.\n" : "No shako with that ID.\n");
+    sqlite3_int64 seen = db.dataVersion();
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(500));
+        sqlite3_int64 v = db.dataVersion();
+        if (v == seen) continue;
+        seen = v;
+        afterId = printEligibilityEvents(afterId);
     }
+}
 
-    sqlite3_finalize(updStmt);
+static void printUsage() {
+    cout << "Usage: band                                   interactive menus\n"
+         << "       band feed [AFTER_ID] [--follow]        eligibility changes after AFTER_ID\n"
+         << "       band import-roster FILE                add students from CSV/TSV\n"
+         << "       band import-compliance FILE [THREADS]  registrar GPA/credits upsert\n"
+         << "       band import-instruments FILE           TYPE_NAME,SERIAL[,NOTES]\n"
+         << "       band import-uniforms FILE              COAT_SIZE,PANT_SIZE,COAT_NO,PANT_NO[,NOTES]\n"
+         << "       band import-shakos FILE                SIZE[,NOTES]\n"
+         << "       band stats                             WAL size and checkpoint timings\n"
+         << "       band check [THREADS]                   integrity and cross-table invariants\n"
+         << "       band leaders                           section leader roll-up\n"
+         << "       band undo | band redo                  step back/forward through recent changes\n"
+         << "       band remove-students ID...|--file FILE delete students, checking their gear back in\n"
+         << "       band merge-students KEEP DUP...        merge duplicates into KEEP\n"
+         << "       band merge-students --file FILE        merge DUP,KEEP pairs, one per line\n"
+         << "                                              (past 100 students both ask first; --yes skips it)\n"
+         << "       band analytics [--synthetic ROWS]      GPA/credit distributions\n"
+         << "       band bench-parse FILE [--generate MB]  tokenizer throughput\n"
+         << "       band bench-durability [WRITES]         commit cost per durability profile\n"
+         << "       band bench-input [COMMANDS]            prompt input parsing throughput\n"
+         << "       band bench-threads [LOOKUPS]           lookups/s by threading mode, 1-16 threads\n"
+         << "       band bench-compliance [STUDENTS]       COMPLIANCE layouts: report, upsert, size\n"
+         << "       band migrate-compliance LAYOUT         rebuild COMPLIANCE as rowid|without-rowid\n"
+         << "       band bench-dates [ROWS]                text vs day-number dates: size, range queries\n"
+         << "       band migrate-dates text|days           rebuild the date columns in that encoding\n"
+         << "       band kiosk                             check-in lookups from the compact roster\n"
+         << "       band bench-kiosk [STUDENTS]            compact roster vs SQLite: memory, lookups\n"
+         << "       band bench-filter [KEYS]               key filters: false positives, lookups saved\n"
+         << "Options: --durability=full|normal|batched|off (or BAND_DURABILITY)\n"
+         << "         --checkpoint=passive|restart|truncate|off (or BAND_CHECKPOINT)\n"
+         << "         --threading=serialized|multi (or BAND_THREADING)\n"
+         << "         --commit=single|auto[:MS]|ROWS[/MS] import batching (or BAND_COMMIT)\n";
 }
 
-static void viewShakoAssignments() {
-    const char* sql =
-        "SELECT SHAKO_ID, COALESCE(SIZE,''), COALESCE(CHECKED_OUT_TO,0), "
-        "       COALESCE(CHECKED_OUT_DATE,''), COALESCE(CONDITION_NOTES,'') "
-        "FROM SHAKOS ORDER BY (CHECKED_OUT_TO IS NULL) DESC, SHAKO_ID;";
+// band bench-parse FILE [--generate MB]
+// Tokenizes FILE with the mapped reader and with getline + istringstream and
+// reports throughput for both. --generate first writes a synthetic roster of
+// roughly MB megabytes (with quoted and escaped fields) to FILE.
+static bool generateRosterFile(const string& path, size_t megabytes) {
+    static const char* sections[] = {"WOODWIND", "BRASS", "PERCUSSION", "AUXILIARY", "DM"};
+    static const char* classes[] = {"Freshman", "Sophomore", "Junior", "Senior"};
+    static const char* shirts[] = {"XS", "S", "M", "L", "XL", "XXL"};
+
+    ofstream out(path, ios::binary);
+    if (!out) return false;
+
+    size_t target = megabytes << 20, written = 0;
+    string line;
+    for (unsigned long id = 100000; written < target; id++) {
+        line = to_string(id);
+        line += id % 7 == 0 ? ",\"Mary, Ann\"" : ",Jordan";
+        line += id % 11 == 0 ? ",\"O\"\"Neal\"" : ",Williams";
+        line += ',';
+        line += classes[id % 4];
+        line += ',';
+        line += sections[id % 5];
+        line += ',';
+        line += shirts[id % 6];
+        line += ',';
+        line += to_string(6 + id % 9);
+        line += '\n';
+        out << line;
+        written += line.size();
+    }
+    return (bool)out;
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+static int benchParseCommand(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    string path = argv[2];
+    if (argc > 4 && string(argv[3]) == "--generate") {
+        size_t mb = (size_t)atoll(argv[4]);
+        cout << "Writing " << mb << " MB to " << path << "...\n";
+        if (!generateRosterFile(path, mb)) {
+            cout << "Can't write " << path << "\n";
+            return EXIT_FAILURE;
+        }
     }
 
-    cout << "\nSHAKO ASSIGNMENTS\n";
-    cout << "ID   SIZE         STUDENT   DATE       CONDITION NOTES\n";
-    cout << "-------------------------------------------------------\n";
+    auto t0 = chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        cout << "Can't read " << path << "\n";
+        return EXIT_FAILURE;
+    }
+    char delim = detectDelimiter(file.data, file.size);
+    size_t records = 0, fields = 0, bytes = 0;
+    DelimitedReader reader(file.data, file.data + file.size, delim);
+    while (reader.next()) {
+        records++;
+        fields += reader.fields.size();
+        for (string_view f : reader.fields) bytes += f.size();
+    }
+    double mappedSec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    double mb = file.size / 1048576.0;
+    file.close();
+
+    auto t1 = chrono::steady_clock::now();
+    ifstream in(path, ios::binary);
+    string line, field;
+    size_t baseRecords = 0, baseFields = 0;
+    while (getline(in, line)) {
+        baseRecords++;
+        istringstream ss(line);
+        while (getline(ss, field, delim)) baseFields++;
+    }
+    double baseSec = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+
+    cout << fixed << setprecision(1)
+         << "File: " << mb << " MB, " << records << " records, " << fields << " fields ("
+         << bytes << " field bytes)\n"
+         << "mapped reader:        " << setprecision(3) << mappedSec << "s  "
+         << setprecision(0) << mb / mappedSec << " MB/s  " << records / mappedSec << " records/s\n"
+         << "getline+istringstream: " << setprecision(3) << baseSec << "s  "
+         << setprecision(0) << mb / baseSec << " MB/s  " << baseRecords / baseSec << " records/s"
+         << " (" << baseFields << " fields, quotes not handled)\n"
+         << "speedup: " << setprecision(1) << baseSec / mappedSec << "x\n";
+    return EXIT_SUCCESS;
+}
 
-    bool any = false;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        any = true;
-        cout << left
-             << setw(5) << sqlite3_column_int(stmt, 0)
-             << setw(13) << colText(stmt, 1)
-             << setw(10) << sqlite3_column_int(stmt, 2)
-             << setw(12) << colText(stmt, 3)
-             << colText(stmt, 4)
+// band import-compliance FILE [THREADS]
+static int importComplianceCommand(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    unsigned threads = argc > 3 ? (unsigned)atoi(argv[3]) : 0;
+    return importComplianceFile(argv[2], threads) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// band bench-durability [WRITES]
+// Runs WRITES single-row writes under every durability profile against a
+// scratch database in the current directory (band-durability-bench.db) and
+// reports writes/s and commit latency. Under "full" the commit latency is
+// essentially the disk's fsync latency, so the max column is the worst case.
+static int benchDurabilityCommand(int argc, char** argv) {
+    int writes = argc > 2 ? max(1, atoi(argv[2])) : 2000;
+    const string path = "band-durability-bench.db";
+
+    cout << "PROFILE  SYNC    WRITES/S  COMMITS  P50 ms  P99 ms  MAX ms\n";
+    cout << "----------------------------------------------------------\n";
+
+    for (const DurabilityProfile& p : DURABILITY_PROFILES) {
+        for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+
+        sqlite3* conn = nullptr;
+        if (sqlite3_open(path.c_str(), &conn) != SQLITE_OK || !applyDurability(conn, p)) {
+            cout << "Can't open " << path << "\n";
+            sqlite3_close(conn);
+            return EXIT_FAILURE;
+        }
+        sqlite3_exec(conn, "CREATE TABLE T (ID INTEGER PRIMARY KEY, V TEXT);", nullptr, nullptr, nullptr);
+
+        sqlite3_stmt* ins = nullptr;
+        sqlite3_prepare_v2(conn, "INSERT INTO T (V) VALUES ('checked out');", -1, &ins, nullptr);
+
+        vector<double> commitMs;
+        bool open = false;
+        auto batchStart = chrono::steady_clock::now();
+        auto start = batchStart;
+        for (int i = 0; i < writes; i++) {
+            if (p.commitIntervalMs && !open) {
+                sqlite3_exec(conn, "BEGIN;", nullptr, nullptr, nullptr);
+                open = true;
+                batchStart = chrono::steady_clock::now();
+            }
+
+            auto t0 = chrono::steady_clock::now();
+            sqlite3_step(ins);
+            sqlite3_reset(ins);
+            if (!p.commitIntervalMs) {
+                commitMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+                continue;
+            }
+
+            bool last = i + 1 == writes;
+            if (last || chrono::steady_clock::now() - batchStart >= chrono::milliseconds(p.commitIntervalMs)) {
+                auto c0 = chrono::steady_clock::now();
+                sqlite3_exec(conn, "COMMIT;", nullptr, nullptr, nullptr);
+                commitMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - c0).count());
+                open = false;
+            }
+        }
+        double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        sqlite3_finalize(ins);
+        sqlite3_close(conn);
+
+        sort(commitMs.begin(), commitMs.end());
+        auto pct = [&](double q) { return commitMs[(size_t)(q * (double)(commitMs.size() - 1))]; };
+        cout << left << setw(9) << p.name << setw(8) << p.synchronous << right
+             << setw(8) << fixed << setprecision(0) << writes / sec
+             << setw(9) << commitMs.size()
+             << setprecision(3)
+             << setw(8) << pct(0.50)
+             << setw(8) << pct(0.99)
+             << setw(8) << commitMs.back()
              << "\n";
     }
-    if (!any) cout << "(none)\n";
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+    return EXIT_SUCCESS;
+}
+
+// band analytics [--synthetic ROWS]
+static int analyticsCommand(int argc, char** argv) {
+    size_t synthetic = 0;
+    if (argc > 3 && string(argv[2]) == "--synthetic") synthetic = (size_t)atoll(argv[3]);
+    return runAnalytics(synthetic) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
+// band import-roster FILE
+static int importRosterCommand(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    return importRosterFile(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Reads the IDs of `band remove-students` / `band merge-students`: either
+// IDs as arguments or --file FILE, plus --yes anywhere to skip the question.
+static bool readIdArgs(int argc, char** argv, size_t fileColumns, vector<int>& ids, bool& fromFile,
+                       bool& assumeYes) {
+    fromFile = assumeYes = false;
+    string file;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--yes") {
+            assumeYes = true;
+        } else if (arg == "--file" && i + 1 < argc) {
+            file = argv[++i];
+            fromFile = true;
+        } else if (!parseIdList(arg, ids)) {
+            return false;
+        }
+    }
+    if (fromFile && ids.empty()) return readIdFile(file, fileColumns, ids);
+    if (!fromFile && !ids.empty()) return true;
+    printUsage();
+    return false;
+}
+
+// band remove-students [--yes] ID... | --file FILE
+static int removeStudentsCommand(int argc, char** argv) {
+    vector<int> ids;
+    bool fromFile, assumeYes;
+    if (!readIdArgs(argc, argv, 1, ids, fromFile, assumeYes)) return EXIT_FAILURE;
+    if (ids.empty()) {
+        cout << "No student IDs to remove.\n";
+        return EXIT_FAILURE;
+    }
+    if (!assumeYes && ids.size() > StudentRepo::UNDO_BATCH_LIMIT && !confirmStudentBatch("Remove", ids.size()))
+        return EXIT_FAILURE;
+    return removeStudentIds(ids) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// band merge-students [--yes] KEEP DUP... | --file FILE
+static int mergeStudentsCommand(int argc, char** argv) {
+    vector<int> ids;
+    bool fromFile, assumeYes;
+    if (!readIdArgs(argc, argv, 2, ids, fromFile, assumeYes)) return EXIT_FAILURE;
+
+    vector<pair<int, int>> pairs;
+    if (fromFile) {
+        for (size_t i = 0; i < ids.size(); i += 2) pairs.push_back({ids[i], ids[i + 1]});
+    } else {
+        for (size_t i = 1; i < ids.size(); i++) pairs.push_back({ids[i], ids[0]});
+    }
+    if (pairs.empty()) {
+        cout << "No duplicates to merge.\n";
+        return EXIT_FAILURE;
+    }
+    if (!assumeYes && pairs.size() > StudentRepo::UNDO_BATCH_LIMIT && !confirmStudentBatch("Merge away", pairs.size()))
+        return EXIT_FAILURE;
+    return mergeStudentPairs(pairs) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// band import-instruments|import-uniforms|import-shakos FILE
+static int importInventoryCommand(int argc, char** argv, InventoryKind kind) {
+    if (argc < 3) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    return importInventoryFile(argv[2], kind) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// band bench-input [COMMANDS]
+// Writes a script of COMMANDS menu answers (choices, IDs, GPAs and names,
+// default one million) and reads it back twice: with iostream extraction as
+// the prompts used to, and with the buffered line reader they use now.
+static int benchInputCommand(int argc, char** argv) {
+    size_t commands = argc > 2 ? (size_t)atoll(argv[2]) : 1000000;
+    const string path = "band-input-bench.txt";
+    {
+        ofstream out(path, ios::binary);
+        for (size_t i = 0; i < commands; i++) {
+            switch (i % 4) {
+                case 0: out << 1 + i % 7 << "\n"; break;
+                case 1: out << 100000 + i % 90000 << "\n"; break;
+                case 2: out << (i % 401) / 100.0 << "\n"; break;
+                default: out << (i % 3 ? "Williams" : "  O'Neal ") << "\n"; break;
+            }
+        }
+        if (!out) {
+            cout << "Can't write " << path << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    long long intSum = 0, baseIntSum = 0;
+    double gpaSum = 0, baseGpaSum = 0;
+    size_t textBytes = 0, baseTextBytes = 0;
+
+    auto t0 = chrono::steady_clock::now();
+    {
+        ifstream in(path, ios::binary);
+        string text;
+        for (size_t i = 0; i < commands; i++) {
+            if (i % 4 == 3) {
+                getline(in, text);
+                baseTextBytes += trim(text).size();
+                continue;
+            }
+            if (i % 4 == 2) {
+                double x;
+                in >> x;
+                baseGpaSum += x;
+            } else {
+                int x;
+                in >> x;
+                baseIntSum += x;
+            }
+            in.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+    }
+    double baseSec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    auto t1 = chrono::steady_clock::now();
+    {
+        InputBuffer in;
+#ifdef _WIN32
+        in.fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        in.fd = open(path.c_str(), O_RDONLY);
+#endif
+        if (in.fd < 0) {
+            cout << "Can't read " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        string_view line;
+        for (size_t i = 0; i < commands && nextLine(in, line); i++) {
+            if (i % 4 == 3) {
+                textBytes += trimView(line).size();
+            } else if (i % 4 == 2) {
+                double x = 0;
+                parseNumber(line, x);
+                gpaSum += x;
+            } else {
+                int x = 0;
+                parseNumber(line, x);
+                intSum += x;
+            }
+        }
+#ifdef _WIN32
+        _close(in.fd);
+#else
+        close(in.fd);
+#endif
+    }
+    double fastSec = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+    remove(path.c_str());
+
+    if (intSum != baseIntSum || textBytes != baseTextBytes || fabs(gpaSum - baseGpaSum) > 1e-6 * commands) {
+        cout << "Readers disagree on the script contents.\n";
+        return EXIT_FAILURE;
+    }
+    cout << fixed << setprecision(3)
+         << commands << " commands\n"
+         << "iostream extraction: " << baseSec << "s  " << setprecision(0) << commands / baseSec << " commands/s\n"
+         << setprecision(3)
+         << "buffered reader:     " << fastSec << "s  " << setprecision(0) << commands / fastSec << " commands/s\n"
+         << "speedup: " << setprecision(1) << baseSec / fastSec << "x\n";
+    return EXIT_SUCCESS;
+}
+
+// band bench-threads [LOOKUPS]
+// Splits LOOKUPS primary-key reads (default 400000) over 1-16 threads against
+// a scratch database (band-threads-bench.db) three ways: every thread on one
+// shared serialized connection, one serialized connection per thread, and
+// one multi-thread (NOMUTEX) connection per thread.
+enum class BenchSharing { SharedConnection, PerThread };
+
+static double benchLookups(const string& path, unsigned threads, size_t lookups, int rows,
+                           BenchSharing sharing, ThreadingMode mode) {
+    sqlite3* shared = nullptr;
+    if (sharing == BenchSharing::SharedConnection &&
+        sqlite3_open_v2(path.c_str(), &shared, connectionFlags(SQLITE_OPEN_READONLY, mode), nullptr) != SQLITE_OK) {
+        sqlite3_close(shared);
+        return 0.0;
+    }
+
+    // Workers open and prepare first; the clock starts once all of them are
+    // ready, so only the lookups are timed.
+    atomic<bool> failed{false};
+    atomic<unsigned> ready{0};
+    atomic<bool> go{false};
+    auto work = [&](unsigned worker) {
+        sqlite3* conn = shared;
+        if (!conn && sqlite3_open_v2(path.c_str(), &conn, connectionFlags(SQLITE_OPEN_READONLY, mode), nullptr) != SQLITE_OK) {
+            failed = true;
+            sqlite3_close(conn);
+            conn = nullptr;
+        }
+        sqlite3_stmt* stmt = nullptr;
+        if (conn) sqlite3_prepare_v2(conn, "SELECT NAME, SECTION FROM T WHERE ID=?;", -1, &stmt, nullptr);
+        ready++;
+        while (!go) this_thread::yield();
+        if (!stmt) {
+            failed = true;
+            if (conn != shared) sqlite3_close(conn);
+            return;
+        }
+        uint32_t seed = 2654435761u * (worker + 1);
+        size_t n = lookups / threads;
+        for (size_t i = 0; i < n; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            sqlite3_bind_int(stmt, 1, (int)(seed % (uint32_t)rows) + 1);
+            if (sqlite3_step(stmt) != SQLITE_ROW) failed = true;
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        if (conn != shared) sqlite3_close(conn);
+    };
+
+    vector<thread> workers;
+    for (unsigned i = 0; i < threads; i++) workers.emplace_back(work, i);
+    while (ready < threads) this_thread::yield();
+    auto t0 = chrono::steady_clock::now();
+    go = true;
+    for (thread& t : workers) t.join();
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    sqlite3_close(shared);
+    return failed ? 0.0 : (double)(lookups / threads * threads) / sec;
+}
+
+static int benchThreadsCommand(int argc, char** argv) {
+    size_t lookups = argc > 2 ? (size_t)max(16LL, atoll(argv[2])) : 400000;
+    const string path = "band-threads-bench.db";
+    const int rows = 100000;
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+
+    {
+        sqlite3* conn = nullptr;
+        if (!openConnection(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, conn)) {
+            cout << "Can't create " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        applyDurability(conn, *findDurabilityProfile("off"));
+        sqlite3_exec(conn,
+            "CREATE TABLE T (ID INTEGER PRIMARY KEY, NAME TEXT, SECTION TEXT);"
+            "WITH RECURSIVE N(I) AS (SELECT 1 UNION ALL SELECT I+1 FROM N WHERE I < 100000) "
+            "INSERT INTO T SELECT I, 'Student ' || I, "
+            "  CASE I % 5 WHEN 0 THEN 'WOODWIND' WHEN 1 THEN 'BRASS' WHEN 2 THEN 'PERCUSSION' "
+            "  WHEN 3 THEN 'AUXILIARY' ELSE 'DM' END FROM N;",
+            nullptr, nullptr, nullptr);
+        sqlite3_close(conn);
+    }
+
+    cout << "SQLite " << sqlite3_libversion() << ", SQLITE_THREADSAFE=" << sqlite3_threadsafe() << ", "
+         << thread::hardware_concurrency() << " cores, " << lookups << " lookups per run\n\n";
+    cout << "THREADS  SHARED CONN/S  SERIALIZED/S  MULTI-THREAD/S  MULTI vs SERIALIZED\n";
+    cout << "-----------------------------------------------------------------------\n";
+    benchLookups(path, 1, lookups, rows, BenchSharing::PerThread, ThreadingMode::Serialized);   // warm the OS cache
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u}) {
+        double shared = benchLookups(path, threads, lookups, rows, BenchSharing::SharedConnection,
+                                     ThreadingMode::Serialized);
+        double serialized = benchLookups(path, threads, lookups, rows, BenchSharing::PerThread,
+                                         ThreadingMode::Serialized);
+        double multi = benchLookups(path, threads, lookups, rows, BenchSharing::PerThread,
+                                    ThreadingMode::MultiThread);
+        if (!shared || !serialized || !multi) {
+            cout << "Lookups failed against " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        cout << setw(7) << threads << fixed << setprecision(0) << setw(15) << shared << setw(14) << serialized
+             << setw(16) << multi << setw(20) << setprecision(2) << multi / serialized << "x\n";
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+    return EXIT_SUCCESS;
+}
+
+// band migrate-compliance rowid|without-rowid
+static int migrateComplianceCommand(int argc, char** argv) {
+    ComplianceLayout from, to;
+    if (argc < 3 || !findComplianceLayout(argv[2], to)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    if (!db.complianceLayout(from)) {
+        printError();
+        return EXIT_FAILURE;
+    }
+    if (from == to) {
+        cout << "COMPLIANCE is already " << complianceLayoutName(to) << ".\n";
+        return EXIT_SUCCESS;
+    }
+    auto t0 = chrono::steady_clock::now();
+    if (!db.migrateCompliance(to)) {
+        printError();
+        return EXIT_FAILURE;
+    }
+    cout << "COMPLIANCE rebuilt " << complianceLayoutName(from) << " -> " << complianceLayoutName(to) << " in "
+         << fixed << setprecision(3) << chrono::duration<double>(chrono::steady_clock::now() - t0).count() << "s.\n";
+    return EXIT_SUCCESS;
+}
+
+// band migrate-dates text|days
+static int migrateDatesCommand(int argc, char** argv) {
+    DateEncoding to;
+    if (argc < 3 || !findDateEncoding(argv[2], to)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    DateEncoding from = db.dateEncoding();
+    if (from == to) {
+        cout << "Dates are already stored as " << dateEncodingName(to) << ".\n";
+        return EXIT_SUCCESS;
+    }
+    auto t0 = chrono::steady_clock::now();
+    if (!db.migrateDates(to)) {
+        printError();
+        return EXIT_FAILURE;
+    }
+    cout << "Dates rebuilt " << dateEncodingName(from) << " -> " << dateEncodingName(to) << " in "
+         << fixed << setprecision(3) << chrono::duration<double>(chrono::steady_clock::now() - t0).count() << "s.\n";
+    return EXIT_SUCCESS;
+}
+
+// band bench-compliance [STUDENTS]
+// Builds a scratch database (band-compliance-bench.db) of STUDENTS (default
+// 100000) with their compliance data in four layouts - COMPLIANCE as a rowid
+// table, the same plus a covering index on the eligibility columns, WITHOUT
+// ROWID, and the columns folded into STUDENTS - and times for each the
+// eligibility report join, the per-section eligible counts (hot columns only)
+// and single-row upserts as updateStudentCompliance does them, plus the file
+// size after VACUUM. The tables carry no triggers, so only the layout differs.
+struct ComplianceBenchLayout {
+    const char* name;
+    const char* schema;         // run after STUDENTS is created
+    bool folded;
+};
+
+static const ComplianceBenchLayout COMPLIANCE_BENCH_LAYOUTS[] = {
+    {"rowid", "CREATE TABLE COMPLIANCE (STUDENT_ID INTEGER PRIMARY KEY, CREDIT_HOURS INTEGER NOT NULL DEFAULT 0, "
+              "GPA REAL NOT NULL DEFAULT 0.0, DUES_PAID INTEGER NOT NULL DEFAULT 0, LAST_VERIFIED_DATE TEXT);", false},
+    {"rowid + covering", "CREATE TABLE COMPLIANCE (STUDENT_ID INTEGER PRIMARY KEY, CREDIT_HOURS INTEGER NOT NULL DEFAULT 0, "
+              "GPA REAL NOT NULL DEFAULT 0.0, DUES_PAID INTEGER NOT NULL DEFAULT 0, LAST_VERIFIED_DATE TEXT);"
+              "CREATE INDEX IDX_COMPLIANCE_ELIGIBILITY ON COMPLIANCE(STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID);", false},
+    {"without rowid", "CREATE TABLE COMPLIANCE (STUDENT_ID INTEGER PRIMARY KEY, CREDIT_HOURS INTEGER NOT NULL DEFAULT 0, "
+              "GPA REAL NOT NULL DEFAULT 0.0, DUES_PAID INTEGER NOT NULL DEFAULT 0, LAST_VERIFIED_DATE TEXT) "
+              "WITHOUT ROWID;", false},
+    {"folded", "", true},
+};
+
+// Best of `runs`, in ms; every column of every row is read.
+static double benchQuery(sqlite3* conn, const string& sql, int runs) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return -1.0;
+    double best = -1.0;
+    for (int r = 0; r < runs; r++) {
+        auto t0 = chrono::steady_clock::now();
+        size_t bytes = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            for (int i = 0; i < sqlite3_column_count(stmt); i++) bytes += (size_t)sqlite3_column_bytes(stmt, i);
+        sqlite3_reset(stmt);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        if (best < 0 || ms < best) best = ms;
+    }
     sqlite3_finalize(stmt);
+    return best;
 }
 
-// ---------- COMPLIANCE ----------
-static void updateStudentCompliance() {
-    int id;
-    cout << "\nStudent ID: ";
-    cin >> id;
-    clearInputLine();
+static int benchComplianceCommand(int argc, char** argv) {
+    int students = argc > 2 ? max(1000, atoi(argv[2])) : 100000;
+    int upserts = min(students, 20000);
+    const string path = "band-compliance-bench.db";
+
+    cout << "SQLite " << sqlite3_libversion() << ", " << students << " students; queries best of 3, "
+         << upserts << " upserts in autocommit, synchronous=OFF\n\n";
+    cout << "LAYOUT             REPORT ms  COUNTS ms  UPSERT us  FILE KB\n";
+    cout << "-----------------------------------------------------------\n";
+
+    for (const ComplianceBenchLayout& layout : COMPLIANCE_BENCH_LAYOUTS) {
+        for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+        sqlite3* conn = nullptr;
+        if (!openConnection(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, conn)) {
+            cout << "Can't create " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        applyDurability(conn, *findDurabilityProfile("off"));
+
+        const string c = layout.folded ? "s" : "c";
+        string hot = string(layout.folded ? ", CREDIT_HOURS INTEGER NOT NULL DEFAULT 0, GPA REAL NOT NULL DEFAULT 0.0, "
+                                            "DUES_PAID INTEGER NOT NULL DEFAULT 0, LAST_VERIFIED_DATE TEXT" : "");
+        string numbers = "WITH RECURSIVE N(I) AS (SELECT 1 UNION ALL SELECT I+1 FROM N WHERE I < " +
+                         to_string(students) + ") ";
+        string complianceValues = "(I * 37) % 31, ((I * 53) % 401) / 100.0, I % 3 <> 0, "
+                                  "date('2025-01-01', '+' || (I % 300) || ' days')";
+        string sql =
+            "CREATE TABLE STUDENTS (STUDENT_ID INTEGER PRIMARY KEY, FNAME TEXT NOT NULL, LNAME TEXT NOT NULL, "
+            "CLASSIFICATION TEXT, SECTION TEXT NOT NULL, SHIRT_SIZE TEXT, SHOE_SIZE TEXT, PRIMARY_ROLE TEXT, "
+            "ACTIVE INTEGER NOT NULL DEFAULT 1" + hot + ");"
+            "CREATE INDEX IDX_STUDENTS_SECTION ON STUDENTS(SECTION);" + layout.schema +
+            "BEGIN;" + numbers +
+            "INSERT INTO STUDENTS SELECT 100000 + I, 'Fn' || I, 'Ln' || (I * 7919 % 100003), "
+            "  CASE I % 4 WHEN 0 THEN 'Freshman' WHEN 1 THEN 'Sophomore' WHEN 2 THEN 'Junior' ELSE 'Senior' END, "
+            "  CASE I % 5 WHEN 0 THEN 'WOODWIND' WHEN 1 THEN 'BRASS' WHEN 2 THEN 'PERCUSSION' "
+            "  WHEN 3 THEN 'AUXILIARY' ELSE 'DM' END, 'M', '9', NULL, 1" +
+            (layout.folded ? ", " + complianceValues : string()) + " FROM N;";
+        if (!layout.folded) sql += numbers + "INSERT INTO COMPLIANCE SELECT 100000 + I, " + complianceValues + " FROM N;";
+        sql += "COMMIT; VACUUM; ANALYZE;";
+        if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            cout << "Can't build the " << layout.name << " layout: " << sqlite3_errmsg(conn) << "\n";
+            sqlite3_close(conn);
+            return EXIT_FAILURE;
+        }
 
-    if (!studentExists(id)) {
-        cout << "This student ID doesn't exist. Please add the student first!\n";
-        return;
+        sqlite3_int64 pages = 0, pageSize = 0;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(conn, "SELECT page_count, page_size FROM pragma_page_count, pragma_page_size;",
+                               -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+            pages = sqlite3_column_int64(stmt, 0);
+            pageSize = sqlite3_column_int64(stmt, 1);
+        }
+        sqlite3_finalize(stmt);
+
+        // The same SQL the engine runs, with the compliance columns read from
+        // the folded STUDENTS row when there is no join.
+        string from = layout.folded ? "FROM STUDENTS s " : "FROM STUDENTS s LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID ";
+        string eligible = "(COALESCE(" + c + ".CREDIT_HOURS,0) >= 12 AND COALESCE(" + c + ".GPA,0.0) >= 3.0 AND "
+                          "COALESCE(" + c + ".DUES_PAID,0)=1)";
+        string report =
+            "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, COALESCE(s.CLASSIFICATION,''), s.SECTION, "
+            "       COALESCE(s.SHIRT_SIZE,''), COALESCE(s.SHOE_SIZE,''), "
+            "       COALESCE(" + c + ".CREDIT_HOURS,0), COALESCE(" + c + ".GPA,0.0), COALESCE(" + c + ".DUES_PAID,0), "
+            "       COALESCE(" + c + ".LAST_VERIFIED_DATE,''), COALESCE(s.PRIMARY_ROLE,''), COALESCE(s.ACTIVE,1) " +
+            from + "ORDER BY " + eligible + " ASC, s.SECTION, s.LNAME, s.FNAME;";
+        string counts = "SELECT s.SECTION, COUNT(*), SUM" + eligible + " " + from + "GROUP BY s.SECTION;";
+        double reportMs = benchQuery(conn, report, 3);
+        double countsMs = benchQuery(conn, counts, 3);
+
+        const char* upsertSql = layout.folded
+            ? "UPDATE STUDENTS SET CREDIT_HOURS=?2, GPA=?3, DUES_PAID=?4, LAST_VERIFIED_DATE=date('now') "
+              "WHERE STUDENT_ID=?1;"
+            : "INSERT INTO COMPLIANCE (STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
+              "VALUES (?1, ?2, ?3, ?4, date('now')) "
+              "ON CONFLICT(STUDENT_ID) DO UPDATE SET CREDIT_HOURS=excluded.CREDIT_HOURS, GPA=excluded.GPA, "
+              "DUES_PAID=excluded.DUES_PAID, LAST_VERIFIED_DATE=excluded.LAST_VERIFIED_DATE;";
+        double upsertUs = -1.0;
+        if (sqlite3_prepare_v2(conn, upsertSql, -1, &stmt, nullptr) == SQLITE_OK) {
+            uint32_t seed = 12345;
+            bool ok = true;
+            auto t0 = chrono::steady_clock::now();
+            for (int i = 0; i < upserts; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                sqlite3_bind_int(stmt, 1, 100001 + (int)(seed % (uint32_t)students));
+                sqlite3_bind_int(stmt, 2, (int)(seed >> 8) % 31);
+                sqlite3_bind_double(stmt, 3, (int)(seed >> 12) % 401 / 100.0);
+                sqlite3_bind_int(stmt, 4, (int)(seed >> 20) & 1);
+                ok = ok && sqlite3_step(stmt) == SQLITE_DONE;
+                sqlite3_reset(stmt);
+            }
+            if (ok) upsertUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / upserts;
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(conn);
+
+        if (reportMs < 0 || countsMs < 0 || upsertUs < 0) {
+            cout << "The " << layout.name << " layout failed against " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        cout << left << setw(17) << layout.name << right << fixed << setprecision(1) << setw(11) << reportMs
+             << setw(11) << countsMs << setw(11) << setprecision(2) << upsertUs << setw(9)
+             << pages * pageSize / 1024 << "\n";
     }
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+    return EXIT_SUCCESS;
+}
 
-    int hours = readIntInRange("Credit hours (0-30): ", 0, 30);
-    double gpa = readDoubleInRange("GPA (0.00-4.00): ", 0.0, 4.0);
-    int dues = readBool01("Dues paid? (1=yes, 0=no): ");
+// band bench-dates [ROWS]
+// Fills a scratch database (band-dates-bench.db) with COMPLIANCE rows (default
+// 200000) whose LAST_VERIFIED_DATE spans two years, once as text and once as
+// day numbers, and compares: table and date-index size after VACUUM, a 30-day
+// range count scanning the table, the same count through the index (1000
+// windows), and reading every date back as text through the *_TEXT view.
+static int benchDatesCommand(int argc, char** argv) {
+    int rows = argc > 2 ? max(1000, atoi(argv[2])) : 200000;
+    const int windows = 1000;
+    const string path = "band-dates-bench.db";
+
+    cout << "SQLite " << sqlite3_libversion() << ", " << rows << " rows, dates over 730 days; "
+         << "scan and view best of 3, " << windows << " indexed 30-day windows\n\n";
+    cout << "ENCODING  TABLE KB  INDEX KB   SCAN ms  INDEXED us   VIEW ms\n";
+    cout << "-------------------------------------------------------------\n";
+
+    for (DateEncoding encoding : {DateEncoding::Text, DateEncoding::Days}) {
+        bool days = encoding == DateEncoding::Days;
+        for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+        sqlite3* conn = nullptr;
+        if (!openConnection(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, conn)) {
+            cout << "Can't create " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        applyDurability(conn, *findDurabilityProfile("off"));
+
+        auto fileKb = [&]() -> sqlite3_int64 {
+            sqlite3_int64 bytes = 0;
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(conn, "SELECT page_count * page_size FROM pragma_page_count, pragma_page_size;",
+                                   -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+                bytes = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+            return bytes / 1024;
+        };
+
+        string date = "date('2024-01-01', '+' || (I * 7919 % 730) || ' days')";
+        if (days) date = "CAST(julianday(" + date + ") + 0.5 AS INTEGER)";
+        string sql =
+            string("CREATE TABLE COMPLIANCE (STUDENT_ID INTEGER PRIMARY KEY, CREDIT_HOURS INTEGER NOT NULL DEFAULT 0, "
+                   "GPA REAL NOT NULL DEFAULT 0.0, DUES_PAID INTEGER NOT NULL DEFAULT 0, LAST_VERIFIED_DATE ") +
+            (days ? "INTEGER" : "TEXT") + ");"
+            "CREATE VIEW COMPLIANCE_TEXT AS SELECT STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, " +
+            (days ? "date(LAST_VERIFIED_DATE)" : "LAST_VERIFIED_DATE") + " AS LAST_VERIFIED_DATE FROM COMPLIANCE;"
+            "BEGIN; WITH RECURSIVE N(I) AS (SELECT 1 UNION ALL SELECT I+1 FROM N WHERE I < " + to_string(rows) + ") "
+            "INSERT INTO COMPLIANCE SELECT 100000 + I, (I * 37) % 31, ((I * 53) % 401) / 100.0, I % 3 <> 0, " +
+            date + " FROM N; COMMIT; VACUUM;";
+        sqlite3_int64 tableKb = 0, indexKb = 0;
+        bool ok = sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        if (ok) tableKb = fileKb();
+        ok = ok && sqlite3_exec(conn, "CREATE INDEX IDX_COMPLIANCE_VERIFIED ON COMPLIANCE(LAST_VERIFIED_DATE); "
+                                      "VACUUM; ANALYZE;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        if (ok) indexKb = fileKb() - tableKb;
+
+        // Window starts are day numbers; text bounds are computed once per
+        // statement, not per row.
+        string range = days ? "LAST_VERIFIED_DATE BETWEEN ?1 AND ?1 + 29"
+                            : "LAST_VERIFIED_DATE BETWEEN date(?1) AND date(?1, '+29 days')";
+        sqlite3_stmt* scan = nullptr;
+        sqlite3_stmt* indexed = nullptr;
+        ok = ok &&
+             sqlite3_prepare_v2(conn, ("SELECT COUNT(*) FROM COMPLIANCE NOT INDEXED WHERE " + range + ";").c_str(),
+                                -1, &scan, nullptr) == SQLITE_OK &&
+             sqlite3_prepare_v2(conn, ("SELECT COUNT(*) FROM COMPLIANCE INDEXED BY IDX_COMPLIANCE_VERIFIED WHERE " +
+                                       range + ";").c_str(), -1, &indexed, nullptr) == SQLITE_OK;
+        const sqlite3_int64 firstDay = 2460311;        // 2024-01-01
+        sqlite3_int64 matched = 0;
+        double scanMs = -1.0, indexedUs = 0.0, viewMs = -1.0;
+        if (ok) {
+            for (int r = 0; r < 3; r++) {
+                auto t0 = chrono::steady_clock::now();
+                sqlite3_bind_int64(scan, 1, firstDay + 300);
+                sqlite3_step(scan);
+                matched = sqlite3_column_int64(scan, 0);
+                sqlite3_reset(scan);
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+                if (scanMs < 0 || ms < scanMs) scanMs = ms;
+            }
+            sqlite3_int64 check = 0;
+            auto t0 = chrono::steady_clock::now();
+            for (int w = 0; w < windows; w++) {
+                sqlite3_bind_int64(indexed, 1, firstDay + (w * 37) % 700);
+                sqlite3_step(indexed);
+                check += sqlite3_column_int64(indexed, 0);
+                sqlite3_reset(indexed);
+            }
+            indexedUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / windows;
+            ok = check > 0;
+            viewMs = benchQuery(conn, "SELECT STUDENT_ID, LAST_VERIFIED_DATE FROM COMPLIANCE_TEXT;", 3);
+        }
+        sqlite3_finalize(scan);
+        sqlite3_finalize(indexed);
+        if (!ok || viewMs < 0) {
+            cout << "The " << dateEncodingName(encoding) << " run failed: " << sqlite3_errmsg(conn) << "\n";
+            sqlite3_close(conn);
+            return EXIT_FAILURE;
+        }
+        sqlite3_close(conn);
+        cout << left << setw(8) << dateEncodingName(encoding) << right << setw(10) << tableKb << setw(10) << indexKb
+             << fixed << setprecision(1) << setw(10) << scanMs << setw(12) << setprecision(2) << indexedUs
+             << setw(10) << setprecision(1) << viewMs << "   (" << matched << " rows in the scanned window)\n";
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+    return EXIT_SUCCESS;
+}
+
+// band kiosk
+// The check-in desk: each line is a student ID or the start of a last name,
+// answered from a CompactRoster. The roster is reloaded when another
+// connection commits. SQLite's page cache is let go after every load, so the
+// roster is the only copy of the students held in memory.
+static void printKioskStudent(const CompactRoster& roster, const PackedStudent& r) {
+    StudentProfile p = roster.profile(r);
+    cout << left << setw(8) << p.student.id << setw(24) << (p.student.fname + " " + p.student.lname).substr(0, 23)
+         << setw(11) << p.student.section << setw(13) << (roster.eligible(r) ? "ELIGIBLE" : "NOT ELIGIBLE") << right
+         << p.compliance.creditHours << " hrs, GPA " << fixed << setprecision(2) << p.compliance.gpa << ", dues "
+         << (p.compliance.duesPaid ? "paid" : "unpaid") << (p.student.active ? "" : " (inactive)") << "\n";
+}
 
-    const char* sql =
+static int kioskCommand() {
+    const size_t maxMatches = 20;
+    CompactRoster roster;
+    auto load = [&]() {
+        if (!roster.load(db)) {
+            printError();
+            return false;
+        }
+        sqlite3_db_release_memory(db.handle());
+        cout << "Roster: " << roster.size() << " students in " << roster.bytes() / 1024 << " KB ("
+             << fixed << setprecision(1) << (roster.size() ? (double)roster.bytes() / roster.size() : 0.0)
+             << " bytes each)\n";
+        return true;
+    };
+    if (!load()) return EXIT_FAILURE;
+
+    string_view line;
+    vector<const PackedStudent*> matches;
+    while (true) {
+        cout << "\nID or last name: ";
+        if (!nextLine(stdinBuffer, line)) break;
+        line = trimView(line);
+        if (line.empty()) continue;
+        if (roster.stale(db) && !load()) return EXIT_FAILURE;
+
+        int id;
+        if (parseNumber(line, id)) {
+            if (const PackedStudent* r = roster.find(id)) printKioskStudent(roster, *r);
+            else cout << "No student " << id << ".\n";
+            continue;
+        }
+        roster.matchLastName(string(line), matches);
+        if (matches.empty()) cout << "No last name starts with '" << line << "'.\n";
+        for (size_t i = 0; i < matches.size() && i < maxMatches; i++) printKioskStudent(roster, *matches[i]);
+        if (matches.size() > maxMatches) cout << "... and " << matches.size() - maxMatches << " more.\n";
+    }
+    cout << "\n";
+    return EXIT_SUCCESS;
+}
+
+// band bench-kiosk [STUDENTS]
+// Builds a scratch band-kiosk-bench.db (default 100000 students, a few
+// hundred first names, a last name for every four students) and compares the
+// CompactRoster with SQLite serving the same rows. Memory: the roster's bytes
+// against the page cache a connection fills reading every student with their
+// COMPLIANCE row. Speed: lookups by ID with eligibility, and last-name prefix
+// searches. Every record is also checked against SQL.
+static int benchKioskCommand(int argc, char** argv) {
+    int count = argc > 2 ? max(1000, atoi(argv[2])) : 100000;
+    const int lookups = 200000, prefixes = 200;
+    const string path = "band-kiosk-bench.db";
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+
+    Database bench;
+    bench.setCheckpointMode("off");
+    string sql =
+        "BEGIN; WITH RECURSIVE N(I) AS (SELECT 1 UNION ALL SELECT I+1 FROM N WHERE I < " + to_string(count) + ") "
+        "INSERT INTO STUDENTS (STUDENT_ID, FNAME, LNAME, CLASSIFICATION, SECTION, SHIRT_SIZE, SHOE_SIZE, "
+        "                      PRIMARY_ROLE, ACTIVE) "
+        "SELECT 100000 + I, 'First' || (I * 7 % 400), 'Ln' || (I * 7919 % " + to_string(count / 4 + 1) + "), "
+        "  CASE I % 4 WHEN 0 THEN 'Freshman' WHEN 1 THEN 'Sophomore' WHEN 2 THEN 'Junior' ELSE 'Senior' END, "
+        "  CASE I % 5 WHEN 0 THEN 'WOODWIND' WHEN 1 THEN 'BRASS' WHEN 2 THEN 'PERCUSSION' "
+        "  WHEN 3 THEN 'AUXILIARY' ELSE 'DM' END, 'M', '9', CASE WHEN I % 50 = 0 THEN 'Captain' END, I % 97 <> 0 "
+        "FROM N; "
+        "WITH RECURSIVE N(I) AS (SELECT 1 UNION ALL SELECT I+1 FROM N WHERE I < " + to_string(count) + ") "
         "INSERT INTO COMPLIANCE (STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
-        "VALUES (?, ?, ?, ?, date('now')) "
-        "ON CONFLICT(STUDENT_ID) DO UPDATE SET "
-        "CREDIT_HOURS=excluded.CREDIT_HOURS, "
-        "GPA=excluded.GPA, "
-        "DUES_PAID=excluded.DUES_PAID, "
-        "LAST_VERIFIED_DATE=excluded.LAST_VERIFIED_DATE;";
+        "SELECT 100000 + I, (I * 37) % 31, ((I * 53) % 401) / 100.0, I % 3 <> 0, date('now') FROM N; "
+        "DELETE FROM CHANGE_LOG; COMMIT; VACUUM;";
+    if (!bench.open(path, *findDurabilityProfile("off")) || !bench.exec(sql)) {
+        cout << "Can't build " << path << ": " << bench.lastError() << "\n";
+        bench.close();
+        return EXIT_FAILURE;
+    }
 
+    // What the engine's own connection may cache, in KB.
+    sqlite3_int64 cacheLimitKb = 0;
     sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+    if (sqlite3_prepare_v2(bench.handle(), "SELECT cache_size, page_size FROM pragma_cache_size, pragma_page_size;",
+                           -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        sqlite3_int64 size = sqlite3_column_int64(stmt, 0);
+        cacheLimitKb = size < 0 ? -size : size * sqlite3_column_int64(stmt, 1) / 1024;
     }
+    sqlite3_finalize(stmt);
 
-    sqlite3_bind_int(stmt, 1, id);
-    sqlite3_bind_int(stmt, 2, hours);
-    sqlite3_bind_double(stmt, 3, gpa);
-    sqlite3_bind_int(stmt, 4, dues);
+    CompactRoster roster;
+    auto t0 = chrono::steady_clock::now();
+    bool ok = roster.load(bench);
+    double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+    // A connection of its own, with room for every page it touches.
+    sqlite3* conn = nullptr;
+    sqlite3_stmt* all = nullptr;
+    sqlite3_stmt* byId = nullptr;
+    sqlite3_stmt* byName = nullptr;
+    const char* columns =
+        "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, COALESCE(s.CLASSIFICATION,''), s.SECTION, "
+        "       COALESCE(s.PRIMARY_ROLE,''), COALESCE(s.ACTIVE,1), "
+        "       COALESCE(c.CREDIT_HOURS,0), COALESCE(c.GPA,0.0), COALESCE(c.DUES_PAID,0) "
+        "FROM STUDENTS s LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID ";
+    ok = ok && openConnection(path, SQLITE_OPEN_READONLY, conn) &&
+         sqlite3_exec(conn, "PRAGMA cache_size=-1048576;", nullptr, nullptr, nullptr) == SQLITE_OK &&
+         sqlite3_prepare_v2(conn, (string(columns) + "ORDER BY s.STUDENT_ID;").c_str(), -1, &all, nullptr) == SQLITE_OK &&
+         sqlite3_prepare_v2(conn, (string(columns) + "WHERE s.STUDENT_ID=?;").c_str(), -1, &byId, nullptr) == SQLITE_OK &&
+         sqlite3_prepare_v2(conn, (string(columns) + "WHERE s.LNAME LIKE ? || '%' ORDER BY s.STUDENT_ID;").c_str(),
+                            -1, &byName, nullptr) == SQLITE_OK;
+
+    size_t checked = 0, mismatched = 0;
+    int cacheUsed = 0, highwater = 0;
+    while (ok && sqlite3_step(all) == SQLITE_ROW) {
+        const PackedStudent* r = roster.find(sqlite3_column_int(all, 0));
+        checked++;
+        if (!r) {
+            mismatched++;
+            continue;
+        }
+        StudentProfile p = roster.profile(*r);
+        Compliance c;
+        c.creditHours = sqlite3_column_int(all, 7);
+        c.gpa = sqlite3_column_double(all, 8);
+        c.duesPaid = sqlite3_column_int(all, 9) == 1;
+        if (p.student.fname != (const char*)sqlite3_column_text(all, 1) ||
+            p.student.lname != (const char*)sqlite3_column_text(all, 2) ||
+            p.student.classification != (const char*)sqlite3_column_text(all, 3) ||
+            p.student.section != (const char*)sqlite3_column_text(all, 4) ||
+            p.student.role != (const char*)sqlite3_column_text(all, 5) ||
+            p.student.active != (sqlite3_column_int(all, 6) != 0) || p.compliance.creditHours != c.creditHours ||
+            p.compliance.duesPaid != c.duesPaid || roster.eligible(*r) != c.eligible() ||
+            (int)(p.compliance.gpa * 100.0 + 0.5) != (int)(c.gpa * 100.0 + 0.5))
+            mismatched++;
+    }
+    if (ok) sqlite3_db_status(conn, SQLITE_DBSTATUS_CACHE_USED, &cacheUsed, &highwater, 0);
+
+    // Lookups: the same random IDs, and the same prefixes, both ways.
+    vector<int> ids(lookups);
+    vector<string> names(prefixes);
+    uint32_t seed = 2463534242u;
+    for (int& id : ids) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;      // xorshift32
+        id = 100001 + (int)(seed % (uint32_t)count);
+    }
+    for (string& name : names) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        name = "Ln" + to_string(seed % (uint32_t)(count / 4 + 1)).substr(0, 3);
+    }
+    size_t compactHits = 0, sqlHits = 0;
+    double compactIdUs = 0, sqlIdUs = 0, compactNameMs = 0, sqlNameMs = 0;
+    if (ok) {
+        t0 = chrono::steady_clock::now();
+        for (int id : ids) {
+            const PackedStudent* r = roster.find(id);
+            if (r && roster.eligible(*r)) compactHits++;
+        }
+        compactIdUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / lookups;
+
+        t0 = chrono::steady_clock::now();
+        for (int id : ids) {
+            sqlite3_bind_int(byId, 1, id);
+            if (sqlite3_step(byId) == SQLITE_ROW) {
+                Compliance c;
+                c.creditHours = sqlite3_column_int(byId, 7);
+                c.gpa = sqlite3_column_double(byId, 8);
+                c.duesPaid = sqlite3_column_int(byId, 9) == 1;
+                if (c.eligible()) sqlHits++;
+            }
+            sqlite3_reset(byId);
+        }
+        sqlIdUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / lookups;
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        cout << "Update failed: " << sqlite3_errmsg(db) << "\n";
-    } else {
-        cout << "Compliance saved.\n";
+        vector<const PackedStudent*> matches;
+        t0 = chrono::steady_clock::now();
+        for (const string& name : names) {
+            roster.matchLastName(name, matches);
+            compactHits += matches.size();
+        }
+        compactNameMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / prefixes;
+
+        t0 = chrono::steady_clock::now();
+        for (const string& name : names) {
+            sqlite3_bind_text(byName, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(byName) == SQLITE_ROW) sqlHits++;
+            sqlite3_reset(byName);
+        }
+        sqlNameMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / prefixes;
+    }
+    sqlite3_finalize(all);
+    sqlite3_finalize(byId);
+    sqlite3_finalize(byName);
+    if (conn) sqlite3_close(conn);
+    bench.close();
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+    if (!ok) {
+        cout << "The kiosk benchmark failed against " << path << "\n";
+        return EXIT_FAILURE;
     }
 
-    sqlite3_finalize(stmt);
+    cout << "SQLite " << sqlite3_libversion() << ", " << count << " students, " << roster.distinctNames()
+         << " distinct first and last names\n\n";
+    cout << fixed << setprecision(1);
+    cout << "Compact roster     " << setw(8) << roster.bytes() / 1024 << " KB " << setw(7)
+         << (double)roster.bytes() / count << " bytes/student   (loaded in " << loadMs << " ms)\n";
+    cout << "SQLite page cache  " << setw(8) << cacheUsed / 1024 << " KB " << setw(7) << (double)cacheUsed / count
+         << " bytes/student   (the engine's cache_size caps it at " << cacheLimitKb << " KB)\n";
+    if (mismatched) cout << mismatched << " of " << checked << " records differ from SQL!\n";
+    else cout << "All " << checked << " records match SQL.\n";
+    cout << "\nLOOKUP                          COMPACT    SQLITE\n";
+    cout << "-------------------------------------------------\n";
+    cout << "ID + eligibility (us)     " << setprecision(3) << setw(13) << compactIdUs << setw(10) << sqlIdUs << "\n";
+    cout << "Last-name prefix (ms)     " << setw(13) << compactNameMs << setw(10) << sqlNameMs << "\n";
+    if (compactHits != sqlHits) cout << "Lookups disagree: " << compactHits << " vs " << sqlHits << "\n";
+    return mismatched || compactHits != sqlHits ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
-static void showEligibilityReport() {
-    const char* sql =
-        "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, s.CLASSIFICATION, s.SECTION, "
-        "       COALESCE(c.CREDIT_HOURS,0), COALESCE(c.GPA,0.0), COALESCE(c.DUES_PAID,0), "
-        "       COALESCE(c.LAST_VERIFIED_DATE,''), "
-        "       (COALESCE(c.CREDIT_HOURS,0) >= 12) AS OK_HRS, "
-        "       (COALESCE(c.GPA,0.0) >= 3.0) AS OK_GPA, "
-        "       (COALESCE(c.DUES_PAID,0) = 1) AS OK_DUES, "
-        "       (COALESCE(c.CREDIT_HOURS,0) >= 12 AND COALESCE(c.GPA,0.0) >= 3.0 AND COALESCE(c.DUES_PAID,0)=1) AS ELIG "
-        "FROM STUDENTS s "
-        "LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID "
-        "ORDER BY ELIG ASC, s.SECTION, s.LNAME, s.FNAME;";
+static void bindKey(sqlite3_stmt* stmt, int id) { sqlite3_bind_int(stmt, 1, id); }
+static void bindKey(sqlite3_stmt* stmt, const string& serial) {
+    sqlite3_bind_text(stmt, 1, serial.data(), (int)serial.size(), SQLITE_STATIC);
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        cout << "SQL error: " << sqlite3_errmsg(db) << "\n";
-        return;
+// Checks every key with one lookup each, or only those `filter` can't rule
+// out when it is given. Returns how many keys were found.
+template <class Key>
+static size_t checkKeys(sqlite3_stmt* probe, const KeyFilter* filter, const vector<Key>& keys,
+                        size_t& lookups, double& usPerKey) {
+    size_t found = 0;
+    lookups = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (const Key& key : keys) {
+        if (filter && !filter->mayContain(KeyFilter::hash(key))) continue;
+        lookups++;
+        bindKey(probe, key);
+        if (sqlite3_step(probe) == SQLITE_ROW) found++;
+        sqlite3_reset(probe);
+    }
+    usPerKey = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / keys.size();
+    return found;
+}
+
+// band bench-filter [KEYS]
+// Builds a scratch band-filter-bench.db holding KEYS students (default
+// 100000) and as many instruments with serials, all on even key numbers, then
+// checks keys the way a bulk import meets them: nine in ten are new. For each
+// key filter it reports the size, the false-positive rate over every odd
+// (absent) key, and the lookups and time per check with and without the
+// filter in front of SQLite.
+static int benchFilterCommand(int argc, char** argv) {
+    int count = argc > 2 ? max(1000, atoi(argv[2])) : 100000;
+    const string path = "band-filter-bench.db";
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+
+    Database bench;
+    bench.setCheckpointMode("off");
+    string rows = "WITH RECURSIVE N(I) AS (SELECT 0 UNION ALL SELECT I+1 FROM N WHERE I < " + to_string(count - 1) + ") ";
+    string sql =
+        "BEGIN; " + rows +
+        "INSERT INTO STUDENTS (STUDENT_ID, FNAME, LNAME, SECTION) SELECT 100000 + 2 * I, 'First', 'Last', 'BRASS' FROM N; " +
+        rows +
+        "INSERT INTO INSTRUMENTS (TYPE_ID, SERIAL) "
+        "SELECT (SELECT MIN(TYPE_ID) FROM INSTRUMENT_TYPES), printf('SN%08d', 2 * I) FROM N; "
+        "DELETE FROM CHANGE_LOG; COMMIT;";
+    if (!bench.open(path, *findDurabilityProfile("off")) || !bench.exec(sql)) {
+        cout << "Can't build " << path << ": " << bench.lastError() << "\n";
+        bench.close();
+        for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+        return EXIT_FAILURE;
     }
 
-    cout << "\nELIGIBILITY REPORT (needs: >=12 hrs, >=3.0 GPA, dues paid)\n";
-    cout << "ID   NAME                 CLASS      SECTION     HRS  GPA   DUES  OK_H OK_G OK_D ELIG  VERIFIED\n";
-    cout << "-----------------------------------------------------------------------------------------------\n";
+    auto t0 = chrono::steady_clock::now();
+    const KeyFilter* idFilter = bench.studentKeys();
+    double idBuildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    t0 = chrono::steady_clock::now();
+    const KeyFilter* serialFilter = bench.serialKeys();
+    double serialBuildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+    auto serialOf = [](int k) {
+        char buf[16];
+        snprintf(buf, sizeof buf, "SN%08d", k);
+        return string(buf);
+    };
+    size_t idFalse = 0, serialFalse = 0, missed = 0;
+    if (idFilter && serialFilter) {
+        for (int k = 0; k < 2 * count; k++) {
+            bool present = k % 2 == 0;
+            bool idMaybe = idFilter->mayContain(KeyFilter::hash((sqlite3_int64)(100000 + k)));
+            bool serialMaybe = serialFilter->mayContain(KeyFilter::hash(serialOf(k)));
+            if (present) {
+                missed += !idMaybe + !serialMaybe;
+            } else {
+                idFalse += idMaybe;
+                serialFalse += serialMaybe;
+            }
+        }
+    }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);
-        string name = string(colText(stmt, 1)) + " " + colText(stmt, 2);
-        string classif = colText(stmt, 3);
-        string sec = colText(stmt, 4);
-        int hrs = sqlite3_column_int(stmt, 5);
-        double gpa = sqlite3_column_double(stmt, 6);
-        int dues = sqlite3_column_int(stmt, 7);
-        string verified = colText(stmt, 8);
+    // The same key numbers for both tables.
+    vector<int> ids(count);
+    vector<string> serials(count);
+    uint32_t seed = 2463534242u;
+    for (int i = 0; i < count; i++) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;      // xorshift32
+        int k = 2 * (int)(seed % (uint32_t)count) + (seed % 10 != 0);
+        ids[i] = 100000 + k;
+        serials[i] = serialOf(k);
+    }
+
+    sqlite3_stmt* idProbe = nullptr;
+    sqlite3_stmt* serialProbe = nullptr;
+    bool ok = idFilter && serialFilter && missed == 0 &&
+              sqlite3_prepare_v2(bench.handle(), "SELECT 1 FROM STUDENTS WHERE STUDENT_ID=?;", -1, &idProbe, nullptr) == SQLITE_OK &&
+              sqlite3_prepare_v2(bench.handle(), "SELECT 1 FROM INSTRUMENTS WHERE SERIAL=?;", -1, &serialProbe, nullptr) == SQLITE_OK;
+    size_t lookups[4] = {0, 0, 0, 0}, found[4] = {0, 0, 0, 0};
+    double us[4] = {0, 0, 0, 0};
+    if (ok) {
+        found[0] = checkKeys(idProbe, nullptr, ids, lookups[0], us[0]);
+        found[1] = checkKeys(idProbe, idFilter, ids, lookups[1], us[1]);
+        found[2] = checkKeys(serialProbe, nullptr, serials, lookups[2], us[2]);
+        found[3] = checkKeys(serialProbe, serialFilter, serials, lookups[3], us[3]);
+    }
+    sqlite3_finalize(idProbe);
+    sqlite3_finalize(serialProbe);
+
+    size_t idBytes = idFilter ? idFilter->bytes() : 0, serialBytes = serialFilter ? serialFilter->bytes() : 0;
+    bench.close();
+    for (const char* suffix : {"", "-wal", "-shm"}) remove((path + suffix).c_str());
+    if (!ok) {
+        if (missed) cout << "A key filter ruled out " << missed << " key(s) that are in the table!\n";
+        else cout << "The filter benchmark failed against " << path << "\n";
+        return EXIT_FAILURE;
+    }
 
-        int okH = sqlite3_column_int(stmt, 9);
-        int okG = sqlite3_column_int(stmt, 10);
-        int okD = sqlite3_column_int(stmt, 11);
-        int elig = sqlite3_column_int(stmt, 12);
+    cout << "SQLite " << sqlite3_libversion() << ", " << count << " students and " << count
+         << " serials; " << count << " checks per run, about 90% for new keys\n\n";
+    cout << fixed << setprecision(1);
+    cout << "FILTER           KB  BITS/KEY  BUILD ms  FALSE POSITIVES\n";
+    cout << "--------------------------------------------------------\n";
+    cout << "STUDENT_ID  " << setw(7) << idBytes / 1024 << setw(10) << idBytes * 8.0 / count << setw(10) << idBuildMs
+         << setw(13) << setprecision(2) << 100.0 * idFalse / count << " %\n" << setprecision(1);
+    cout << "SERIAL      " << setw(7) << serialBytes / 1024 << setw(10) << serialBytes * 8.0 / count << setw(10)
+         << serialBuildMs << setw(13) << setprecision(2) << 100.0 * serialFalse / count << " %\n";
+    cout << "\nCHECK                       LOOKUPS  us/CHECK\n";
+    cout << "---------------------------------------------\n";
+    const char* labels[4] = {"STUDENT_ID, SQLite only", "STUDENT_ID, filter first", "SERIAL, SQLite only",
+                             "SERIAL, filter first"};
+    for (int i = 0; i < 4; i++)
+        cout << left << setw(26) << labels[i] << right << setw(9) << lookups[i] << setw(10) << setprecision(3)
+             << us[i] << "\n";
+    cout << "\nThe filters saved " << setprecision(1) << 100.0 - 100.0 * lookups[1] / lookups[0] << "% and "
+         << 100.0 - 100.0 * lookups[3] / lookups[2] << "% of the lookups.\n";
+    if (found[0] != found[1] || found[2] != found[3]) {
+        cout << "Runs disagree: " << found[0] << " vs " << found[1] << " IDs, " << found[2] << " vs " << found[3]
+             << " serials\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
-        cout << left
-             << setw(6)  << id
-             << setw(21) << name
-             << setw(11) << classif
-             << setw(12) << sec
-             << setw(5)  << hrs
-             << setw(6)  << fixed << setprecision(2) << gpa
-             << setw(6)  << (dues ? "YES" : "NO")
-             << setw(5)  << (okH ? "Y" : "N")
-             << setw(5)  << (okG ? "Y" : "N")
-             << setw(5)  << (okD ? "Y" : "N")
-             << setw(6)  << (elig ? "YES" : "NO")
-             << verified
-             << "\n";
+// band check [THREADS]
+// Exit status 0 only when every check ran and found nothing.
+static int checkCommand(int argc, char** argv) {
+    unsigned threads = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+    IntegrityReport r;
+    if (!IntegrityChecker(db).run(threads, r)) {
+        printError();
+        return EXIT_FAILURE;
     }
 
-    sqlite3_finalize(stmt);
-}
\ No newline at end of file
+    cout << "Integrity check: " << r.checks.size() << " checks on " << r.threads << " connections in "
+         << fixed << setprecision(3) << r.seconds << "s\n\n";
+    size_t failed = 0;
+    for (const CheckResult& c : r.checks) {
+        const char* status = !c.error.empty() ? "ERROR" : c.violations ? "FAIL" : "ok";
+        cout << left << setw(6) << status << setw(20) << c.name << right << setw(9) << setprecision(1)
+             << c.ms << " ms  " << c.description << "\n";
+        if (!c.error.empty()) cout << "      " << c.error << "\n";
+        for (const string& row : c.samples) cout << "      " << row << "\n";
+        if (c.violations > c.samples.size())
+            cout << "      ... and " << c.violations - c.samples.size() << " more\n";
+        if (c.violations || !c.error.empty()) failed++;
+    }
+    const PoolMetrics& m = r.pool;
+    cout << "\nPool: " << m.workers << " workers, " << m.tasks << " tasks, " << m.steals << " steals, "
+         << setprecision(1) << m.busyMs << " ms busy, " << m.idleMs << " ms idle; task latency p50 "
+         << m.latencyP50Ms << " / p95 " << m.latencyP95Ms << " / max " << m.latencyMaxMs << " ms\n\n";
+    if (r.clean()) cout << "No problems found.\n";
+    else cout << r.violations() << " violations; " << failed << " of " << r.checks.size() << " checks failed.\n";
+    return r.clean() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int runCommand(int argc, char** argv) {
+    string cmd = argv[1];
+    if (cmd == "feed") return feedCommand(argc, argv);
+    if (cmd == "import-roster") return importRosterCommand(argc, argv);
+    if (cmd == "remove-students") return removeStudentsCommand(argc, argv);
+    if (cmd == "merge-students") return mergeStudentsCommand(argc, argv);
+    if (cmd == "import-compliance") return importComplianceCommand(argc, argv);
+    if (cmd == "import-instruments") return importInventoryCommand(argc, argv, InventoryKind::Instruments);
+    if (cmd == "import-uniforms") return importInventoryCommand(argc, argv, InventoryKind::Uniforms);
+    if (cmd == "import-shakos") return importInventoryCommand(argc, argv, InventoryKind::Shakos);
+    if (cmd == "bench-parse") return benchParseCommand(argc, argv);
+    if (cmd == "analytics") return analyticsCommand(argc, argv);
+    if (cmd == "bench-durability") return benchDurabilityCommand(argc, argv);
+    if (cmd == "bench-input") return benchInputCommand(argc, argv);
+    if (cmd == "bench-threads") return benchThreadsCommand(argc, argv);
+    if (cmd == "check") return checkCommand(argc, argv);
+    if (cmd == "migrate-compliance") return migrateComplianceCommand(argc, argv);
+    if (cmd == "bench-compliance") return benchComplianceCommand(argc, argv);
+    if (cmd == "migrate-dates") return migrateDatesCommand(argc, argv);
+    if (cmd == "bench-dates") return benchDatesCommand(argc, argv);
+    if (cmd == "kiosk") return kioskCommand();
+    if (cmd == "bench-kiosk") return benchKioskCommand(argc, argv);
+    if (cmd == "bench-filter") return benchFilterCommand(argc, argv);
+    if (cmd == "stats") {
+        showDatabaseStats();
+        return EXIT_SUCCESS;
+    }
+    if (cmd == "undo" || cmd == "redo") return undoLastChange(cmd == "redo") ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (cmd == "leaders") {
+        showLeaderRollup();
+        return EXIT_SUCCESS;
+    }
+
+    printUsage();
+    return EXIT_FAILURE;
+}
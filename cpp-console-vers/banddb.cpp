@@ -0,0 +1,3983 @@
+// libbanddb - engine implementation. See banddb.h.
+
+#include "banddb.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_set>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+namespace banddb {
+
+static const char* colText(sqlite3_stmt* s, int i) {
+    const unsigned char* t = sqlite3_column_text(s, i);
+    return t ? (const char*)t : "";
+}
+
+static void bindOptionalText(sqlite3_stmt* stmt, int col, const string& v) {
+    if (v.empty()) sqlite3_bind_null(stmt, col);
+    else sqlite3_bind_text(stmt, col, v.c_str(), -1, SQLITE_TRANSIENT);
+}
+
+// Text bound straight from a mapped file, which outlives the statement step.
+static void bindOptionalView(sqlite3_stmt* stmt, int col, string_view v) {
+    if (v.empty()) sqlite3_bind_null(stmt, col);
+    else sqlite3_bind_text(stmt, col, v.data(), (int)v.size(), SQLITE_STATIC);
+}
+
+// ---------- Text helpers ----------
+string trim(const string& s) {
+    size_t a = 0, b = s.size();
+    while (a < b && isspace((unsigned char)s[a])) a++;
+    while (b > a && isspace((unsigned char)s[b - 1])) b--;
+    return s.substr(a, b - a);
+}
+
+string upperCopy(string s) {
+    for (char& c : s) c = (char)toupper((unsigned char)c);
+    return s;
+}
+
+string_view trimView(string_view s) {
+    size_t a = 0, b = s.size();
+    while (a < b && isspace((unsigned char)s[a])) a++;
+    while (b > a && isspace((unsigned char)s[b - 1])) b--;
+    return s.substr(a, b - a);
+}
+
+bool isValidSection(const string& s) {
+    static const vector<string> allowed = {"WOODWIND","BRASS","PERCUSSION","AUXILIARY","DM"};
+    return find(allowed.begin(), allowed.end(), s) != allowed.end();
+}
+
+// ---------- Delimited files ----------
+#ifdef _WIN32
+bool MappedFile::open(const string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(file, &len)) {
+        CloseHandle(file);
+        return false;
+    }
+    size = (size_t)len.QuadPart;
+    if (size == 0) {
+        CloseHandle(file);
+        data = &fallback[0];
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+    data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) return false;
+    mapped = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped) UnmapViewOfFile(data);
+    mapped = false;
+    data = nullptr;
+    size = 0;
+}
+#else
+bool MappedFile::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    size = (size_t)st.st_size;
+    if (size == 0) {
+        ::close(fd);
+        data = &fallback[0];
+        return true;
+    }
+
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    madvise(p, size, MADV_SEQUENTIAL);
+    data = (char*)p;
+    mapped = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mapped) munmap(data, size);
+    mapped = false;
+    data = nullptr;
+    size = 0;
+}
+#endif
+
+static inline unsigned lowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+// First position in [p, end) holding `a` or `b`, or end. Scans 16 bytes per
+// step where SSE2 is available.
+static const char* findEither(const char* p, const char* end, char a, char b) {
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+        if (mask) return p + lowestBit(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != a && *p != b) p++;
+    return p;
+}
+
+bool DelimitedReader::next() {
+    fields.clear();
+    if (p >= end) return false;
+    line = nextLine;
+
+    while (true) {
+        if (*p == '"') fields.push_back(quotedField());
+        else {
+            char* stop = (char*)findEither(p, end, delim, '\n');
+            char* last = stop;
+            if (last > p && last[-1] == '\r' && (last == end || *last == '\n')) last--;
+            fields.emplace_back(p, (size_t)(last - p));
+            p = stop;
+        }
+
+        if (p >= end) break;
+        if (*p == delim) {
+            if (++p == end) {
+                fields.emplace_back();
+                break;
+            }
+            continue;
+        }
+        p++;            // '\n'
+        nextLine++;
+        break;
+    }
+    return true;
+}
+
+string_view DelimitedReader::quotedField() {
+    char* start = ++p;
+    char* out = start;      // end of the unescaped text so far
+    bool escaped = false;
+    while (true) {
+        char* q = (char*)memchr(p, '"', (size_t)(end - p));
+        if (!q) q = end;
+        nextLine += (size_t)count(p, q, '\n');
+        if (escaped) {
+            memmove(out, p, (size_t)(q - p));
+            out += q - p;
+        } else {
+            out = q;
+        }
+        if (q >= end) {
+            p = end;
+            break;
+        }
+        if (q + 1 < end && q[1] == '"') {
+            *out++ = '"';
+            escaped = true;
+            p = q + 2;
+            continue;
+        }
+        p = q + 1;
+        break;
+    }
+    // Anything between the closing quote and the delimiter is dropped.
+    p = (char*)findEither(p, end, delim, '\n');
+    return string_view(start, (size_t)(out - start));
+}
+
+char detectDelimiter(const char* data, size_t size) {
+    const char* eol = (const char*)memchr(data, '\n', size);
+    if (!eol) eol = data + size;
+    bool tabs = find(data, eol, '\t') != eol;
+    bool commas = find(data, eol, ',') != eol;
+    return (tabs && !commas) ? '\t' : ',';
+}
+
+// ---------- Durability ----------
+const DurabilityProfile DURABILITY_PROFILES[4] = {
+    {"full",    "FULL",   1000, 0},
+    {"normal",  "NORMAL", 2000, 0},
+    {"batched", "NORMAL", 4000, 1000},
+    {"off",     "OFF",    8000, 0},
+};
+
+const DurabilityProfile* findDurabilityProfile(const string& name) {
+    for (const DurabilityProfile& p : DURABILITY_PROFILES)
+        if (name == p.name) return &p;
+    return nullptr;
+}
+
+bool applyDurability(sqlite3* conn, const DurabilityProfile& p, string* error) {
+    string sql = "PRAGMA journal_mode=WAL; PRAGMA synchronous=";
+    sql += p.synchronous;
+    sql += "; PRAGMA wal_autocheckpoint=" + to_string(p.walAutocheckpoint) + ";";
+    char* errMsg = nullptr;
+    if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        if (error) *error = string("SQL error: ") + (errMsg ? errMsg : "Unknown error");
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+// ---------- Threading ----------
+static ThreadingMode currentThreading = ThreadingMode::Serialized;
+
+bool setThreadingMode(ThreadingMode mode) {
+    if (!sqlite3_threadsafe()) return false;
+    currentThreading = mode;
+    return true;
+}
+
+ThreadingMode threadingMode() {
+    return currentThreading;
+}
+
+const char* threadingModeName(ThreadingMode mode) {
+    return mode == ThreadingMode::MultiThread ? "multi" : "serialized";
+}
+
+bool findThreadingMode(const string& name, ThreadingMode& out) {
+    if (name == "serialized") out = ThreadingMode::Serialized;
+    else if (name == "multi") out = ThreadingMode::MultiThread;
+    else return false;
+    return true;
+}
+
+int connectionFlags(int openFlags, ThreadingMode mode) {
+    return openFlags | SQLITE_OPEN_PRIVATECACHE |
+           (mode == ThreadingMode::MultiThread ? SQLITE_OPEN_NOMUTEX : SQLITE_OPEN_FULLMUTEX);
+}
+
+bool openConnection(const string& path, int openFlags, sqlite3*& conn, string* error) {
+    conn = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &conn, connectionFlags(openFlags), nullptr) == SQLITE_OK) return true;
+    if (error) *error = string("Can't open database: ") + (conn ? sqlite3_errmsg(conn) : "out of memory");
+    sqlite3_close(conn);
+    conn = nullptr;
+    return false;
+}
+
+// ---------- Commit policy ----------
+CommitPolicy CommitPolicy::single() {
+    return CommitPolicy();
+}
+
+CommitPolicy CommitPolicy::every(size_t rows, int intervalMs) {
+    CommitPolicy p;
+    p.rows = rows;
+    p.intervalMs = intervalMs;
+    return p;
+}
+
+CommitPolicy CommitPolicy::tuned(int stallMs) {
+    CommitPolicy p;
+    p.rows = 1000;              // first batch; tuning takes over from there
+    p.intervalMs = stallMs;
+    p.autoTune = true;
+    p.stallMs = stallMs;
+    return p;
+}
+
+bool parseCommitPolicy(const string& text, CommitPolicy& out) {
+    if (text == "single") {
+        out = CommitPolicy::single();
+        return true;
+    }
+    if (text.rfind("auto", 0) == 0) {
+        int ms = 50;
+        if (text.size() > 4 && (text[4] != ':' || !parseNumber(string_view(text).substr(5), ms))) return false;
+        if (ms <= 0) return false;
+        out = CommitPolicy::tuned(ms);
+        return true;
+    }
+    size_t slash = text.find('/');
+    size_t rows = 0;
+    int ms = 0;
+    if (!parseNumber(string_view(text).substr(0, slash), rows) || rows == 0) return false;
+    if (slash != string::npos && (!parseNumber(string_view(text).substr(slash + 1), ms) || ms <= 0)) return false;
+    out = CommitPolicy::every(rows, ms);
+    return true;
+}
+
+string describeCommitPolicy(const CommitPolicy& p) {
+    if (p.autoTune)
+        return "auto, batches held under " + to_string(p.stallMs) + " ms (now " + to_string(p.rows) + " rows)";
+    if (!p.rows && !p.intervalMs) return "single transaction";
+    string s = "every";
+    if (p.rows) s += " " + to_string(p.rows) + " rows";
+    if (p.rows && p.intervalMs) s += " or";
+    if (p.intervalMs) s += " " + to_string(p.intervalMs) + " ms";
+    return s;
+}
+
+// ---------- COMPLIANCE layout ----------
+const char* complianceLayoutName(ComplianceLayout layout) {
+    return layout == ComplianceLayout::WithoutRowid ? "without-rowid" : "rowid";
+}
+
+bool findComplianceLayout(const string& name, ComplianceLayout& out) {
+    if (name == "rowid") out = ComplianceLayout::Rowid;
+    else if (name == "without-rowid") out = ComplianceLayout::WithoutRowid;
+    else return false;
+    return true;
+}
+
+// ---------- Date encoding ----------
+const char* dateEncodingName(DateEncoding encoding) {
+    return encoding == DateEncoding::Days ? "days" : "text";
+}
+
+bool findDateEncoding(const string& name, DateEncoding& out) {
+    if (name == "text") out = DateEncoding::Text;
+    else if (name == "days") out = DateEncoding::Days;
+    else return false;
+    return true;
+}
+
+// ---------- Key filters ----------
+// The per-word bit positions come from multiplying the low half of the hash
+// by odd constants, as in Parquet's split-block filters.
+static const uint32_t KEY_FILTER_SALTS[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+static uint64_t mixBits(uint64_t h) {      // MurmurHash3's finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t KeyFilter::hash(sqlite3_int64 key) {
+    return mixBits((uint64_t)key);
+}
+
+uint64_t KeyFilter::hash(string_view key) {
+    uint64_t h = 0xcbf29ce484222325ULL;     // FNV-1a
+    for (unsigned char c : key) h = (h ^ c) * 0x100000001b3ULL;
+    return mixBits(h);
+}
+
+void KeyFilter::reset(size_t expectedKeys, unsigned bitsPerKey) {
+    size_t bits = max<size_t>(expectedKeys, 1) * bitsPerKey;
+    blocks.assign((bits + 511) / 512, Block{});
+    count = 0;
+    sizedFor = expectedKeys;
+}
+
+void KeyFilter::add(uint64_t h) {
+    Block& b = blocks[blockIndex(h)];
+    uint32_t low = (uint32_t)h;
+    for (int i = 0; i < 8; i++) b.words[i] |= 1ULL << ((low * KEY_FILTER_SALTS[i]) >> 26);
+    count++;
+}
+
+bool KeyFilter::mayContain(uint64_t h) const {
+    if (blocks.empty()) return true;
+    const Block& b = blocks[blockIndex(h)];
+    uint32_t low = (uint32_t)h;
+    for (int i = 0; i < 8; i++)
+        if (!(b.words[i] & (1ULL << ((low * KEY_FILTER_SALTS[i]) >> 26)))) return false;
+    return true;
+}
+
+// ---------- Database ----------
+bool Database::fail(const string& message) {
+    error = message;
+    return false;
+}
+
+bool Database::failSQL(const string& context) {
+    return fail(context + ": " + sqlite3_errmsg(conn));
+}
+
+bool Database::exec(const string& sql) {
+    char* errMsg = nullptr;
+    if (sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        error = string("SQL error: ") + (errMsg ? errMsg : "Unknown error");
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool Database::open(const string& path, const DurabilityProfile& p) {
+    close();
+    dbPath = path;
+    profile = &p;
+    if (p.walAutocheckpoint > 0) checkpointer.walThresholdPages = p.walAutocheckpoint;
+    if (!openConnection(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, conn, &error)) return false;
+    // A restart or truncate checkpoint holds the writer lock while it waits
+    // on readers (for up to its own 200 ms busy timeout), and the GUI writes
+    // through a connection of its own; writes here wait those out.
+    sqlite3_busy_timeout(conn, 5000);
+    applyDurability(conn, p, &error);   // a locked file keeps its old settings
+    ensureTables();
+    journal.load();
+    startCheckpointer();
+    return true;
+}
+
+void Database::close() {
+    if (!conn) return;
+    flushCommitBatch();
+    stopCheckpointer();
+    journal.reset();
+    dropKeyFilters();
+    sqlite3_close(conn);
+    conn = nullptr;
+}
+
+sqlite3_int64 Database::dataVersion() {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "PRAGMA data_version;", -1, &stmt, nullptr) != SQLITE_OK) return -1;
+    sqlite3_int64 v = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) v = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return v;
+}
+
+// Sized with half again the current keys as headroom, so a filter takes some
+// inserts before it is due for a rebuild.
+const KeyFilter* Database::refreshKeyFilter(KeyFilter& f, sqlite3_int64& version, const char* sql, bool textKeys) {
+    sqlite3_int64 now = dataVersion();
+    if (!f.empty() && now == version && f.keys() <= f.capacity()) return &f;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        failSQL();
+        return nullptr;
+    }
+    vector<uint64_t> hashes;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (textKeys) {
+            const char* text = (const char*)sqlite3_column_text(stmt, 0);
+            hashes.push_back(KeyFilter::hash(string_view(text, (size_t)sqlite3_column_bytes(stmt, 0))));
+        } else {
+            hashes.push_back(KeyFilter::hash(sqlite3_column_int64(stmt, 0)));
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    f.reset(max<size_t>(hashes.size() + hashes.size() / 2, 1024));
+    for (uint64_t h : hashes) f.add(h);
+    version = now;
+    return &f;
+}
+
+const KeyFilter* Database::studentKeys() {
+    return refreshKeyFilter(studentFilter, studentFilterVersion, "SELECT STUDENT_ID FROM STUDENTS;", false);
+}
+
+const KeyFilter* Database::serialKeys() {
+    return refreshKeyFilter(serialFilter, serialFilterVersion,
+                            "SELECT SERIAL FROM INSTRUMENTS WHERE SERIAL IS NOT NULL;", true);
+}
+
+void Database::addStudentKey(sqlite3_int64 studentId) {
+    if (!studentFilter.empty()) studentFilter.add(KeyFilter::hash(studentId));
+}
+
+void Database::addSerialKey(string_view serial) {
+    if (!serialFilter.empty()) serialFilter.add(KeyFilter::hash(serial));
+}
+
+void Database::dropKeyFilters() {
+    studentFilter = KeyFilter();
+    serialFilter = KeyFilter();
+}
+
+void Database::commitPoint(bool inputPending) {
+    if (!profile->commitIntervalMs) return;
+    bool idle = !inputPending;
+    if (batchOpen) {
+        auto age = chrono::steady_clock::now() - batchStarted;
+        if (!idle && age < chrono::milliseconds(profile->commitIntervalMs)) return;
+        exec("COMMIT;");
+        batchOpen = false;
+    }
+    if (!idle && exec("BEGIN;")) {
+        batchOpen = true;
+        batchStarted = chrono::steady_clock::now();
+    }
+}
+
+void Database::flushCommitBatch() {
+    if (batchOpen) exec("COMMIT;");
+    batchOpen = false;
+}
+
+bool Database::beginWrite() {
+    return exec("SAVEPOINT write_unit;");
+}
+
+bool Database::commitWrite() {
+    return exec("RELEASE write_unit;");
+}
+
+void Database::rollbackWrite() {
+    string saved = error;
+    exec("ROLLBACK TO write_unit; RELEASE write_unit;");
+    error = saved;
+}
+
+// ---------- Background checkpointer ----------
+// Automatic checkpoints run inside whichever commit crosses the threshold, so
+// one unlucky checkout pays for copying the whole WAL back. Instead the
+// foreground connection only reports WAL growth (wal_hook) and a thread with
+// its own connection checkpoints when the WAL passes walThresholdPages, or
+// every idleIntervalMs while anything is pending.
+bool Database::setCheckpointMode(const string& name) {
+    Checkpointer& c = checkpointer;
+    if (name == "passive") c.mode = SQLITE_CHECKPOINT_PASSIVE;
+    else if (name == "restart") c.mode = SQLITE_CHECKPOINT_RESTART;
+    else if (name == "truncate") c.mode = SQLITE_CHECKPOINT_TRUNCATE;
+    else if (name != "off") return false;
+
+    c.enabled = name != "off";
+    c.modeName = c.enabled ? name : "off (automatic)";
+    return true;
+}
+
+int Database::walHook(void* arg, sqlite3*, const char*, int frames) {
+    Checkpointer& c = static_cast<Database*>(arg)->checkpointer;
+    c.walFrames.store(frames);
+    if (frames >= c.walThresholdPages) c.wake.notify_one();
+    return SQLITE_OK;
+}
+
+void Database::runCheckpoint() {
+    Checkpointer& c = checkpointer;
+    int logFrames = 0, copied = 0;
+    auto t0 = chrono::steady_clock::now();
+    int rc = sqlite3_wal_checkpoint_v2(c.conn, nullptr, c.mode, &logFrames, &copied);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+    lock_guard<mutex> g(c.lock);
+    if (rc == SQLITE_BUSY) {
+        c.stats.busy++;
+        return;
+    }
+    if (rc != SQLITE_OK) return;
+    c.stats.runs++;
+    c.stats.framesCopied += (uint64_t)max(copied, 0);
+    c.stats.lastLogFrames = logFrames;
+    c.stats.lastMs = ms;
+    c.stats.totalMs += ms;
+    c.stats.maxMs = max(c.stats.maxMs, ms);
+    if (copied >= logFrames) c.walFrames.store(0);
+}
+
+void Database::checkpointLoop() {
+    Checkpointer& c = checkpointer;
+    unique_lock<mutex> g(c.lock);
+    while (!c.stopping) {
+        c.wake.wait_for(g, chrono::milliseconds(c.idleIntervalMs), [&] {
+            return c.stopping || c.walFrames.load() >= c.walThresholdPages;
+        });
+        if (c.stopping) break;
+        g.unlock();
+        runCheckpoint();
+        g.lock();
+    }
+}
+
+void Database::startCheckpointer() {
+    Checkpointer& c = checkpointer;
+    if (!c.enabled) return;
+    if (!openConnection(dbPath, SQLITE_OPEN_READWRITE, c.conn)) return;
+    sqlite3_busy_timeout(c.conn, 200);
+    // The connection only attaches to the WAL once it has read the database.
+    sqlite3_exec(c.conn, "SELECT COUNT(*) FROM sqlite_master;", nullptr, nullptr, nullptr);
+
+    c.stopping = false;
+    exec("PRAGMA wal_autocheckpoint=0;");
+    sqlite3_wal_hook(conn, walHook, this);
+    c.worker = thread(&Database::checkpointLoop, this);
+}
+
+void Database::stopCheckpointer() {
+    Checkpointer& c = checkpointer;
+    if (!c.worker.joinable()) return;
+    {
+        lock_guard<mutex> g(c.lock);
+        c.stopping = true;
+    }
+    c.wake.notify_one();
+    c.worker.join();
+    sqlite3_wal_hook(conn, nullptr, nullptr);
+    sqlite3_close(c.conn);
+    c.conn = nullptr;
+}
+
+static long long fileSize(const string& path) {
+    ifstream in(path, ios::binary | ios::ate);
+    return in ? (long long)in.tellg() : 0;
+}
+
+DatabaseStats Database::stats() {
+    DatabaseStats st;
+    {
+        lock_guard<mutex> g(checkpointer.lock);
+        st.checkpoints = checkpointer.stats;
+    }
+    st.durability = profile;
+    st.commitPolicy = commitRule;
+    complianceLayout(st.complianceLayout);
+    st.dateEncoding = dates;
+    st.threading = threadingMode();
+    st.sqliteThreadsafe = sqlite3_threadsafe();
+    st.databaseBytes = fileSize(dbPath);
+    st.walBytes = fileSize(dbPath + "-wal");
+    st.walFramesPending = checkpointer.walFrames.load();
+    st.checkpointMode = checkpointer.modeName;
+    st.backgroundCheckpoints = checkpointer.enabled;
+    st.checkpointThresholdPages = checkpointer.walThresholdPages;
+    st.checkpointIdleMs = checkpointer.idleIntervalMs;
+    return st;
+}
+
+// ---------- Instrument type catalog ----------
+// The default catalog is compiled in. At open it is merged with whatever is
+// in INSTRUMENT_TYPES (types added by the GUI or by hand) and kept in memory,
+// so instrument screens resolve TYPE_ID -> name/section without touching SQL.
+struct InstrumentTypeSeed {
+    const char* name;
+    const char* section;
+};
+
+static constexpr InstrumentTypeSeed DEFAULT_INSTRUMENT_TYPES[] = {
+    {"PICCOLO", "WOODWIND"},
+    {"CLARINET", "WOODWIND"},
+    {"SAXOPHONE", "WOODWIND"},
+    {"TRUMPET", "BRASS"},
+    {"TROMBONE", "BRASS"},
+    {"SOUSAPHONE", "BRASS"},
+    {"MELLOPHONE", "BRASS"},
+    {"PERCUSSION", "PERCUSSION"},
+    {"COLOR_GUARD", "AUXILIARY"},
+};
+
+bool Database::loadInstrumentTypes() {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "SELECT TYPE_ID, TYPE_NAME, SECTION FROM INSTRUMENT_TYPES;", -1, &stmt, nullptr) != SQLITE_OK)
+        return failSQL();
+    types.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        types.push_back({sqlite3_column_int(stmt, 0), colText(stmt, 1), colText(stmt, 2), 0});
+    sqlite3_finalize(stmt);
+
+    sort(types.begin(), types.end(), [](const InstrumentType& a, const InstrumentType& b) {
+        return a.section != b.section ? a.section < b.section : a.name < b.name;
+    });
+
+    typeById.clear();
+    typeByName.clear();
+    for (size_t i = 0; i < types.size(); i++) {
+        types[i].rank = (int)i;
+        typeById[types[i].id] = i;
+        typeByName[upperCopy(types[i].name)] = i;
+    }
+    return true;
+}
+
+// Loads the catalog and inserts only the compiled-in defaults that are missing,
+// so a normal launch is a single read.
+bool Database::seedInstrumentTypes() {
+    if (!loadInstrumentTypes()) return false;
+
+    sqlite3_stmt* stmt = nullptr;
+    bool inserted = false;
+    for (const InstrumentTypeSeed& t : DEFAULT_INSTRUMENT_TYPES) {
+        if (typeByName.count(t.name)) continue;
+        if (!stmt && sqlite3_prepare_v2(conn, "INSERT OR IGNORE INTO INSTRUMENT_TYPES (TYPE_NAME, SECTION) VALUES (?, ?);",
+                                        -1, &stmt, nullptr) != SQLITE_OK)
+            return failSQL();
+        sqlite3_bind_text(stmt, 1, t.name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, t.section, -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        inserted = true;
+    }
+    sqlite3_finalize(stmt);
+    return inserted ? loadInstrumentTypes() : true;
+}
+
+// A miss reloads once, in case another connection added a type since open.
+const InstrumentType* Database::findInstrumentType(int typeId) {
+    auto it = typeById.find(typeId);
+    if (it == typeById.end()) {
+        loadInstrumentTypes();
+        it = typeById.find(typeId);
+        if (it == typeById.end()) return nullptr;
+    }
+    return &types[it->second];
+}
+
+const InstrumentType* Database::findInstrumentType(const string& name) const {
+    auto it = typeByName.find(upperCopy(name));
+    return it == typeByName.end() ? nullptr : &types[it->second];
+}
+
+// ---------- Schema ----------
+bool Database::columnExists(const string& table, const string& col) {
+    string sql = "PRAGMA table_info(" + table + ");";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+
+    bool found = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        string name = colText(stmt, 1);
+        if (upperCopy(name) == upperCopy(col)) {
+            found = true;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Tables whose writes land in CHANGE_LOG, and the key logged for each.
+struct LoggedTable {
+    const char* table;
+    const char* key;
+};
+
+static const LoggedTable LOGGED_TABLES[] = {
+    {"STUDENTS", "STUDENT_ID"},
+    {"COMPLIANCE", "STUDENT_ID"},
+    {"INSTRUMENTS", "INSTRUMENT_ID"},
+    {"UNIFORMS", "UNIFORM_ID"},
+    {"SHAKOS", "SHAKO_ID"},
+};
+
+static const int CHANGE_LOG_KEEP = 100000;
+static const int CHANGE_LOG_TRIM_EVERY = 1000;
+
+static const char* dateColumnType(DateEncoding dates) {
+    return dates == DateEncoding::Days ? "INTEGER" : "TEXT";
+}
+
+static string complianceTableSql(const char* name, ComplianceLayout layout, DateEncoding dates) {
+    return string("CREATE TABLE IF NOT EXISTS ") + name + " ("
+        "  STUDENT_ID INTEGER PRIMARY KEY,"
+        "  CREDIT_HOURS INTEGER NOT NULL DEFAULT 0 CHECK (CREDIT_HOURS >= 0),"
+        "  GPA REAL NOT NULL DEFAULT 0.0,"
+        "  DUES_PAID INTEGER NOT NULL DEFAULT 0 CHECK (DUES_PAID IN (0,1)),"
+        "  LAST_VERIFIED_DATE " + dateColumnType(dates) + ","
+        "  FOREIGN KEY (STUDENT_ID) REFERENCES STUDENTS(STUDENT_ID) ON DELETE CASCADE"
+        ")" + (layout == ComplianceLayout::WithoutRowid ? " WITHOUT ROWID" : "") + ";";
+}
+
+static string uniformsTableSql(const char* name, DateEncoding dates) {
+    return string("CREATE TABLE IF NOT EXISTS ") + name + " ("
+        "  UNIFORM_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  COAT_SIZE TEXT,"
+        "  PANT_SIZE TEXT,"
+        "  COAT_NUMBER TEXT,"
+        "  PANT_NUMBER TEXT,"
+        "  CONDITION_NOTES TEXT,"
+        "  CHECKED_OUT_TO INTEGER UNIQUE,"
+        "  CHECKED_OUT_DATE " + dateColumnType(dates) + ","
+        "  FOREIGN KEY (CHECKED_OUT_TO) REFERENCES STUDENTS(STUDENT_ID)"
+        ");";
+}
+
+static string instrumentsTableSql(const char* name, DateEncoding dates) {
+    return string("CREATE TABLE IF NOT EXISTS ") + name + " ("
+        "  INSTRUMENT_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  TYPE_ID INTEGER NOT NULL,"
+        "  SERIAL TEXT UNIQUE,"
+        "  CONDITION_NOTES TEXT,"
+        "  CHECKED_OUT_TO INTEGER UNIQUE,"
+        "  CHECKED_OUT_DATE " + dateColumnType(dates) + ","
+        "  FOREIGN KEY (TYPE_ID) REFERENCES INSTRUMENT_TYPES(TYPE_ID),"
+        "  FOREIGN KEY (CHECKED_OUT_TO) REFERENCES STUDENTS(STUDENT_ID)"
+        ");";
+}
+
+static string shakosTableSql(const char* name, DateEncoding dates) {
+    return string("CREATE TABLE IF NOT EXISTS ") + name + " ("
+        "  SHAKO_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  SIZE TEXT,"
+        "  CONDITION_NOTES TEXT,"
+        "  CHECKED_OUT_TO INTEGER UNIQUE,"
+        "  CHECKED_OUT_DATE " + dateColumnType(dates) + ","
+        "  FOREIGN KEY (CHECKED_OUT_TO) REFERENCES STUDENTS(STUDENT_ID)"
+        ");";
+}
+
+// The dated tables, their columns and the one date column, in the order the
+// *_TEXT views list them.
+struct DatedTable {
+    const char* table;
+    const char* columns;        // everything but the date
+    const char* dateColumn;
+};
+
+static const DatedTable DATED_TABLES[] = {
+    {"INSTRUMENTS", "INSTRUMENT_ID, TYPE_ID, SERIAL, CONDITION_NOTES, CHECKED_OUT_TO", "CHECKED_OUT_DATE"},
+    {"UNIFORMS", "UNIFORM_ID, COAT_SIZE, PANT_SIZE, COAT_NUMBER, PANT_NUMBER, CONDITION_NOTES, CHECKED_OUT_TO",
+     "CHECKED_OUT_DATE"},
+    {"SHAKOS", "SHAKO_ID, SIZE, CONDITION_NOTES, CHECKED_OUT_TO", "CHECKED_OUT_DATE"},
+    {"COMPLIANCE", "STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID", "LAST_VERIFIED_DATE"},
+};
+
+// `column` converted to `to`. date() reads both text dates and day numbers;
+// values it can't read are kept as they are.
+static string convertDateSql(const string& column, DateEncoding to) {
+    if (to == DateEncoding::Days)
+        return "COALESCE(CAST(julianday(date(" + column + ")) + 0.5 AS INTEGER), " + column + ")";
+    return "COALESCE(date(" + column + "), " + column + ")";
+}
+
+// End of the SQL token at `i`: a quoted name, a word, or one character.
+static size_t sqlTokenEnd(const string& sql, size_t i) {
+    char q = sql[i] == '[' ? ']' : sql[i];
+    if (q == '"' || q == '`' || q == '\'' || q == ']') {
+        size_t close = sql.find(q, i + 1);
+        return close == string::npos ? sql.size() : close + 1;
+    }
+    size_t j = i;
+    while (j < sql.size() && (isalnum((unsigned char)sql[j]) || sql[j] == '_' || sql[j] == '$')) j++;
+    return j > i ? j : i + 1;
+}
+
+static string unquotedUpper(const string& token) {
+    bool quoted = token.size() >= 2 && strchr("\"`'[", token[0]);
+    return upperCopy(quoted ? token.substr(1, token.size() - 2) : token);
+}
+
+// The table's CREATE TABLE text as sqlite_master holds it; "" when missing.
+static string storedTableSql(sqlite3* conn, const char* table) {
+    string sql;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "SELECT sql FROM sqlite_master WHERE type='table' AND name=?;", -1, &stmt,
+                           nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) sql = colText(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return sql;
+}
+
+// The stored definition renamed to `name` and with `column` declared as
+// `type`. Everything else - the GUI's ON DELETE actions, CHECKs, WITHOUT
+// ROWID - comes across as the database has it. False when the table or the
+// column can't be found in the text.
+static bool retypedTableSql(sqlite3* conn, const char* table, const string& name, const char* column,
+                            const char* type, string& out) {
+    static const char* const constraintWords[] = {"CONSTRAINT", "PRIMARY", "NOT", "NULL", "UNIQUE", "CHECK",
+                                                  "DEFAULT", "COLLATE", "REFERENCES", "GENERATED", "AS"};
+    string sql = storedTableSql(conn, table);
+    size_t open = sql.find('(');
+    if (open == string::npos) return false;
+
+    // Column definitions start after the opening parenthesis and after each
+    // top-level comma; the type is the words up to the first constraint.
+    int depth = 1;
+    bool atDefinition = true;
+    for (size_t i = open + 1; i < sql.size() && depth > 0;) {
+        if (isspace((unsigned char)sql[i])) {
+            i++;
+            continue;
+        }
+        size_t tokenEnd = sqlTokenEnd(sql, i);
+        string token = sql.substr(i, tokenEnd - i);
+        if (atDefinition && unquotedUpper(token) == column) {
+            size_t typeEnd = tokenEnd;
+            for (size_t p = tokenEnd;;) {
+                while (p < sql.size() && isspace((unsigned char)sql[p])) p++;
+                if (p >= sql.size()) break;
+                if (sql[p] == '(' && typeEnd > tokenEnd) {
+                    size_t close = sql.find(')', p);
+                    if (close == string::npos) return false;
+                    p = typeEnd = close + 1;
+                    continue;
+                }
+                if (!isalpha((unsigned char)sql[p])) break;
+                size_t wordEnd = sqlTokenEnd(sql, p);
+                string word = upperCopy(sql.substr(p, wordEnd - p));
+                if (find(begin(constraintWords), end(constraintWords), word) != end(constraintWords)) break;
+                p = typeEnd = wordEnd;
+            }
+            bool spaceAfter = typeEnd < sql.size() && !strchr(" \t\r\n,)", sql[typeEnd]);
+            out = "CREATE TABLE " + name + " " + sql.substr(open, tokenEnd - open) + " " + type +
+                  (spaceAfter ? " " : "") + sql.substr(typeEnd);
+            return true;
+        }
+        atDefinition = false;
+        if (token == "(") depth++;
+        else if (token == ")") depth--;
+        else if (token == "," && depth == 1) atDefinition = true;
+        i = tokenEnd;
+    }
+    return false;
+}
+
+// The stored definition renamed to `name`, with WITHOUT ROWID added to or
+// taken from the table options after the column list and the rest as it is.
+// False when the table can't be found or its column list doesn't close.
+static bool relaidTableSql(sqlite3* conn, const char* table, const string& name, ComplianceLayout layout,
+                           string& out) {
+    string sql = storedTableSql(conn, table);
+    size_t open = sql.find('(');
+    if (open == string::npos) return false;
+    int depth = 0;
+    size_t close = string::npos;
+    for (size_t i = open; i < sql.size() && close == string::npos;) {
+        size_t tokenEnd = sqlTokenEnd(sql, i);
+        if (sql[i] == '(') depth++;
+        else if (sql[i] == ')' && --depth == 0) close = i;
+        i = tokenEnd;
+    }
+    if (close == string::npos) return false;
+
+    vector<string> options;
+    for (size_t from = close + 1; from <= sql.size();) {
+        size_t comma = min(sql.find(',', from), sql.size());
+        string option(trimView(string_view(sql).substr(from, comma - from)));
+        string words;
+        for (size_t i = 0; i < option.size(); i = sqlTokenEnd(option, i)) {
+            if (isspace((unsigned char)option[i])) continue;
+            if (!words.empty()) words += ' ';
+            words += upperCopy(option.substr(i, sqlTokenEnd(option, i) - i));
+        }
+        if (!option.empty() && words != "WITHOUT ROWID") options.push_back(option);
+        from = comma + 1;
+    }
+    if (layout == ComplianceLayout::WithoutRowid) options.insert(options.begin(), "WITHOUT ROWID");
+
+    out = "CREATE TABLE " + name + " " + sql.substr(open, close + 1 - open);
+    for (size_t i = 0; i < options.size(); i++) out += (i ? ", " : " ") + options[i];
+    return true;
+}
+
+// Copies `table` into the table `create` makes (table + "_NEW", with no
+// triggers yet, so the eligibility events and the change log see nothing),
+// drops the old one and renames the copy over it. The old table's indexes
+// and triggers are then run again from sqlite_master. Dropping a table drops
+// its sqlite_sequence row and the copy starts from its highest surviving ID,
+// so the old counter is put back and deleted IDs are not handed out again.
+static bool rebuildTable(Database& db, const char* table, const string& create, const string& columns,
+                         const string& values) {
+    sqlite3* conn = db.handle();
+    string fresh = string(table) + "_NEW";
+    sqlite3_int64 seq = -1;
+    vector<string> dependents;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "SELECT seq FROM sqlite_sequence WHERE name=?;", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW) seq = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "SELECT sql FROM sqlite_master WHERE tbl_name=? AND type IN ('index','trigger') "
+                                 "AND sql IS NOT NULL ORDER BY type;", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        while (sqlite3_step(stmt) == SQLITE_ROW) dependents.push_back(colText(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+
+    bool ok = db.exec("DROP TABLE IF EXISTS " + fresh + ";") &&
+              db.exec(create) &&
+              db.exec("INSERT INTO " + fresh + " (" + columns + ") SELECT " + values + " FROM " + table + ";") &&
+              db.exec(string("DROP TABLE ") + table + ";") &&
+              db.exec("ALTER TABLE " + fresh + " RENAME TO " + table + ";");
+    for (size_t i = 0; ok && i < dependents.size(); i++) ok = db.exec(dependents[i]);
+    if (ok && seq >= 0) {
+        ok = db.exec(string("DELETE FROM sqlite_sequence WHERE name='") + table + "';") &&
+             db.exec(string("INSERT INTO sqlite_sequence (name, seq) VALUES ('") + table + "', " +
+                     to_string(seq) + ");");
+    }
+    return ok;
+}
+
+static bool dropDateViews(Database& db) {
+    for (const DatedTable& t : DATED_TABLES) {
+        if (!db.exec(string("DROP VIEW IF EXISTS ") + t.table + "_TEXT;")) return false;
+    }
+    return true;
+}
+
+static DateEncoding storedDateEncoding(sqlite3* conn) {
+    sqlite3_stmt* stmt = nullptr;
+    DateEncoding out = DateEncoding::Text;
+    if (sqlite3_prepare_v2(conn, "SELECT upper(type) FROM pragma_table_info('INSTRUMENTS') "
+                                 "WHERE name='CHECKED_OUT_DATE';", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW && string(colText(stmt, 0)) == "INTEGER")
+        out = DateEncoding::Days;
+    sqlite3_finalize(stmt);
+    return out;
+}
+
+void Database::ensureTables() {
+    exec("PRAGMA foreign_keys = ON;");
+
+    exec(
+        "CREATE TABLE IF NOT EXISTS STUDENTS ("
+        "  STUDENT_ID INTEGER PRIMARY KEY,"
+        "  FNAME TEXT NOT NULL,"
+        "  LNAME TEXT NOT NULL,"
+        "  CLASSIFICATION TEXT,"
+        "  SECTION TEXT NOT NULL "
+        "    CHECK (SECTION IN ('WOODWIND','BRASS','PERCUSSION','AUXILIARY','DM')),"
+        "  SHIRT_SIZE TEXT,"
+        "  SHOE_SIZE TEXT"
+        ");"
+    );
+
+    // COMPLIANCE table
+    exec(complianceTableSql("COMPLIANCE", ComplianceLayout::Rowid, DateEncoding::Text));
+
+
+    if (!columnExists("STUDENTS", "SHIRT_SIZE"))
+        exec("ALTER TABLE STUDENTS ADD COLUMN SHIRT_SIZE TEXT;");
+    if (!columnExists("STUDENTS", "SHOE_SIZE"))
+        exec("ALTER TABLE STUDENTS ADD COLUMN SHOE_SIZE TEXT;");
+    // The GUI shares band.db and keeps these two; adding them here lets both
+    // front-ends read the same student rows.
+    if (!columnExists("STUDENTS", "PRIMARY_ROLE"))
+        exec("ALTER TABLE STUDENTS ADD COLUMN PRIMARY_ROLE TEXT;");
+    if (!columnExists("STUDENTS", "ACTIVE"))
+        exec("ALTER TABLE STUDENTS ADD COLUMN ACTIVE INTEGER NOT NULL DEFAULT 1;");
+
+    if (!columnExists("UNIFORMS", "COAT_SIZE")) {
+        exec("DROP TABLE IF EXISTS UNIFORMS_OLD;");
+        exec("ALTER TABLE UNIFORMS RENAME TO UNIFORMS_OLD;");
+
+        exec(uniformsTableSql("UNIFORMS", DateEncoding::Text));
+
+        exec("INSERT INTO UNIFORMS (UNIFORM_ID, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE) "
+             "SELECT UNIFORM_ID, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE "
+             "FROM UNIFORMS_OLD;");
+    }
+
+    exec(
+        "CREATE TABLE IF NOT EXISTS INSTRUMENT_TYPES ("
+        "  TYPE_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  TYPE_NAME TEXT UNIQUE NOT NULL,"
+        "  SECTION TEXT NOT NULL CHECK (SECTION IN ('WOODWIND','BRASS','PERCUSSION','AUXILIARY','DM'))"
+        ");"
+    );
+
+    exec(instrumentsTableSql("INSTRUMENTS", DateEncoding::Text));
+    exec(shakosTableSql("SHAKOS", DateEncoding::Text));
+
+    exec(
+        "CREATE TABLE IF NOT EXISTS SECTION_LEADERS ("
+        "  SECTION TEXT PRIMARY KEY CHECK (SECTION IN ('WOODWIND','BRASS','PERCUSSION','AUXILIARY','DM')),"
+        "  LEADER_STUDENT_ID INTEGER NOT NULL,"
+        "  FOREIGN KEY (LEADER_STUDENT_ID) REFERENCES STUDENTS(STUDENT_ID)"
+        ");"
+    );
+
+    exec("CREATE INDEX IF NOT EXISTS IDX_STUDENTS_SECTION ON STUDENTS(SECTION);");
+
+    // New databases start with text dates, which the GUI reads and writes.
+    dates = storedDateEncoding(conn);
+    for (const DatedTable& t : DATED_TABLES) {
+        string date = dates == DateEncoding::Days ? string("date(") + t.dateColumn + ")" : string(t.dateColumn);
+        exec(string("CREATE VIEW IF NOT EXISTS ") + t.table + "_TEXT AS SELECT " + t.columns + ", " +
+             date + " AS " + t.dateColumn + " FROM " + t.table + ";");
+    }
+
+    seedInstrumentTypes();
+
+    // Eligibility change feed. Triggers compare the old and new COMPLIANCE row of
+    // the one student being written, so consumers only see actual transitions.
+    exec(
+        "CREATE TABLE IF NOT EXISTS ELIGIBILITY_EVENTS ("
+        "  EVENT_ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  STUDENT_ID INTEGER NOT NULL,"
+        "  WAS_ELIGIBLE INTEGER NOT NULL CHECK (WAS_ELIGIBLE IN (0,1)),"
+        "  IS_ELIGIBLE INTEGER NOT NULL CHECK (IS_ELIGIBLE IN (0,1)),"
+        "  CHANGED_AT TEXT NOT NULL DEFAULT (datetime('now'))"
+        ");"
+    );
+
+    exec(
+        "CREATE TRIGGER IF NOT EXISTS COMPLIANCE_ELIG_INSERT AFTER INSERT ON COMPLIANCE "
+        "WHEN (NEW.CREDIT_HOURS >= 12 AND NEW.GPA >= 3.0 AND NEW.DUES_PAID = 1) "
+        "BEGIN "
+        "  INSERT INTO ELIGIBILITY_EVENTS (STUDENT_ID, WAS_ELIGIBLE, IS_ELIGIBLE) "
+        "  VALUES (NEW.STUDENT_ID, 0, 1); "
+        "END;"
+    );
+
+    exec(
+        "CREATE TRIGGER IF NOT EXISTS COMPLIANCE_ELIG_UPDATE "
+        "AFTER UPDATE OF CREDIT_HOURS, GPA, DUES_PAID ON COMPLIANCE "
+        "WHEN (OLD.CREDIT_HOURS >= 12 AND OLD.GPA >= 3.0 AND OLD.DUES_PAID = 1) "
+        "  <> (NEW.CREDIT_HOURS >= 12 AND NEW.GPA >= 3.0 AND NEW.DUES_PAID = 1) "
+        "BEGIN "
+        "  INSERT INTO ELIGIBILITY_EVENTS (STUDENT_ID, WAS_ELIGIBLE, IS_ELIGIBLE) "
+        "  VALUES (NEW.STUDENT_ID, "
+        "          (OLD.CREDIT_HOURS >= 12 AND OLD.GPA >= 3.0 AND OLD.DUES_PAID = 1), "
+        "          (NEW.CREDIT_HOURS >= 12 AND NEW.GPA >= 3.0 AND NEW.DUES_PAID = 1)); "
+        "END;"
+    );
+
+    exec(
+        "CREATE TRIGGER IF NOT EXISTS COMPLIANCE_ELIG_DELETE AFTER DELETE ON COMPLIANCE "
+        "WHEN (OLD.CREDIT_HOURS >= 12 AND OLD.GPA >= 3.0 AND OLD.DUES_PAID = 1) "
+        "BEGIN "
+        "  INSERT INTO ELIGIBILITY_EVENTS (STUDENT_ID, WAS_ELIGIBLE, IS_ELIGIBLE) "
+        "  VALUES (OLD.STUDENT_ID, 1, 0); "
+        "END;"
+    );
+
+    // Row change log for incremental refresh (see ChangeFeed). Triggers
+    // append; every CHANGE_LOG_TRIM_EVERY entries, from whichever connection,
+    // the log is cut back to the newest CHANGE_LOG_KEEP, and a reader older
+    // than that reloads. Versions only mean something within one database
+    // file, so the file gets a random epoch the first time the log is made.
+    exec(
+        "CREATE TABLE IF NOT EXISTS CHANGE_LOG ("
+        "  VERSION INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "  TBL TEXT NOT NULL,"
+        "  ROW_ID INTEGER NOT NULL"
+        ");"
+    );
+    exec("CREATE TABLE IF NOT EXISTS CHANGE_EPOCH (EPOCH INTEGER NOT NULL);");
+    exec("INSERT INTO CHANGE_EPOCH (EPOCH) SELECT (random() & 9007199254740991) + 1 "
+         "WHERE NOT EXISTS (SELECT 1 FROM CHANGE_EPOCH);");
+    exec("CREATE TRIGGER IF NOT EXISTS CHANGE_LOG_TRIM AFTER INSERT ON CHANGE_LOG "
+         "WHEN NEW.VERSION % " + to_string(CHANGE_LOG_TRIM_EVERY) + " = 0 BEGIN "
+         "  DELETE FROM CHANGE_LOG WHERE VERSION <= NEW.VERSION - " + to_string(CHANGE_LOG_KEEP) + "; "
+         "END;");
+
+    for (const LoggedTable& t : LOGGED_TABLES) {
+        static const struct { const char* name; const char* row; } OPS[] = {
+            {"INSERT", "NEW"}, {"UPDATE", "NEW"}, {"DELETE", "OLD"},
+        };
+        for (const auto& op : OPS) {
+            exec(string("CREATE TRIGGER IF NOT EXISTS ") + t.table + "_LOG_" + op.name +
+                 " AFTER " + op.name + " ON " + t.table + " BEGIN "
+                 "  INSERT INTO CHANGE_LOG (TBL, ROW_ID) VALUES ('" + t.table + "', " + op.row + "." + t.key + "); "
+                 "END;");
+        }
+    }
+
+    exec("DELETE FROM CHANGE_LOG WHERE VERSION <= "
+         "(SELECT seq FROM sqlite_sequence WHERE name='CHANGE_LOG') - " + to_string(CHANGE_LOG_KEEP) + ";");
+}
+
+bool Database::complianceLayout(ComplianceLayout& out) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, "SELECT wr FROM pragma_table_list WHERE schema='main' AND name='COMPLIANCE';",
+                           -1, &stmt, nullptr) != SQLITE_OK)
+        return failSQL();
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    out = found && sqlite3_column_int(stmt, 0) ? ComplianceLayout::WithoutRowid : ComplianceLayout::Rowid;
+    sqlite3_finalize(stmt);
+    return found || fail("No COMPLIANCE table");
+}
+
+// Rebuilt from its own definition in sqlite_master, as migrateDates does,
+// so a GUI-made COMPLIANCE keeps its constraints and indexes; only the
+// WITHOUT ROWID option changes.
+bool Database::migrateCompliance(ComplianceLayout layout) {
+    ComplianceLayout current;
+    if (!complianceLayout(current)) return false;
+    if (current == layout) return true;
+
+    flushCommitBatch();
+    if (!beginWrite()) return false;
+    string create;
+    bool ok = dropDateViews(*this);
+    if (ok && !relaidTableSql(conn, "COMPLIANCE", "COMPLIANCE_NEW", layout, create))
+        ok = fail("Can't read the definition of COMPLIANCE; it was left as it is");
+    const char* columns = "STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE";
+    ok = ok && rebuildTable(*this, "COMPLIANCE", create, columns, columns);
+    if (ok) ensureTables();
+    if (!ok || !commitWrite()) {
+        rollbackWrite();
+        return false;
+    }
+    return true;
+}
+
+const char* Database::today() const {
+    return dates == DateEncoding::Days ? "CAST(julianday('now', 'start of day') + 0.5 AS INTEGER)" : "date('now')";
+}
+
+// Each table is rebuilt from its own definition in sqlite_master rather than
+// the console's, since the GUI creates these tables too, with its own
+// foreign-key actions, and those have to survive.
+bool Database::migrateDates(DateEncoding encoding) {
+    if (encoding == dates) return true;
+
+    flushCommitBatch();
+    if (!beginWrite()) return false;
+    bool ok = dropDateViews(*this);
+    for (const DatedTable& t : DATED_TABLES) {
+        if (!ok) break;
+        string create;
+        if (!retypedTableSql(conn, t.table, string(t.table) + "_NEW", t.dateColumn, dateColumnType(encoding),
+                             create)) {
+            ok = fail(string("Can't read the definition of ") + t.table + "." + t.dateColumn +
+                      "; the dates were left as they are");
+            break;
+        }
+        ok = rebuildTable(*this, t.table, create, string(t.columns) + ", " + t.dateColumn,
+                          string(t.columns) + ", " + convertDateSql(t.dateColumn, encoding));
+    }
+    if (ok) ensureTables();
+    if (!ok || !commitWrite()) {
+        rollbackWrite();
+        dates = storedDateEncoding(conn);
+        return false;
+    }
+    return true;
+}
+
+// ---------- Undo journal ----------
+// Row images are packed values: a tag byte, then 8 bytes for integers and
+// reals, or a 4-byte length and the bytes for text. The first value is the
+// row's key. An entry is a run of operations:
+//   [table][flags: 1 before, 2 after][u32 size, before image][u32 size, after image]
+// with an image present only when its flag is set.
+struct UndoTableInfo {
+    const char* name;
+    const char* key;
+    const char* columns;    // key first
+};
+
+static const UndoTableInfo UNDO_TABLES[] = {
+    {"STUDENTS", "STUDENT_ID",
+     "STUDENT_ID, FNAME, LNAME, CLASSIFICATION, SECTION, SHIRT_SIZE, SHOE_SIZE, PRIMARY_ROLE, ACTIVE"},
+    {"COMPLIANCE", "STUDENT_ID", "STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE"},
+    {"INSTRUMENTS", "INSTRUMENT_ID",
+     "INSTRUMENT_ID, TYPE_ID, SERIAL, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE"},
+    {"UNIFORMS", "UNIFORM_ID",
+     "UNIFORM_ID, COAT_SIZE, PANT_SIZE, COAT_NUMBER, PANT_NUMBER, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE"},
+    {"SHAKOS", "SHAKO_ID", "SHAKO_ID, SIZE, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE"},
+    {"SECTION_LEADERS", "SECTION", "SECTION, LEADER_STUDENT_ID"},
+};
+
+enum : uint8_t { PACK_NULL, PACK_INT, PACK_REAL, PACK_TEXT };
+enum : uint8_t { OP_BEFORE = 1, OP_AFTER = 2 };
+
+static void packU32(string& out, uint32_t v) {
+    out.append((const char*)&v, sizeof v);
+}
+
+static uint32_t readU32(const string& data, size_t pos) {
+    uint32_t v;
+    memcpy(&v, data.data() + pos, sizeof v);
+    return v;
+}
+
+static string packedInt(sqlite3_int64 v) {
+    string out(1, (char)PACK_INT);
+    out.append((const char*)&v, sizeof v);
+    return out;
+}
+
+static string packedText(const string& s) {
+    string out(1, (char)PACK_TEXT);
+    packU32(out, (uint32_t)s.size());
+    return out + s;
+}
+
+static void packColumn(string& out, sqlite3_stmt* stmt, int col) {
+    switch (sqlite3_column_type(stmt, col)) {
+    case SQLITE_NULL:
+        out += (char)PACK_NULL;
+        break;
+    case SQLITE_INTEGER:
+        out += packedInt(sqlite3_column_int64(stmt, col));
+        break;
+    case SQLITE_FLOAT: {
+        double d = sqlite3_column_double(stmt, col);
+        out += (char)PACK_REAL;
+        out.append((const char*)&d, sizeof d);
+        break;
+    }
+    default:
+        out += packedText(string((const char*)sqlite3_column_text(stmt, col), sqlite3_column_bytes(stmt, col)));
+    }
+}
+
+// Size of the packed value at `pos`; 0 when the data is damaged.
+static size_t packedSize(const string& data, size_t pos) {
+    if (pos >= data.size()) return 0;
+    size_t n;
+    switch ((uint8_t)data[pos]) {
+    case PACK_NULL: n = 1; break;
+    case PACK_INT:
+    case PACK_REAL: n = 9; break;
+    case PACK_TEXT:
+        if (pos + 5 > data.size()) return 0;
+        n = 5 + readU32(data, pos + 1);
+        break;
+    default: return 0;
+    }
+    return pos + n <= data.size() ? n : 0;
+}
+
+static void bindPacked(sqlite3_stmt* stmt, int idx, const string& data, size_t pos) {
+    switch ((uint8_t)data[pos]) {
+    case PACK_INT: {
+        sqlite3_int64 v;
+        memcpy(&v, data.data() + pos + 1, sizeof v);
+        sqlite3_bind_int64(stmt, idx, v);
+        break;
+    }
+    case PACK_REAL: {
+        double d;
+        memcpy(&d, data.data() + pos + 1, sizeof d);
+        sqlite3_bind_double(stmt, idx, d);
+        break;
+    }
+    case PACK_TEXT:
+        sqlite3_bind_text(stmt, idx, data.data() + pos + 5, (int)readU32(data, pos + 1), SQLITE_TRANSIENT);
+        break;
+    default:
+        sqlite3_bind_null(stmt, idx);
+    }
+}
+
+static string packedKeyText(const string& key) {
+    if (key.empty()) return "?";
+    if ((uint8_t)key[0] == PACK_TEXT) return key.substr(5);
+    sqlite3_int64 v = 0;
+    if ((uint8_t)key[0] == PACK_INT) memcpy(&v, key.data() + 1, sizeof v);
+    return to_string(v);
+}
+
+static size_t entrySize(const UndoEntry& e) {
+    return e.label.size() + e.data.size();
+}
+
+struct UndoOp {
+    UndoTable table;
+    bool hasBefore = false, hasAfter = false;
+    string before, after;
+
+    string key() const {
+        const string& image = hasAfter ? after : before;
+        return image.substr(0, packedSize(image, 0));
+    }
+};
+
+static bool readImage(const string& data, size_t& pos, string& image) {
+    if (pos + 4 > data.size()) return false;
+    size_t n = readU32(data, pos);
+    if (pos + 4 + n > data.size()) return false;
+    image = data.substr(pos + 4, n);
+    pos += 4 + n;
+    return true;
+}
+
+static bool parseOps(const string& data, vector<UndoOp>& ops) {
+    ops.clear();
+    size_t pos = 0;
+    while (pos < data.size()) {
+        if (pos + 2 > data.size() || (uint8_t)data[pos] >= size(UNDO_TABLES)) return false;
+        UndoOp op;
+        op.table = (UndoTable)data[pos];
+        op.hasBefore = data[pos + 1] & OP_BEFORE;
+        op.hasAfter = data[pos + 1] & OP_AFTER;
+        pos += 2;
+        if (op.hasBefore && !readImage(data, pos, op.before)) return false;
+        if (op.hasAfter && !readImage(data, pos, op.after)) return false;
+        if ((!op.hasBefore && !op.hasAfter) || op.key().empty()) return false;
+        ops.push_back(move(op));
+    }
+    return true;
+}
+
+// Reads the row's current image; exists=false when there is no such row.
+static bool readRowImage(Database& db, UndoTable t, const string& key, bool& exists, string& image) {
+    const UndoTableInfo& info = UNDO_TABLES[(size_t)t];
+    string sql = string("SELECT ") + info.columns + " FROM " + info.name + " WHERE " + info.key + "=?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    bindPacked(stmt, 1, key, 0);
+
+    image.clear();
+    exists = sqlite3_step(stmt) == SQLITE_ROW;
+    if (exists) {
+        for (int c = 0; c < sqlite3_column_count(stmt); c++) packColumn(image, stmt, c);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// Puts the row back to `image`, or deletes it when there is none. An upsert
+// rather than INSERT OR REPLACE, which would delete the old row first and
+// cascade to its COMPLIANCE row.
+static bool writeRowImage(Database& db, UndoTable t, const string& key, bool exists, const string& image) {
+    const UndoTableInfo& info = UNDO_TABLES[(size_t)t];
+    string sql;
+    if (!exists) {
+        sql = string("DELETE FROM ") + info.name + " WHERE " + info.key + "=?;";
+    } else {
+        string params, updates;
+        size_t start = 0;
+        string cols = info.columns;
+        bool first = true;
+        while (start < cols.size()) {
+            size_t comma = cols.find(',', start);
+            string col = trim(cols.substr(start, comma == string::npos ? string::npos : comma - start));
+            params += first ? "?" : ", ?";
+            if (!first) updates += string(updates.empty() ? "" : ", ") + col + "=excluded." + col;
+            first = false;
+            if (comma == string::npos) break;
+            start = comma + 1;
+        }
+        sql = string("INSERT INTO ") + info.name + " (" + info.columns + ") VALUES (" + params + ") " +
+              "ON CONFLICT(" + info.key + ") DO UPDATE SET " + updates + ";";
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    if (!exists) {
+        bindPacked(stmt, 1, key, 0);
+    } else {
+        int idx = 1;
+        for (size_t pos = 0; pos < image.size(); idx++) {
+            bindPacked(stmt, idx, image, pos);
+            pos += packedSize(image, pos);
+        }
+    }
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!ok) db.failSQL(string("Could not restore ") + info.name + " row " + packedKeyText(key));
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+static bool undoLogExec(Database& db, const char* sql, sqlite3_int64 seq, int flag = -1) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    int idx = 1;
+    if (flag >= 0) sqlite3_bind_int(stmt, idx++, flag);
+    sqlite3_bind_int64(stmt, idx, seq);
+    bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!ok) db.failSQL("Undo log write failed");
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+void UndoJournal::setLimits(size_t entries, size_t bytes) {
+    vector<UndoEntry> kept;
+    for (size_t i = 0; i < count; i++) kept.push_back(move(ring[(head + i) % ring.size()]));
+    maxEntries = max<size_t>(1, entries);
+    maxBytes = bytes;
+    ring.clear();
+    head = count = ringBytes = 0;
+    for (UndoEntry& e : kept) push(move(e));
+}
+
+bool UndoJournal::setPersistent(bool on) {
+    persist = on;
+    return !on || load();
+}
+
+const UndoEntry* UndoJournal::peekUndo() const {
+    return count ? &ring[(head + count - 1) % ring.size()] : nullptr;
+}
+
+void UndoJournal::reset() {
+    ring.clear();
+    head = count = ringBytes = 0;
+    redoStack.clear();
+    depth = 0;
+    pending.clear();
+}
+
+bool UndoJournal::load() {
+    reset();
+    if (!persist || !db.handle()) return true;
+    if (!db.exec(
+            "CREATE TABLE IF NOT EXISTS UNDO_LOG ("
+            "  SEQ INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "  LABEL TEXT NOT NULL,"
+            "  REDO INTEGER NOT NULL DEFAULT 0 CHECK (REDO IN (0,1)),"
+            "  DATA BLOB NOT NULL"
+            ");"))
+        return false;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), "SELECT SEQ, LABEL, REDO, DATA FROM UNDO_LOG ORDER BY SEQ;",
+                           -1, &stmt, nullptr) != SQLITE_OK)
+        return db.failSQL();
+    vector<UndoEntry> undone, redone;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        UndoEntry e;
+        e.seq = sqlite3_column_int64(stmt, 0);
+        e.label = colText(stmt, 1);
+        e.data.assign((const char*)sqlite3_column_blob(stmt, 3), sqlite3_column_bytes(stmt, 3));
+        (sqlite3_column_int(stmt, 2) ? redone : undone).push_back(move(e));
+    }
+    sqlite3_finalize(stmt);
+
+    for (UndoEntry& e : undone) push(move(e));
+    // The most recently undone entry has the lowest SEQ of the redo rows.
+    redoStack.assign(make_move_iterator(redone.rbegin()), make_move_iterator(redone.rend()));
+    return true;
+}
+
+// Appends to the ring, dropping the oldest entries past either limit.
+bool UndoJournal::push(UndoEntry e) {
+    if (ring.size() != maxEntries) ring.resize(maxEntries);
+    bool ok = true;
+    while (count && (count == maxEntries || ringBytes + entrySize(e) > maxBytes)) {
+        UndoEntry& oldest = ring[head];
+        if (persist && oldest.seq)
+            ok = undoLogExec(db, "DELETE FROM UNDO_LOG WHERE SEQ=?;", oldest.seq) && ok;
+        ringBytes -= entrySize(oldest);
+        oldest = UndoEntry();
+        head = (head + 1) % maxEntries;
+        count--;
+    }
+    ringBytes += entrySize(e);
+    ring[(head + count) % maxEntries] = move(e);
+    count++;
+    return ok;
+}
+
+bool UndoJournal::begin(const string& label) {
+    if (!db.beginWrite()) return false;
+    if (depth++ == 0) {
+        pendingLabel = label;
+        pending.clear();
+    }
+    return true;
+}
+
+bool UndoJournal::record(Pending p) {
+    for (const Pending& q : pending) {
+        if (q.table == p.table && q.key == p.key) return true;     // keep the first before image
+    }
+    pending.push_back(move(p));
+    return true;
+}
+
+bool UndoJournal::touch(UndoTable t, sqlite3_int64 key) {
+    Pending p{t, packedInt(key), false, string()};
+    return readRowImage(db, t, p.key, p.hadBefore, p.before) && record(move(p));
+}
+
+bool UndoJournal::touch(UndoTable t, const string& key) {
+    Pending p{t, packedText(key), false, string()};
+    return readRowImage(db, t, p.key, p.hadBefore, p.before) && record(move(p));
+}
+
+bool UndoJournal::inserted(UndoTable t, sqlite3_int64 key) {
+    return record({t, packedInt(key), false, string()});
+}
+
+bool UndoJournal::commit() {
+    if (depth == 0) return true;
+    if (--depth > 0) return db.commitWrite();
+
+    UndoEntry e;
+    e.label = pendingLabel;
+    for (const Pending& p : pending) {
+        bool exists;
+        string after;
+        if (!readRowImage(db, p.table, p.key, exists, after)) {
+            pending.clear();
+            db.rollbackWrite();
+            return false;
+        }
+        if (exists == p.hadBefore && after == p.before) continue;   // untouched after all
+        e.data += (char)p.table;
+        e.data += (char)((p.hadBefore ? OP_BEFORE : 0) | (exists ? OP_AFTER : 0));
+        if (p.hadBefore) {
+            packU32(e.data, (uint32_t)p.before.size());
+            e.data += p.before;
+        }
+        if (exists) {
+            packU32(e.data, (uint32_t)after.size());
+            e.data += after;
+        }
+    }
+    pending.clear();
+
+    bool recorded = !e.data.empty();
+    if (recorded && persist) {
+        sqlite3_stmt* stmt = nullptr;
+        bool ok = db.exec("DELETE FROM UNDO_LOG WHERE REDO=1;") &&
+                  sqlite3_prepare_v2(db.handle(), "INSERT INTO UNDO_LOG (LABEL, DATA) VALUES (?, ?);",
+                                     -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_text(stmt, 1, e.label.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_blob(stmt, 2, e.data.data(), (int)e.data.size(), SQLITE_STATIC);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            e.seq = sqlite3_last_insert_rowid(db.handle());
+        }
+        if (!ok) db.failSQL("Undo log write failed");
+        sqlite3_finalize(stmt);
+        if (!ok) {
+            db.rollbackWrite();
+            return false;
+        }
+    }
+    if (!db.commitWrite()) {
+        db.rollbackWrite();
+        return false;
+    }
+    if (recorded) {
+        redoStack.clear();
+        push(move(e));
+    }
+    return true;
+}
+
+void UndoJournal::abort() {
+    if (depth == 0) return;
+    if (--depth == 0) pending.clear();
+    db.rollbackWrite();
+}
+
+// Checks every row still holds the image this step expects, then writes the
+// other image; undo walks the operations backwards (COMPLIANCE before its
+// STUDENTS row), redo forwards.
+Outcome UndoJournal::apply(const UndoEntry& e, bool undoing) {
+    vector<UndoOp> ops;
+    if (!parseOps(e.data, ops)) {
+        db.fail("Undo entry '" + e.label + "' is damaged");
+        return Outcome::Failed;
+    }
+    if (!db.beginWrite()) return Outcome::Failed;
+
+    for (const UndoOp& op : ops) {
+        bool exists;
+        string current;
+        string key = op.key();
+        if (!readRowImage(db, op.table, key, exists, current)) {
+            db.rollbackWrite();
+            return Outcome::Failed;
+        }
+        bool expectExists = undoing ? op.hasAfter : op.hasBefore;
+        const string& expect = undoing ? op.after : op.before;
+        if (exists != expectExists || (exists && current != expect)) {
+            db.fail(string(undoing ? "Cannot undo" : "Cannot redo") + " '" + e.label + "': " +
+                    UNDO_TABLES[(size_t)op.table].name + " row " + packedKeyText(key) + " has changed since");
+            db.rollbackWrite();
+            return Outcome::Failed;
+        }
+    }
+
+    for (size_t i = 0; i < ops.size(); i++) {
+        const UndoOp& op = ops[undoing ? ops.size() - 1 - i : i];
+        bool ok = undoing ? writeRowImage(db, op.table, op.key(), op.hasBefore, op.before)
+                          : writeRowImage(db, op.table, op.key(), op.hasAfter, op.after);
+        if (!ok) {
+            db.rollbackWrite();
+            return Outcome::Failed;
+        }
+    }
+
+    if (persist && e.seq &&
+        !undoLogExec(db, "UPDATE UNDO_LOG SET REDO=? WHERE SEQ=?;", e.seq, undoing ? 1 : 0)) {
+        db.rollbackWrite();
+        return Outcome::Failed;
+    }
+    if (!db.commitWrite()) {
+        db.rollbackWrite();
+        return Outcome::Failed;
+    }
+    db.dropKeyFilters();
+    return Outcome::Done;
+}
+
+Outcome UndoJournal::undo(string& label) {
+    const UndoEntry* e = peekUndo();
+    if (!e) return Outcome::NotFound;
+    Outcome o = apply(*e, true);
+    if (o != Outcome::Done) return o;
+
+    UndoEntry& slot = ring[(head + count - 1) % ring.size()];
+    label = slot.label;
+    ringBytes -= entrySize(slot);
+    redoStack.push_back(move(slot));
+    slot = UndoEntry();
+    count--;
+    return Outcome::Done;
+}
+
+Outcome UndoJournal::redo(string& label) {
+    if (redoStack.empty()) return Outcome::NotFound;
+    Outcome o = apply(redoStack.back(), false);
+    if (o != Outcome::Done) return o;
+
+    UndoEntry e = move(redoStack.back());
+    redoStack.pop_back();
+    label = e.label;
+    push(move(e));
+    return Outcome::Done;
+}
+
+// One undoable repository write. The journal savepoint opens here; finish()
+// records the entry on Done and rolls the write back otherwise, including
+// when a touch() could not read its row. With record=false it is a plain
+// savepoint and touches are ignored (for writes too big to journal).
+class UndoScope {
+public:
+    UndoScope(Database& db, const string& label, bool record = true)
+        : db(db), record(record), open(record ? db.undo().begin(label) : db.beginWrite()), ok(open) {}
+    ~UndoScope() {
+        if (open) rollback();
+    }
+
+    void touch(UndoTable t, sqlite3_int64 key) { ok = ok && (!record || db.undo().touch(t, key)); }
+    void touch(UndoTable t, const string& key) { ok = ok && (!record || db.undo().touch(t, key)); }
+    void inserted(UndoTable t, sqlite3_int64 key) { ok = ok && (!record || db.undo().inserted(t, key)); }
+
+    Outcome finish(Outcome o) {
+        if (!open) return Outcome::Failed;
+        open = false;
+        if (!ok || o != Outcome::Done) {
+            rollback();
+            return ok ? o : Outcome::Failed;
+        }
+        if (record) return db.undo().commit() ? Outcome::Done : Outcome::Failed;
+        if (db.commitWrite()) return Outcome::Done;
+        db.rollbackWrite();
+        return Outcome::Failed;
+    }
+    bool finish(bool done) { return finish(done ? Outcome::Done : Outcome::Failed) == Outcome::Done; }
+
+private:
+    Database& db;
+    bool record;
+    bool open;
+    bool ok;
+
+    void rollback() {
+        if (record) db.undo().abort();
+        else db.rollbackWrite();
+    }
+};
+
+// One bulk write split into transactions by db.commitPolicy(). begin() opens
+// the first batch, wrote() after each row commits and opens the next one once
+// the batch is due, finish() commits the tail. abort() rolls back only the
+// open batch; rows in earlier batches stay committed (`committed` counts
+// them). Auto-tuning sizes the next batch from this one's timings:
+//   rows = (stallMs - commit latency) / per-row write time
+// halfway from the current size, so one noisy batch can't swing it far.
+class BatchCommitter {
+public:
+    size_t committed = 0;
+    size_t commits = 0;
+    double maxBatchMs = 0.0;
+
+    explicit BatchCommitter(Database& db) : db(db), policy(db.commitPolicy()) {}
+
+    bool begin() {
+        db.flushCommitBatch();      // otherwise every commit would only release a savepoint
+        return open();
+    }
+
+    bool wrote() {
+        pending++;
+        if (!due()) return true;
+        return commit() && open();
+    }
+
+    bool finish() {
+        bool ok = commit();
+        if (policy.autoTune) {
+            CommitPolicy p = db.commitPolicy();
+            p.rows = policy.rows;
+            db.setCommitPolicy(p);
+        }
+        return ok;
+    }
+
+    void abort() {
+        db.rollbackWrite();
+        pending = 0;
+    }
+
+    void report(ImportResult& r) const {
+        r.commits = commits;
+        r.batchRows = policy.rows;
+        r.maxBatchMs = maxBatchMs;
+    }
+
+private:
+    static const size_t MIN_ROWS = 64;
+    static const size_t MAX_ROWS = 1 << 20;
+
+    Database& db;
+    CommitPolicy policy;
+    size_t pending = 0;
+    chrono::steady_clock::time_point started;
+
+    bool open() {
+        if (!db.beginWrite()) return false;
+        started = chrono::steady_clock::now();
+        return true;
+    }
+
+    bool due() const {
+        if (policy.rows && pending >= policy.rows) return true;
+        // The clock is read every 16 rows; a row is microseconds.
+        return policy.intervalMs && pending % 16 == 0 &&
+               chrono::steady_clock::now() - started >= chrono::milliseconds(policy.intervalMs);
+    }
+
+    bool commit() {
+        auto flushing = chrono::steady_clock::now();
+        if (!db.commitWrite()) {
+            db.rollbackWrite();
+            pending = 0;
+            return false;
+        }
+        auto done = chrono::steady_clock::now();
+        double writeMs = chrono::duration<double, milli>(flushing - started).count();
+        double commitMs = chrono::duration<double, milli>(done - flushing).count();
+        maxBatchMs = max(maxBatchMs, writeMs + commitMs);
+        commits++;
+        committed += pending;
+        if (policy.autoTune && pending >= MIN_ROWS) tune(writeMs / pending, commitMs);
+        pending = 0;
+        return true;
+    }
+
+    void tune(double rowMs, double commitMs) {
+        // A commit slower than the bound can't be hidden; keep batches big
+        // enough that it doesn't dominate.
+        double budget = max(policy.stallMs - commitMs, policy.stallMs / 4.0);
+        double target = rowMs > 0 ? budget / rowMs : (double)MAX_ROWS;
+        target = min(max(target, (double)MIN_ROWS), (double)MAX_ROWS);
+        policy.rows = (policy.rows + (size_t)target) / 2;
+    }
+};
+
+// ---------- Students ----------
+static const char* STUDENT_PROFILE_COLUMNS =
+    "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, COALESCE(s.CLASSIFICATION,''), s.SECTION, "
+    "       COALESCE(s.SHIRT_SIZE,''), COALESCE(s.SHOE_SIZE,''), "
+    "       COALESCE(c.CREDIT_HOURS,0), COALESCE(c.GPA,0.0), COALESCE(c.DUES_PAID,0), "
+    "       COALESCE(c.LAST_VERIFIED_DATE,''), COALESCE(s.PRIMARY_ROLE,''), COALESCE(s.ACTIVE,1) "
+    "FROM STUDENTS s "
+    "LEFT JOIN COMPLIANCE_TEXT c ON c.STUDENT_ID=s.STUDENT_ID ";
+
+static StudentProfile readStudentProfile(sqlite3_stmt* stmt) {
+    StudentProfile p;
+    p.student.id = sqlite3_column_int(stmt, 0);
+    p.student.fname = colText(stmt, 1);
+    p.student.lname = colText(stmt, 2);
+    p.student.classification = colText(stmt, 3);
+    p.student.section = colText(stmt, 4);
+    p.student.shirtSize = colText(stmt, 5);
+    p.student.shoeSize = colText(stmt, 6);
+    p.compliance.creditHours = sqlite3_column_int(stmt, 7);
+    p.compliance.gpa = sqlite3_column_double(stmt, 8);
+    p.compliance.duesPaid = sqlite3_column_int(stmt, 9) == 1;
+    p.compliance.lastVerified = colText(stmt, 10);
+    p.student.role = colText(stmt, 11);
+    p.student.active = sqlite3_column_int(stmt, 12) != 0;
+    return p;
+}
+
+// `arg` fills the tail's one parameter, if it has one.
+static bool loadStudentProfiles(Database& db, const string& tail, vector<StudentProfile>& out,
+                                sqlite3_int64 arg = 0) {
+    string sql = string(STUDENT_PROFILE_COLUMNS) + tail;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    if (sqlite3_bind_parameter_count(stmt) > 0) sqlite3_bind_int64(stmt, 1, arg);
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) out.push_back(readStudentProfile(stmt));
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool StudentRepo::add(const Student& s) {
+    UndoScope undo(db, "Add student " + to_string(s.id));
+    undo.touch(UndoTable::Students, s.id);
+    undo.touch(UndoTable::Compliance, s.id);
+
+    const char* sql =
+        "INSERT INTO STUDENTS (STUDENT_ID, FNAME, LNAME, CLASSIFICATION, SECTION, SHIRT_SIZE, SHOE_SIZE) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?);";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+
+    sqlite3_bind_int(stmt, 1, s.id);
+    sqlite3_bind_text(stmt, 2, s.fname.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, s.lname.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, s.classification.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, s.section.c_str(), -1, SQLITE_TRANSIENT);
+    bindOptionalText(stmt, 6, s.shirtSize);
+    bindOptionalText(stmt, 7, s.shoeSize);
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL("Insert failed");
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    sqlite3_finalize(stmt);
+    db.addStudentKey(s.id);
+
+    string csql =
+        "INSERT OR IGNORE INTO COMPLIANCE "
+        "(STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
+        "VALUES (?, 0, 0.0, 0, " + string(db.today()) + ");";
+
+    sqlite3_stmt* cstmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), csql.c_str(), -1, &cstmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(cstmt, 1, s.id);
+        sqlite3_step(cstmt);
+        sqlite3_finalize(cstmt);
+    }
+    return undo.finish(true);
+}
+
+bool StudentRepo::exists(int studentId) {
+    const char* sql = "SELECT 1 FROM STUDENTS WHERE STUDENT_ID=?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    sqlite3_bind_int(stmt, 1, studentId);
+    bool ok = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+Outcome StudentRepo::section(int studentId, string& out) {
+    out = "";
+    const char* sql = "SELECT SECTION FROM STUDENTS WHERE STUDENT_ID=?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+    sqlite3_bind_int(stmt, 1, studentId);
+
+    Outcome result = Outcome::NotFound;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        out = colText(stmt, 0);
+        result = Outcome::Done;
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+Outcome StudentRepo::find(int studentId, StudentProfile& out) {
+    string sql = string(STUDENT_PROFILE_COLUMNS) + "WHERE s.STUDENT_ID=?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+    sqlite3_bind_int(stmt, 1, studentId);
+
+    Outcome result = Outcome::NotFound;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        out = readStudentProfile(stmt);
+        result = Outcome::Done;
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+bool StudentRepo::list(vector<StudentProfile>& out) {
+    return loadStudentProfiles(db, "ORDER BY s.SECTION, s.LNAME, s.FNAME;", out);
+}
+
+Outcome StudentRepo::setSectionLeader(const string& section, int studentId) {
+    if (!exists(studentId)) return Outcome::NotFound;
+
+    UndoScope undo(db, "Set " + section + " leader to " + to_string(studentId));
+    undo.touch(UndoTable::SectionLeaders, section);
+
+    const char* sql =
+        "INSERT INTO SECTION_LEADERS (SECTION, LEADER_STUDENT_ID) "
+        "VALUES (?, ?) "
+        "ON CONFLICT(SECTION) DO UPDATE SET LEADER_STUDENT_ID=excluded.LEADER_STUDENT_ID;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+
+    sqlite3_bind_text(stmt, 1, section.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, studentId);
+
+    Outcome result = Outcome::Done;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL("Set leader failed");
+        result = Outcome::Failed;
+    }
+    sqlite3_finalize(stmt);
+    return undo.finish(result);
+}
+
+// One grouped query per call: every section with its leader, walked through
+// IDX_STUDENTS_SECTION, with equipment found through the UNIQUE
+// CHECKED_OUT_TO indexes (at most one row per student, so no fan-out).
+bool StudentRepo::leaderRollup(vector<LeaderRollupRow>& out) {
+    const char* sql =
+        "WITH SECTIONS(SECTION) AS (VALUES ('WOODWIND'),('BRASS'),('PERCUSSION'),('AUXILIARY'),('DM')) "
+        "SELECT x.SECTION, l.LEADER_STUDENT_ID, COALESCE(ls.FNAME || ' ' || ls.LNAME, ''), "
+        "       (ls.SECTION IS NOT NULL AND ls.SECTION <> x.SECTION), "
+        "       COUNT(s.STUDENT_ID), "
+        "       COALESCE(SUM(COALESCE(c.CREDIT_HOURS,0) >= 12 AND COALESCE(c.GPA,0.0) >= 3.0 AND COALESCE(c.DUES_PAID,0)=1), 0), "
+        "       COALESCE(SUM(s.STUDENT_ID IS NOT NULL AND i.INSTRUMENT_ID IS NULL), 0), "
+        "       COALESCE(SUM(s.STUDENT_ID IS NOT NULL AND u.UNIFORM_ID IS NULL), 0), "
+        "       COALESCE(SUM(s.STUDENT_ID IS NOT NULL AND sh.SHAKO_ID IS NULL), 0) "
+        "FROM SECTIONS x "
+        "LEFT JOIN SECTION_LEADERS l ON l.SECTION=x.SECTION "
+        "LEFT JOIN STUDENTS ls ON ls.STUDENT_ID=l.LEADER_STUDENT_ID "
+        "LEFT JOIN STUDENTS s ON s.SECTION=x.SECTION "
+        "LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID "
+        "LEFT JOIN INSTRUMENTS i ON i.CHECKED_OUT_TO=s.STUDENT_ID "
+        "LEFT JOIN UNIFORMS u ON u.CHECKED_OUT_TO=s.STUDENT_ID "
+        "LEFT JOIN SHAKOS sh ON sh.CHECKED_OUT_TO=s.STUDENT_ID "
+        "GROUP BY x.SECTION "
+        "ORDER BY x.SECTION;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        LeaderRollupRow r;
+        r.section = colText(stmt, 0);
+        r.hasLeader = sqlite3_column_type(stmt, 1) != SQLITE_NULL;
+        r.leaderId = sqlite3_column_int(stmt, 1);
+        r.leaderName = colText(stmt, 2);
+        r.leaderOutsideSection = sqlite3_column_int(stmt, 3) != 0;
+        r.members = sqlite3_column_int(stmt, 4);
+        r.eligible = sqlite3_column_int(stmt, 5);
+        r.noInstrument = sqlite3_column_int(stmt, 6);
+        r.noUniform = sqlite3_column_int(stmt, 7);
+        r.noShako = sqlite3_column_int(stmt, 8);
+        out.push_back(move(r));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+static bool loadStudentIds(Database& db, vector<int>& ids) {
+    ids.clear();
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), "SELECT STUDENT_ID FROM STUDENTS ORDER BY STUDENT_ID;", -1, &stmt, nullptr) != SQLITE_OK)
+        return db.failSQL();
+    while (sqlite3_step(stmt) == SQLITE_ROW) ids.push_back(sqlite3_column_int(stmt, 0));
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// ---------- Roster import pipeline ----------
+// Parser thread(s) -> validator thread -> writer (the calling thread, which
+// owns the connection). Stages hand rows on in batches through bounded
+// single-producer/single-consumer rings; a full ring holds its producer back,
+// so the earlier stages only ever run a few batches ahead of the inserts.
+template <class T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity), mask(capacity - 1) {}    // power of two
+
+    bool tryPush(T& item) {
+        size_t tail = tailPos.load(memory_order_relaxed);
+        if (tail - headPos.load(memory_order_acquire) == slots.size()) return false;
+        slots[tail & mask] = move(item);
+        tailPos.store(tail + 1, memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t head = headPos.load(memory_order_relaxed);
+        if (head == tailPos.load(memory_order_acquire)) return false;
+        item = move(slots[head & mask]);
+        headPos.store(head + 1, memory_order_release);
+        return true;
+    }
+
+    void push(T item) {
+        for (unsigned spins = 0; !tryPush(item); spins++) backoff(spins);
+    }
+
+    void pop(T& item) {
+        for (unsigned spins = 0; !tryPop(item); spins++) backoff(spins);
+    }
+
+private:
+    // A stage is stalled either for a moment (spin, then yield) or because the
+    // writer is far behind, in which case it should get out of the way.
+    static void backoff(unsigned spins) {
+        if (spins < 64) return;
+        if (spins < 128) this_thread::yield();
+        else this_thread::sleep_for(chrono::microseconds(spins < 256 ? 50 : 500));
+    }
+
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> headPos{0};
+    alignas(64) atomic<size_t> tailPos{0};
+};
+
+// Fields are views into the mapped file, which outlives every stage.
+struct RosterRow {
+    size_t line;                    // chunk-relative until the validator rebases it
+    int id = 0;
+    string_view fname, lname, classification, sectionField, shirt, shoe;
+    string section;                 // upper-cased by the validator
+    string error;                   // reported instead of written
+    bool probe = false;             // the key filter could not rule the ID out
+};
+
+struct RosterBatch {
+    vector<RosterRow> rows;
+    size_t lines = 0;               // on a chunk's last batch
+    bool last = false;
+};
+
+using RosterBatchPtr = unique_ptr<RosterBatch>;
+
+static const size_t ROSTER_BATCH_ROWS = 1024;
+static const size_t ROSTER_RING_BATCHES = 16;
+
+static void parseRosterChunk(char* begin, char* end, char delim, bool skipHeader,
+                             const function<void(RosterBatchPtr)>& emit) {
+    DelimitedReader reader(begin, end, delim);
+    RosterBatchPtr batch(new RosterBatch);
+    batch->rows.reserve(ROSTER_BATCH_ROWS);
+    while (reader.next()) {
+        if (reader.blank()) continue;
+        const vector<string_view>& f = reader.fields;
+
+        RosterRow row;
+        row.line = reader.line;
+        if (!parseNumber(f[0], row.id)) {
+            if (skipHeader && reader.line == 1) continue;
+            row.error = "bad STUDENT_ID '" + string(f[0]) + "'";
+        } else if (f.size() < 5) {
+            row.error = "expected at least 5 fields";
+        } else {
+            row.fname = trimView(f[1]);
+            row.lname = trimView(f[2]);
+            row.classification = trimView(f[3]);
+            row.sectionField = f[4];
+            if (f.size() > 5) row.shirt = trimView(f[5]);
+            if (f.size() > 6) row.shoe = trimView(f[6]);
+        }
+        batch->rows.push_back(move(row));
+
+        if (batch->rows.size() == ROSTER_BATCH_ROWS) {
+            emit(move(batch));
+            batch.reset(new RosterBatch);
+            batch->rows.reserve(ROSTER_BATCH_ROWS);
+        }
+    }
+    batch->lines = reader.line;
+    batch->last = true;
+    emit(move(batch));
+}
+
+// Sees the batches in file order, so line numbers and "first one wins" for a
+// repeated ID come out as they would from a single pass. An ID the key filter
+// cannot rule out is marked for the writer to look up; the rest go straight
+// to the INSERT.
+class RosterValidator {
+public:
+    explicit RosterValidator(const KeyFilter& existing) : existing(existing) {}
+
+    void check(RosterBatch& batch) {
+        for (RosterRow& r : batch.rows) {
+            r.line += lineBase;
+            if (!r.error.empty()) continue;
+            if (r.fname.empty() || r.lname.empty()) {
+                r.error = "first and last name are required";
+                continue;
+            }
+            r.section = upperCopy(string(trimView(r.sectionField)));
+            if (!isValidSection(r.section)) {
+                r.error = "bad SECTION '" + string(r.sectionField) + "'";
+                continue;
+            }
+            if (!added.insert(r.id).second)
+                r.error = "student " + to_string(r.id) + ": UNIQUE constraint failed: STUDENTS.STUDENT_ID";
+            else if ((r.probe = existing.mayContain(KeyFilter::hash(r.id))))
+                probedIds++;
+            else
+                clearedIds++;
+        }
+        if (batch.last) lineBase += batch.lines;
+    }
+
+    size_t cleared() const { return clearedIds; }
+    size_t probed() const { return probedIds; }
+
+private:
+    const KeyFilter& existing;
+    unordered_set<int> added;
+    size_t lineBase = 0;
+    size_t clearedIds = 0, probedIds = 0;
+};
+
+// Text is bound straight from the mapped file; rows that violate a constraint
+// (existing ID, bad section) are reported and the rest still go in. With a
+// spare core the stages overlap; on one core they take turns batch by batch.
+// The file is split between parsers at line boundaries only when it holds no
+// quotes, since a quoted name may carry a newline.
+bool StudentRepo::importFile(const string& path, ImportResult& result) {
+    result = ImportResult();
+    MappedFile file;
+    if (!file.open(path)) return db.fail("Can't read " + path);
+    char delim = detectDelimiter(file.data, file.size);
+
+    const char* sql =
+        "INSERT INTO STUDENTS (STUDENT_ID, FNAME, LNAME, CLASSIFICATION, SECTION, SHIRT_SIZE, SHOE_SIZE) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?);";
+    string csql =
+        "INSERT OR IGNORE INTO COMPLIANCE "
+        "(STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
+        "VALUES (?, 0, 0.0, 0, " + string(db.today()) + ");";
+
+    sqlite3* conn = db.handle();
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_stmt* cstmt = nullptr;
+    sqlite3_stmt* probe = nullptr;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, csql.c_str(), -1, &cstmt, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(conn, "SELECT 1 FROM STUDENTS WHERE STUDENT_ID=?;", -1, &probe, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        sqlite3_finalize(stmt);
+        sqlite3_finalize(cstmt);
+        return false;
+    }
+
+    auto start = chrono::steady_clock::now();
+    BatchCommitter batches(db);
+    if (!batches.begin()) {
+        sqlite3_finalize(stmt);
+        sqlite3_finalize(cstmt);
+        sqlite3_finalize(probe);
+        return false;
+    }
+    const KeyFilter* existing = db.studentKeys();
+    if (!existing) {
+        batches.abort();
+        sqlite3_finalize(stmt);
+        sqlite3_finalize(cstmt);
+        sqlite3_finalize(probe);
+        return false;
+    }
+    RosterValidator validator(*existing);
+
+    // After a failed commit the remaining batches are drained, not written,
+    // so the stages can run out. New IDs join the filter once the validator
+    // is done reading it.
+    vector<ParseError>& errors = result.errors;
+    vector<int> addedIds;
+    bool failed = false;
+    auto write = [&](RosterBatch& batch) {
+        for (RosterRow& r : batch.rows) {
+            if (failed) return;
+            if (!r.error.empty()) {
+                errors.push_back({r.line, move(r.error)});
+                continue;
+            }
+            if (r.probe) {
+                sqlite3_bind_int(probe, 1, r.id);
+                bool known = sqlite3_step(probe) == SQLITE_ROW;
+                sqlite3_reset(probe);
+                if (known) {
+                    errors.push_back({r.line, "student " + to_string(r.id) + ": UNIQUE constraint failed: STUDENTS.STUDENT_ID"});
+                    continue;
+                }
+                result.falsePositives++;
+            }
+            sqlite3_bind_int(stmt, 1, r.id);
+            bindOptionalView(stmt, 2, r.fname);
+            bindOptionalView(stmt, 3, r.lname);
+            bindOptionalView(stmt, 4, r.classification);
+            sqlite3_bind_text(stmt, 5, r.section.c_str(), -1, SQLITE_TRANSIENT);
+            bindOptionalView(stmt, 6, r.shirt);
+            bindOptionalView(stmt, 7, r.shoe);
+
+            bool inserted = sqlite3_step(stmt) == SQLITE_DONE;
+            if (!inserted) errors.push_back({r.line, "student " + to_string(r.id) + ": " + sqlite3_errmsg(conn)});
+            sqlite3_reset(stmt);
+            if (inserted) {
+                sqlite3_bind_int(cstmt, 1, r.id);
+                sqlite3_step(cstmt);
+                sqlite3_reset(cstmt);
+                addedIds.push_back(r.id);
+                result.added++;
+                failed = !batches.wrote();
+            }
+        }
+    };
+
+    unsigned cores = thread::hardware_concurrency();
+    unsigned parsers = 1;
+    if (cores > 2 && file.size >= (4u << 20) && !memchr(file.data, '"', file.size))
+        parsers = min(cores - 2, 4u);       // the validator and writer take two
+    result.threads = parsers;
+
+    char* base = file.data;
+    char* end = base + file.size;
+    if (cores <= 1) {
+        parseRosterChunk(base, end, delim, true, [&](RosterBatchPtr batch) {
+            validator.check(*batch);
+            write(*batch);
+        });
+        result.parseSec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } else {
+        vector<char*> bounds(parsers + 1, end);
+        bounds[0] = base;
+        for (unsigned i = 1; i < parsers; i++) {
+            char* p = base + file.size / parsers * i;
+            if (p < bounds[i - 1]) p = bounds[i - 1];
+            char* nl = (char*)memchr(p, '\n', (size_t)(end - p));
+            bounds[i] = nl ? nl + 1 : end;
+        }
+
+        vector<unique_ptr<SpscRing<RosterBatchPtr>>> parsed;
+        for (unsigned i = 0; i < parsers; i++)
+            parsed.emplace_back(new SpscRing<RosterBatchPtr>(ROSTER_RING_BATCHES));
+        SpscRing<RosterBatchPtr> validated(ROSTER_RING_BATCHES);
+
+        vector<thread> stages;
+        vector<chrono::steady_clock::time_point> parseDone(parsers);
+        for (unsigned i = 0; i < parsers; i++) {
+            stages.emplace_back([&, i] {
+                parseRosterChunk(bounds[i], bounds[i + 1], delim, i == 0,
+                                 [&](RosterBatchPtr batch) { parsed[i]->push(move(batch)); });
+                parseDone[i] = chrono::steady_clock::now();
+            });
+        }
+        // Chunks are validated in file order; a null batch ends the stream.
+        stages.emplace_back([&] {
+            for (auto& in : parsed) {
+                bool last = false;
+                while (!last) {
+                    RosterBatchPtr batch;
+                    in->pop(batch);
+                    validator.check(*batch);
+                    last = batch->last;
+                    validated.push(move(batch));
+                }
+            }
+            validated.push(RosterBatchPtr());
+        });
+
+        while (true) {
+            RosterBatchPtr batch;
+            if (!validated.tryPop(batch)) {
+                auto waitStart = chrono::steady_clock::now();
+                validated.pop(batch);
+                result.waitSec += chrono::duration<double>(chrono::steady_clock::now() - waitStart).count();
+            }
+            if (!batch) break;
+            write(*batch);
+        }
+        for (thread& t : stages) t.join();
+        for (auto& t : parseDone)
+            result.parseSec = max(result.parseSec, chrono::duration<double>(t - start).count());
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(cstmt);
+    sqlite3_finalize(probe);
+    for (int id : addedIds) db.addStudentKey(id);
+    result.keysCleared = validator.cleared();
+    result.keysProbed = validator.probed();
+
+    bool ok = !failed && batches.finish();
+    batches.report(result);
+    if (!ok) {
+        result.added = batches.committed;
+        return false;
+    }
+    result.writeSec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// ---------- Student removal and merge ----------
+// Both work on temp.STUDENT_BATCH (ID = student going away, KEEP = where a
+// merge sends its things) so each cleanup step is one statement over the
+// whole batch. Batches up to UNDO_BATCH_LIMIT students are journaled; larger
+// ones are bulk operations like the imports.
+
+static const struct { const char* table; const char* key; UndoTable undo; } GEAR_TABLES[] = {
+    {"INSTRUMENTS", "INSTRUMENT_ID", UndoTable::Instruments},
+    {"UNIFORMS", "UNIFORM_ID", UndoTable::Uniforms},
+    {"SHAKOS", "SHAKO_ID", UndoTable::Shakos},
+};
+
+// Runs one statement and returns how many rows it changed, or -1.
+static int execCount(Database& db, const string& sql) {
+    if (!db.exec(sql)) return -1;
+    return sqlite3_changes(db.handle());
+}
+
+// Loads (ID, KEEP) rows into the batch table; drops IDs not on the roster.
+static bool fillStudentBatch(Database& db, const vector<pair<int, int>>& rows, StudentCleanup& out) {
+    if (!db.exec("CREATE TEMP TABLE IF NOT EXISTS STUDENT_BATCH (ID INTEGER PRIMARY KEY, KEEP INTEGER);") ||
+        !db.exec("CREATE INDEX IF NOT EXISTS temp.IDX_STUDENT_BATCH_KEEP ON STUDENT_BATCH(KEEP);") ||
+        !db.exec("DELETE FROM temp.STUDENT_BATCH;"))
+        return false;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), "INSERT OR IGNORE INTO temp.STUDENT_BATCH (ID, KEEP) VALUES (?, ?);",
+                           -1, &stmt, nullptr) != SQLITE_OK)
+        return db.failSQL();
+    for (const auto& r : rows) {
+        sqlite3_bind_int(stmt, 1, r.first);
+        sqlite3_bind_int(stmt, 2, r.second);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            db.failSQL("Batch insert failed");
+            sqlite3_finalize(stmt);
+            return false;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    int missing = execCount(db, "DELETE FROM temp.STUDENT_BATCH WHERE ID NOT IN (SELECT STUDENT_ID FROM STUDENTS);");
+    if (missing < 0) return false;
+    out.missing = (size_t)missing;
+    return true;
+}
+
+// Captures every row the batch will write. Gear and leaders come first so
+// that undo, which restores in reverse, puts the students back before the
+// rows that reference them.
+static bool journalStudentBatch(Database& db, UndoScope& undo, bool merging) {
+    struct Query { const char* sql; UndoTable table; bool textKey; };
+    vector<Query> queries;
+    string gearSql[size(GEAR_TABLES)];
+    for (size_t i = 0; i < size(GEAR_TABLES); i++) {
+        gearSql[i] = string("SELECT ") + GEAR_TABLES[i].key + " FROM " + GEAR_TABLES[i].table +
+                     " WHERE CHECKED_OUT_TO IN (SELECT ID FROM temp.STUDENT_BATCH);";
+        queries.push_back({gearSql[i].c_str(), GEAR_TABLES[i].undo, false});
+    }
+    queries.push_back({"SELECT SECTION FROM SECTION_LEADERS "
+                       "WHERE LEADER_STUDENT_ID IN (SELECT ID FROM temp.STUDENT_BATCH);",
+                       UndoTable::SectionLeaders, true});
+    if (merging)
+        queries.push_back({"SELECT DISTINCT KEEP FROM temp.STUDENT_BATCH;", UndoTable::Compliance, false});
+    queries.push_back({"SELECT ID FROM temp.STUDENT_BATCH;", UndoTable::Compliance, false});
+    queries.push_back({"SELECT ID FROM temp.STUDENT_BATCH;", UndoTable::Students, false});
+
+    for (const Query& q : queries) {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db.handle(), q.sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (q.textKey) undo.touch(q.table, string(colText(stmt, 0)));
+            else undo.touch(q.table, sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return true;
+}
+
+static string batchLabel(const char* verb, const vector<pair<int, int>>& rows) {
+    if (rows.size() == 1) return string(verb) + " student " + to_string(rows[0].first);
+    return string(verb) + " " + to_string(rows.size()) + " students";
+}
+
+bool StudentRepo::remove(const vector<int>& ids, StudentCleanup& out) {
+    out = StudentCleanup();
+    vector<pair<int, int>> rows;
+    rows.reserve(ids.size());
+    for (int id : ids) rows.push_back({id, 0});
+
+    out.undoable = rows.size() <= UNDO_BATCH_LIMIT;
+    UndoScope undo(db, batchLabel("Remove", rows), out.undoable);
+    if (!fillStudentBatch(db, rows, out)) return undo.finish(false);
+    if (out.undoable && !journalStudentBatch(db, undo, false)) return undo.finish(false);
+
+    for (const auto& g : GEAR_TABLES) {
+        int n = execCount(db, string("UPDATE ") + g.table + " SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL "
+                              "WHERE CHECKED_OUT_TO IN (SELECT ID FROM temp.STUDENT_BATCH);");
+        if (n < 0) return undo.finish(false);
+        out.gearReleased += (size_t)n;
+    }
+    int leaders = execCount(db, "DELETE FROM SECTION_LEADERS "
+                                "WHERE LEADER_STUDENT_ID IN (SELECT ID FROM temp.STUDENT_BATCH);");
+    int students = leaders < 0 ? -1 : execCount(db,
+        "DELETE FROM STUDENTS WHERE STUDENT_ID IN (SELECT ID FROM temp.STUDENT_BATCH);");
+    if (students < 0) return undo.finish(false);
+    out.leadersCleared = (size_t)leaders;
+    out.students = (size_t)students;
+    return undo.finish(db.exec("DELETE FROM temp.STUDENT_BATCH;"));
+}
+
+bool StudentRepo::merge(const vector<pair<int, int>>& pairs, StudentCleanup& out) {
+    out = StudentCleanup();
+    vector<pair<int, int>> rows;
+    rows.reserve(pairs.size());
+    for (const auto& p : pairs) {
+        if (p.first != p.second) rows.push_back(p);
+    }
+
+    out.undoable = rows.size() <= UNDO_BATCH_LIMIT;
+    UndoScope undo(db, batchLabel("Merge", rows), out.undoable);
+    if (!fillStudentBatch(db, rows, out)) return undo.finish(false);
+
+    // Kept students must exist and must not be merged away themselves.
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(),
+            "SELECT KEEP, KEEP IN (SELECT ID FROM temp.STUDENT_BATCH) FROM temp.STUDENT_BATCH "
+            "WHERE KEEP NOT IN (SELECT STUDENT_ID FROM STUDENTS) "
+            "   OR KEEP IN (SELECT ID FROM temp.STUDENT_BATCH) LIMIT 1;",
+            -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return undo.finish(false);
+    }
+    bool valid = true;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        string id = to_string(sqlite3_column_int(stmt, 0));
+        db.fail(sqlite3_column_int(stmt, 1) ? "Student " + id + " is both kept and merged away"
+                                            : "Student " + id + " (to keep) not found");
+        valid = false;
+    }
+    sqlite3_finalize(stmt);
+    if (!valid) return undo.finish(false);
+    if (out.undoable && !journalStudentBatch(db, undo, true)) return undo.finish(false);
+
+    // One item of each kind per student (CHECKED_OUT_TO is UNIQUE): a kept
+    // student with none takes the lowest-numbered item among its duplicates,
+    // and everything else the duplicates hold is checked in.
+    for (const auto& g : GEAR_TABLES) {
+        string table = g.table, key = g.key;
+        int moved = execCount(db,
+            "UPDATE " + table + " SET CHECKED_OUT_TO="
+            "  (SELECT KEEP FROM temp.STUDENT_BATCH WHERE ID=" + table + ".CHECKED_OUT_TO) "
+            "WHERE " + key + " IN ("
+            "  SELECT MIN(g." + key + ") FROM " + table + " g "
+            "  JOIN temp.STUDENT_BATCH b ON b.ID=g.CHECKED_OUT_TO "
+            "  WHERE NOT EXISTS (SELECT 1 FROM " + table + " h WHERE h.CHECKED_OUT_TO=b.KEEP) "
+            "  GROUP BY b.KEEP);");
+        int released = moved < 0 ? -1 : execCount(db,
+            "UPDATE " + table + " SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL "
+            "WHERE CHECKED_OUT_TO IN (SELECT ID FROM temp.STUDENT_BATCH);");
+        if (released < 0) return undo.finish(false);
+        out.gearReassigned += (size_t)moved;
+        out.gearReleased += (size_t)released;
+    }
+
+    int leaders = execCount(db,
+        "UPDATE SECTION_LEADERS SET LEADER_STUDENT_ID="
+        "  (SELECT KEEP FROM temp.STUDENT_BATCH WHERE ID=LEADER_STUDENT_ID) "
+        "WHERE LEADER_STUDENT_ID IN (SELECT ID FROM temp.STUDENT_BATCH);");
+    // Newest LAST_VERIFIED_DATE in each group wins; ties go to the kept row.
+    int compliance = leaders < 0 ? -1 : execCount(db,
+        "INSERT INTO COMPLIANCE (STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
+        "SELECT b.KEEP, c.CREDIT_HOURS, c.GPA, c.DUES_PAID, c.LAST_VERIFIED_DATE "
+        "FROM temp.STUDENT_BATCH b JOIN COMPLIANCE c ON c.STUDENT_ID=b.ID "
+        "WHERE c.STUDENT_ID=("
+        "  SELECT c2.STUDENT_ID FROM temp.STUDENT_BATCH b2 JOIN COMPLIANCE c2 ON c2.STUDENT_ID=b2.ID "
+        "  WHERE b2.KEEP=b.KEEP ORDER BY c2.LAST_VERIFIED_DATE DESC, c2.STUDENT_ID LIMIT 1) "
+        "ON CONFLICT(STUDENT_ID) DO UPDATE SET "
+        "CREDIT_HOURS=excluded.CREDIT_HOURS, "
+        "GPA=excluded.GPA, "
+        "DUES_PAID=excluded.DUES_PAID, "
+        "LAST_VERIFIED_DATE=excluded.LAST_VERIFIED_DATE "
+        "WHERE excluded.LAST_VERIFIED_DATE IS NOT NULL AND (COMPLIANCE.LAST_VERIFIED_DATE IS NULL "
+        "  OR excluded.LAST_VERIFIED_DATE > COMPLIANCE.LAST_VERIFIED_DATE);");
+    int students = compliance < 0 ? -1 : execCount(db,
+        "DELETE FROM STUDENTS WHERE STUDENT_ID IN (SELECT ID FROM temp.STUDENT_BATCH);");
+    if (students < 0) return undo.finish(false);
+    out.leadersReassigned = (size_t)leaders;
+    out.complianceMerged = (size_t)compliance;
+    out.students = (size_t)students;
+    return undo.finish(db.exec("DELETE FROM temp.STUDENT_BATCH;"));
+}
+
+// ---------- Inventory ----------
+// Instrument queries read INSTRUMENTS alone and take type name/section and
+// sort order from the in-memory catalog instead of joining INSTRUMENT_TYPES.
+static bool loadInstruments(Database& db, const string& tail, vector<Instrument>& out, sqlite3_int64 arg = 0) {
+    string sql =
+        "SELECT INSTRUMENT_ID, TYPE_ID, COALESCE(SERIAL,''), CHECKED_OUT_TO, "
+        "       COALESCE(CHECKED_OUT_DATE,''), COALESCE(CONDITION_NOTES,'') "
+        "FROM INSTRUMENTS_TEXT " + tail;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    if (sqlite3_bind_parameter_count(stmt) > 0) sqlite3_bind_int64(stmt, 1, arg);
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Instrument r;
+        r.id = sqlite3_column_int(stmt, 0);
+        const InstrumentType* t = db.findInstrumentType(sqlite3_column_int(stmt, 1));
+        r.rank = t ? t->rank : numeric_limits<int>::max();
+        r.type = t ? t->name : "?";
+        r.section = t ? t->section : "";
+        r.serial = colText(stmt, 2);
+        r.checkedOut = sqlite3_column_type(stmt, 3) != SQLITE_NULL;
+        r.studentId = sqlite3_column_int(stmt, 3);
+        r.date = colText(stmt, 4);
+        r.notes = colText(stmt, 5);
+        out.push_back(move(r));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool InventoryRepo::instruments(Holding which, vector<Instrument>& out) {
+    string tail;
+    if (which == Holding::Available) tail = "WHERE CHECKED_OUT_TO IS NULL;";
+    else if (which == Holding::CheckedOut) tail = "WHERE CHECKED_OUT_TO IS NOT NULL ORDER BY INSTRUMENT_ID;";
+    if (!loadInstruments(db, tail, out)) return false;
+
+    // Available first, then catalog order (SECTION, TYPE_NAME), then ID.
+    if (which != Holding::CheckedOut) {
+        sort(out.begin(), out.end(), [](const Instrument& a, const Instrument& b) {
+            if (a.checkedOut != b.checkedOut) return !a.checkedOut;
+            return a.rank != b.rank ? a.rank < b.rank : a.id < b.id;
+        });
+    }
+    return true;
+}
+
+Outcome InventoryRepo::addInstrument(int typeId, const string& serial, const string& notes) {
+    if (!db.findInstrumentType(typeId)) return Outcome::NotFound;
+
+    UndoScope undo(db, serial.empty() ? string("Add instrument") : "Add instrument " + serial);
+
+    const char* sql =
+        "INSERT INTO INSTRUMENTS (TYPE_ID, SERIAL, CONDITION_NOTES) "
+        "VALUES (?, ?, ?);";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+
+    sqlite3_bind_int(stmt, 1, typeId);
+    bindOptionalText(stmt, 2, serial);
+    bindOptionalText(stmt, 3, notes);
+
+    Outcome result = Outcome::Done;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL("Add failed");
+        result = Outcome::Failed;
+    } else {
+        undo.inserted(UndoTable::Instruments, sqlite3_last_insert_rowid(db.handle()));
+        if (!serial.empty()) db.addSerialKey(serial);
+    }
+    sqlite3_finalize(stmt);
+    return undo.finish(result);
+}
+
+// Runs a one-row UPDATE bound to (a[, b]); NotFound when it matched nothing.
+static Outcome updateOne(Database& db, const char* sql, const char* failure, int a, int b = 0, bool twoArgs = false) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+    sqlite3_bind_int(stmt, 1, a);
+    if (twoArgs) sqlite3_bind_int(stmt, 2, b);
+
+    Outcome result = Outcome::Done;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL(failure);
+        result = Outcome::Failed;
+    } else if (!sqlite3_changes(db.handle())) {
+        result = Outcome::NotFound;
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+Outcome InventoryRepo::checkoutInstrument(int instrumentId, int studentId) {
+    UndoScope undo(db, "Check out instrument " + to_string(instrumentId) + " to " + to_string(studentId));
+    undo.touch(UndoTable::Instruments, instrumentId);
+    string sql =
+        "UPDATE INSTRUMENTS "
+        "SET CHECKED_OUT_TO=?, CHECKED_OUT_DATE=" + string(db.today()) + " "
+        "WHERE INSTRUMENT_ID=? AND CHECKED_OUT_TO IS NULL;";
+    return undo.finish(updateOne(db, sql.c_str(), "Checkout failed", studentId, instrumentId, true));
+}
+
+Outcome InventoryRepo::returnInstrument(int instrumentId) {
+    UndoScope undo(db, "Return instrument " + to_string(instrumentId));
+    undo.touch(UndoTable::Instruments, instrumentId);
+    return undo.finish(updateOne(db,
+        "UPDATE INSTRUMENTS "
+        "SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL "
+        "WHERE INSTRUMENT_ID=?;",
+        "Return failed", instrumentId));
+}
+
+Outcome InventoryRepo::checkoutUniform(int studentId, const Uniform& u) {
+    StudentRepo students(db);
+    if (!students.exists(studentId)) return Outcome::NotFound;
+
+    UndoScope undo(db, "Check out uniform to " + to_string(studentId));
+
+    string sql =
+        "INSERT INTO UNIFORMS (COAT_SIZE, PANT_SIZE, COAT_NUMBER, PANT_NUMBER, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE) "
+        "VALUES (?, ?, ?, ?, ?, ?, " + string(db.today()) + ");";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+
+    bindOptionalText(stmt, 1, u.coatSize);
+    bindOptionalText(stmt, 2, u.pantSize);
+    bindOptionalText(stmt, 3, u.coatNumber);
+    bindOptionalText(stmt, 4, u.pantNumber);
+    bindOptionalText(stmt, 5, u.notes);
+    sqlite3_bind_int(stmt, 6, studentId);
+
+    Outcome result = Outcome::Done;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL("Checkout failed");
+        result = Outcome::Failed;
+    } else {
+        undo.inserted(UndoTable::Uniforms, sqlite3_last_insert_rowid(db.handle()));
+    }
+    sqlite3_finalize(stmt);
+    return undo.finish(result);
+}
+
+static bool loadUniforms(Database& db, const string& tail, vector<Uniform>& out, sqlite3_int64 arg = 0) {
+    string sql =
+        "SELECT UNIFORM_ID, COALESCE(COAT_SIZE,''), COALESCE(PANT_SIZE,''), "
+        "       COALESCE(COAT_NUMBER,''), COALESCE(PANT_NUMBER,''), "
+        "       COALESCE(CONDITION_NOTES,''), "
+        "       CHECKED_OUT_TO, COALESCE(CHECKED_OUT_DATE,'') "
+        "FROM UNIFORMS_TEXT " + tail;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    if (sqlite3_bind_parameter_count(stmt) > 0) sqlite3_bind_int64(stmt, 1, arg);
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Uniform u;
+        u.id = sqlite3_column_int(stmt, 0);
+        u.coatSize = colText(stmt, 1);
+        u.pantSize = colText(stmt, 2);
+        u.coatNumber = colText(stmt, 3);
+        u.pantNumber = colText(stmt, 4);
+        u.notes = colText(stmt, 5);
+        u.checkedOut = sqlite3_column_type(stmt, 6) != SQLITE_NULL;
+        u.studentId = sqlite3_column_int(stmt, 6);
+        u.date = colText(stmt, 7);
+        out.push_back(move(u));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool InventoryRepo::uniforms(Holding which, vector<Uniform>& out) {
+    if (which == Holding::All)
+        return loadUniforms(db, "ORDER BY (CHECKED_OUT_TO IS NULL) DESC, UNIFORM_ID;", out);
+    if (which == Holding::Available)
+        return loadUniforms(db, "WHERE CHECKED_OUT_TO IS NULL ORDER BY UNIFORM_ID;", out);
+    return loadUniforms(db, "WHERE CHECKED_OUT_TO IS NOT NULL ORDER BY UNIFORM_ID;", out);
+}
+
+Outcome InventoryRepo::returnUniform(int uniformId) {
+    UndoScope undo(db, "Return uniform " + to_string(uniformId));
+    undo.touch(UndoTable::Uniforms, uniformId);
+    return undo.finish(updateOne(db,
+        "UPDATE UNIFORMS SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL WHERE UNIFORM_ID=?;",
+        "Return failed", uniformId));
+}
+
+Outcome InventoryRepo::checkoutShako(int studentId, const Shako& s) {
+    StudentRepo students(db);
+    if (!students.exists(studentId)) return Outcome::NotFound;
+
+    UndoScope undo(db, "Check out shako to " + to_string(studentId));
+
+    string sql =
+        "INSERT INTO SHAKOS (SIZE, CONDITION_NOTES, CHECKED_OUT_TO, CHECKED_OUT_DATE) "
+        "VALUES (?, ?, ?, " + string(db.today()) + ");";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+
+    bindOptionalText(stmt, 1, s.size);
+    bindOptionalText(stmt, 2, s.notes);
+    sqlite3_bind_int(stmt, 3, studentId);
+
+    Outcome result = Outcome::Done;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL("Checkout failed");
+        result = Outcome::Failed;
+    } else {
+        undo.inserted(UndoTable::Shakos, sqlite3_last_insert_rowid(db.handle()));
+    }
+    sqlite3_finalize(stmt);
+    return undo.finish(result);
+}
+
+static bool loadShakos(Database& db, const string& tail, vector<Shako>& out, sqlite3_int64 arg = 0) {
+    string sql =
+        "SELECT SHAKO_ID, COALESCE(SIZE,''), CHECKED_OUT_TO, "
+        "       COALESCE(CHECKED_OUT_DATE,''), COALESCE(CONDITION_NOTES,'') "
+        "FROM SHAKOS_TEXT " + tail;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    if (sqlite3_bind_parameter_count(stmt) > 0) sqlite3_bind_int64(stmt, 1, arg);
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Shako s;
+        s.id = sqlite3_column_int(stmt, 0);
+        s.size = colText(stmt, 1);
+        s.checkedOut = sqlite3_column_type(stmt, 2) != SQLITE_NULL;
+        s.studentId = sqlite3_column_int(stmt, 2);
+        s.date = colText(stmt, 3);
+        s.notes = colText(stmt, 4);
+        out.push_back(move(s));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool InventoryRepo::shakos(Holding which, vector<Shako>& out) {
+    if (which == Holding::All)
+        return loadShakos(db, "ORDER BY (CHECKED_OUT_TO IS NULL) DESC, SHAKO_ID;", out);
+    if (which == Holding::Available)
+        return loadShakos(db, "WHERE CHECKED_OUT_TO IS NULL ORDER BY SHAKO_ID;", out);
+    return loadShakos(db, "WHERE CHECKED_OUT_TO IS NOT NULL ORDER BY SHAKO_ID;", out);
+}
+
+Outcome InventoryRepo::returnShako(int shakoId) {
+    UndoScope undo(db, "Return shako " + to_string(shakoId));
+    undo.touch(UndoTable::Shakos, shakoId);
+    return undo.finish(updateOne(db,
+        "UPDATE SHAKOS SET CHECKED_OUT_TO=NULL, CHECKED_OUT_DATE=NULL WHERE SHAKO_ID=?;",
+        "Return failed", shakoId));
+}
+
+// Instrument type names are resolved through the type catalog and serials are
+// checked against the rest of the file and the inventory before any insert.
+// Only a serial the key filter cannot rule out is looked up in INSTRUMENTS;
+// serials from earlier lines are caught by the file check first.
+bool InventoryRepo::importFile(const string& path, InventoryKind kind, ImportResult& result) {
+    result = ImportResult();
+    MappedFile file;
+    if (!file.open(path)) return db.fail("Can't read " + path);
+
+    const char* sql = nullptr;
+    const char* headerName = nullptr;
+    size_t minFields = 1;
+    switch (kind) {
+        case InventoryKind::Instruments:
+            sql = "INSERT INTO INSTRUMENTS (TYPE_ID, SERIAL, CONDITION_NOTES) VALUES (?, ?, ?);";
+            headerName = "TYPE_NAME";
+            minFields = 1;
+            break;
+        case InventoryKind::Uniforms:
+            sql = "INSERT INTO UNIFORMS (COAT_SIZE, PANT_SIZE, COAT_NUMBER, PANT_NUMBER, CONDITION_NOTES) "
+                  "VALUES (?, ?, ?, ?, ?);";
+            headerName = "COAT_SIZE";
+            minFields = 4;
+            break;
+        case InventoryKind::Shakos:
+            sql = "INSERT INTO SHAKOS (SIZE, CONDITION_NOTES) VALUES (?, ?);";
+            headerName = "SIZE";
+            minFields = 1;
+            break;
+    }
+
+    const KeyFilter* serials = nullptr;
+    if (kind == InventoryKind::Instruments && (!db.loadInstrumentTypes() || !(serials = db.serialKeys())))
+        return false;
+
+    sqlite3* conn = db.handle();
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_stmt* probe = nullptr;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK ||
+        (serials && sqlite3_prepare_v2(conn, "SELECT 1 FROM INSTRUMENTS WHERE SERIAL=?;", -1, &probe, nullptr) != SQLITE_OK)) {
+        db.failSQL();
+        sqlite3_finalize(stmt);
+        return false;
+    }
+
+    auto start = chrono::steady_clock::now();
+    BatchCommitter batches(db);
+    if (!batches.begin()) {
+        sqlite3_finalize(stmt);
+        sqlite3_finalize(probe);
+        return false;
+    }
+
+    DelimitedReader reader(file.data, file.data + file.size, detectDelimiter(file.data, file.size));
+    unordered_map<string_view, size_t> fileSerials;     // serial -> first line
+    vector<ParseError>& errors = result.errors;
+    bool failed = false;
+    auto field = [&](size_t i) { return i < reader.fields.size() ? trimView(reader.fields[i]) : string_view(); };
+
+    while (reader.next()) {
+        if (reader.blank()) continue;
+        if (reader.line == 1 && upperCopy(string(field(0))) == headerName) continue;
+        if (reader.fields.size() < minFields) {
+            errors.push_back({reader.line, "expected at least " + to_string(minFields) + " fields"});
+            continue;
+        }
+
+        int col = 1;
+        if (kind == InventoryKind::Instruments) {
+            const InstrumentType* t = db.findInstrumentType(string(field(0)));
+            if (!t) {
+                errors.push_back({reader.line, "unknown instrument type '" + string(field(0)) + "'"});
+                continue;
+            }
+            string_view serial = field(1);
+            if (!serial.empty()) {
+                auto seen = fileSerials.find(serial);
+                if (seen != fileSerials.end()) {
+                    errors.push_back({reader.line, "serial '" + string(serial) + "' repeats line " +
+                                                   to_string(seen->second)});
+                    result.duplicates++;
+                    continue;
+                }
+                if (serials->keys() > serials->capacity() && !(serials = db.serialKeys())) {
+                    failed = true;      // rebuilt from the table, this file's rows included
+                    break;
+                }
+                bool known = false;
+                if (serials->mayContain(KeyFilter::hash(serial))) {
+                    result.keysProbed++;
+                    bindOptionalView(probe, 1, serial);
+                    known = sqlite3_step(probe) == SQLITE_ROW;
+                    sqlite3_reset(probe);
+                    if (!known) result.falsePositives++;
+                } else {
+                    result.keysCleared++;
+                }
+                if (known) {
+                    errors.push_back({reader.line, "serial '" + string(serial) + "' is already in inventory"});
+                    result.duplicates++;
+                    continue;
+                }
+                fileSerials.emplace(serial, reader.line);
+                db.addSerialKey(serial);
+            }
+            sqlite3_bind_int(stmt, col++, t->id);
+            bindOptionalView(stmt, col++, serial);
+            bindOptionalView(stmt, col++, field(2));
+        } else if (kind == InventoryKind::Uniforms) {
+            for (size_t i = 0; i < 5; i++) bindOptionalView(stmt, col++, field(i));
+        } else {
+            bindOptionalView(stmt, col++, field(0));
+            bindOptionalView(stmt, col++, field(1));
+        }
+
+        bool inserted = sqlite3_step(stmt) == SQLITE_DONE;
+        if (!inserted) errors.push_back({reader.line, sqlite3_errmsg(conn)});
+        sqlite3_reset(stmt);
+        if (inserted) {
+            result.added++;
+            if (!batches.wrote()) {
+                failed = true;
+                break;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(probe);
+
+    bool ok = !failed && batches.finish();
+    batches.report(result);
+    if (!ok) {
+        result.added = batches.committed;
+        return false;
+    }
+    result.writeSec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// ---------- Compliance ----------
+Outcome ComplianceRepo::update(int studentId, int creditHours, double gpa, bool duesPaid) {
+    StudentRepo students(db);
+    if (!students.exists(studentId)) return Outcome::NotFound;
+
+    UndoScope undo(db, "Update compliance for " + to_string(studentId));
+    undo.touch(UndoTable::Compliance, studentId);
+
+    string sql =
+        "INSERT INTO COMPLIANCE (STUDENT_ID, CREDIT_HOURS, GPA, DUES_PAID, LAST_VERIFIED_DATE) "
+        "VALUES (?, ?, ?, ?, " + string(db.today()) + ") "
+        "ON CONFLICT(STUDENT_ID) DO UPDATE SET "
+        "CREDIT_HOURS=excluded.CREDIT_HOURS, "
+        "GPA=excluded.GPA, "
+        "DUES_PAID=excluded.DUES_PAID, "
+        "LAST_VERIFIED_DATE=excluded.LAST_VERIFIED_DATE;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        db.failSQL();
+        return Outcome::Failed;
+    }
+
+    sqlite3_bind_int(stmt, 1, studentId);
+    sqlite3_bind_int(stmt, 2, creditHours);
+    sqlite3_bind_double(stmt, 3, gpa);
+    sqlite3_bind_int(stmt, 4, duesPaid ? 1 : 0);
+
+    Outcome result = Outcome::Done;
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        db.failSQL("Update failed");
+        result = Outcome::Failed;
+    }
+    sqlite3_finalize(stmt);
+    return undo.finish(result);
+}
+
+bool ComplianceRepo::eligibilityReport(vector<StudentProfile>& out) {
+    return loadStudentProfiles(db,
+        "ORDER BY (COALESCE(c.CREDIT_HOURS,0) >= 12 AND COALESCE(c.GPA,0.0) >= 3.0 AND COALESCE(c.DUES_PAID,0)=1) ASC, "
+        "         s.SECTION, s.LNAME, s.FNAME;", out);
+}
+
+static bool loadEvents(Database& db, const char* sql, sqlite3_int64 arg, vector<EligibilityEvent>& out) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    sqlite3_bind_int64(stmt, 1, arg);
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        out.push_back({sqlite3_column_int64(stmt, 0), sqlite3_column_int(stmt, 1), colText(stmt, 2),
+                       sqlite3_column_int(stmt, 3) != 0, sqlite3_column_int(stmt, 4) != 0, colText(stmt, 5)});
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool ComplianceRepo::recentChanges(int limit, vector<EligibilityEvent>& out) {
+    return loadEvents(db,
+        "SELECT e.EVENT_ID, e.STUDENT_ID, COALESCE(s.FNAME || ' ' || s.LNAME, ''), "
+        "       e.WAS_ELIGIBLE, e.IS_ELIGIBLE, e.CHANGED_AT "
+        "FROM ELIGIBILITY_EVENTS e "
+        "LEFT JOIN STUDENTS s ON s.STUDENT_ID=e.STUDENT_ID "
+        "ORDER BY e.EVENT_ID DESC LIMIT ?;", limit, out);
+}
+
+bool ComplianceRepo::eventsAfter(sqlite3_int64 afterId, vector<EligibilityEvent>& out) {
+    return loadEvents(db,
+        "SELECT EVENT_ID, STUDENT_ID, '', WAS_ELIGIBLE, IS_ELIGIBLE, CHANGED_AT "
+        "FROM ELIGIBILITY_EVENTS WHERE EVENT_ID > ? ORDER BY EVENT_ID;", afterId, out);
+}
+
+// ---------- Analytics ----------
+const char* const ANALYTICS_SECTIONS[] = {"WOODWIND", "BRASS", "PERCUSSION", "AUXILIARY", "DM", "OTHER"};
+const char* const ANALYTICS_CLASSES[] = {"FRESHMAN", "SOPHOMORE", "JUNIOR", "SENIOR", "OTHER"};
+
+static int classCode(const string& classification) {
+    string c = upperCopy(trim(classification));
+    for (int i = 0; i < ANALYTICS_NUM_CLASSES - 1; i++)
+        if (c == ANALYTICS_CLASSES[i]) return i;
+    return ANALYTICS_NUM_CLASSES - 1;
+}
+
+// Sections the console does not know (the GUI's FLAG CORP, DRUM MAJOR, ...)
+// count as OTHER.
+static int sectionCode(const string& section) {
+    for (int i = 0; i < ANALYTICS_NUM_SECTIONS - 1; i++)
+        if (section == ANALYTICS_SECTIONS[i]) return i;
+    return ANALYTICS_NUM_SECTIONS - 1;
+}
+
+bool ComplianceRepo::snapshot(ComplianceSnapshot& snap) {
+    const char* sql =
+        "SELECT s.SECTION, COALESCE(s.CLASSIFICATION,''), COALESCE(c.GPA,0.0), COALESCE(c.CREDIT_HOURS,0) "
+        "FROM STUDENTS s "
+        "LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+
+    snap = ComplianceSnapshot();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int hrs = sqlite3_column_int(stmt, 3);
+        snap.cell.push_back((uint8_t)(sectionCode(colText(stmt, 0)) * ANALYTICS_NUM_CLASSES + classCode(colText(stmt, 1))));
+        snap.gpa.push_back((float)sqlite3_column_double(stmt, 2));
+        snap.hours.push_back((uint8_t)min(max(hrs, 0), HOUR_BINS - 1));
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+void buildSyntheticSnapshot(ComplianceSnapshot& snap, size_t n) {
+    snap.gpa.resize(n);
+    snap.hours.resize(n);
+    snap.cell.resize(n);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;     // xorshift64
+        snap.gpa[i] = 1.5f + (float)(x % 2501) / 1000.0f;
+        snap.hours[i] = (uint8_t)(6 + (x >> 16) % 13);
+        snap.cell[i] = (uint8_t)((x >> 32) % ANALYTICS_NUM_CELLS);
+    }
+}
+
+// Means, percentiles and at-risk counts are all read off the histograms
+// afterwards, so the per-student work is one bin computation and two
+// increments.
+void computeDistributions(const ComplianceSnapshot& snap, DistributionStats& st) {
+    st.gpaHist.assign((size_t)ANALYTICS_NUM_CELLS * GPA_BINS, 0);
+    st.hourHist.assign((size_t)ANALYTICS_NUM_CELLS * HOUR_BINS, 0);
+    st.gpaSum.assign(ANALYTICS_NUM_CELLS, 0.0);
+
+    const size_t n = snap.gpa.size();
+    const float* gpa = snap.gpa.data();
+    const uint8_t* hours = snap.hours.data();
+    const uint8_t* cell = snap.cell.data();
+
+    // Hour bins and per-cell sums are few enough that consecutive students
+    // often hit the same counter; spreading them over LANES copies breaks the
+    // store-to-load dependency between neighbouring increments.
+    const int LANES = 4;
+    vector<uint32_t> hourLanes((size_t)LANES * ANALYTICS_NUM_CELLS * HOUR_BINS, 0);
+    vector<double> sumLanes((size_t)LANES * ANALYTICS_NUM_CELLS, 0.0);
+
+    // Blocks keep the bin indices in L1. The index loop is branch-free float
+    // math the compiler turns into SIMD; the scatter loop that follows is the
+    // only per-student memory traffic besides reading the columns.
+    const size_t BLOCK = 1024;
+    uint32_t gpaIdx[BLOCK];
+    uint32_t hourIdx[BLOCK];
+    for (size_t base = 0; base < n; base += BLOCK) {
+        size_t len = min(BLOCK, n - base);
+        for (size_t i = 0; i < len; i++) {
+            float g = gpa[base + i] * 100.0f + 0.5f;
+            g = g < 0.0f ? 0.0f : (g > 400.0f ? 400.0f : g);
+            gpaIdx[i] = (uint32_t)cell[base + i] * GPA_BINS + (uint32_t)g;
+            hourIdx[i] = (uint32_t)cell[base + i] * HOUR_BINS + hours[base + i];
+        }
+        for (size_t i = 0; i < len; i++) {
+            size_t lane = i % LANES;
+            st.gpaHist[gpaIdx[i]]++;
+            hourLanes[lane * ANALYTICS_NUM_CELLS * HOUR_BINS + hourIdx[i]]++;
+            sumLanes[lane * ANALYTICS_NUM_CELLS + cell[base + i]] += gpa[base + i];
+        }
+    }
+
+    for (int lane = 0; lane < LANES; lane++) {
+        for (size_t i = 0; i < st.hourHist.size(); i++)
+            st.hourHist[i] += hourLanes[(size_t)lane * ANALYTICS_NUM_CELLS * HOUR_BINS + i];
+        for (int c = 0; c < ANALYTICS_NUM_CELLS; c++)
+            st.gpaSum[c] += sumLanes[(size_t)lane * ANALYTICS_NUM_CELLS + c];
+    }
+}
+
+void GroupSummary::addCell(const DistributionStats& st, int cellIdx) {
+    const uint32_t* gh = &st.gpaHist[(size_t)cellIdx * GPA_BINS];
+    const uint32_t* hh = &st.hourHist[(size_t)cellIdx * HOUR_BINS];
+    for (int b = 0; b < GPA_BINS; b++) gpaHist[b] += gh[b];
+    for (int h = 0; h < HOUR_BINS; h++) {
+        count += hh[h];
+        hourSum += (uint64_t)h * hh[h];
+    }
+    gpaSum += st.gpaSum[cellIdx];
+}
+
+double GroupSummary::percentile(double p) const {
+    uint64_t target = (uint64_t)(p * (double)(count - 1));
+    uint64_t seen = 0;
+    for (int b = 0; b < GPA_BINS; b++) {
+        seen += gpaHist[b];
+        if (seen > target) return b / 100.0;
+    }
+    return 4.0;
+}
+
+uint64_t GroupSummary::countBetween(int fromBin, int toBin) const {
+    uint64_t c = 0;
+    for (int b = max(fromBin, 0); b <= min(toBin, GPA_BINS - 1); b++) c += gpaHist[b];
+    return c;
+}
+
+// ---------- Registrar import ----------
+// Registrar extract: one student per line, STUDENT_ID,CREDIT_HOURS,GPA
+// (comma or tab separated, optional header line). The file is split into
+// chunks at line boundaries and parsed on several threads; the rows are then
+// written through one prepared upsert, committed in batches by the commit
+// policy. The extract is all numbers, so no quoted field can hide a newline
+// at a split.
+struct ComplianceRow {
+    int studentId;
+    int hours;
+    double gpa;
+};
+
+struct ComplianceChunk {
+    vector<ComplianceRow> rows;
+    vector<ParseError> errors;      // chunk-relative lines until merged
+    size_t lines = 0;
+};
+
+static void parseComplianceChunk(char* begin, char* end, char delim, bool skipHeader,
+                                 ComplianceChunk& chunk) {
+    DelimitedReader reader(begin, end, delim);
+    while (reader.next()) {
+        if (reader.blank()) continue;
+
+        const vector<string_view>& f = reader.fields;
+        string_view idField = f[0];
+        string_view hoursField = f.size() > 1 ? f[1] : string_view();
+        string_view gpaField = f.size() > 2 ? f[2] : string_view();
+
+        ComplianceRow row;
+        if (!parseNumber(idField, row.studentId)) {
+            if (skipHeader && reader.line == 1) continue;
+            chunk.errors.push_back({reader.line, "bad STUDENT_ID '" + string(idField) + "'"});
+            continue;
+        }
+        if (!parseNumber(hoursField, row.hours) || row.hours < 0 || row.hours > 30) {
+            chunk.errors.push_back({reader.line, "bad CREDIT_HOURS '" + string(hoursField) + "' (0-30)"});
+            continue;
+        }
+        if (!parseNumber(gpaField, row.gpa) || !(row.gpa >= 0.0 && row.gpa <= 4.0)) {
+            chunk.errors.push_back({reader.line, "bad GPA '" + string(gpaField) + "' (0.00-4.00)"});
+            continue;
+        }
+        chunk.rows.push_back(row);
+    }
+    chunk.lines = reader.line;
+}
+
+bool ComplianceRepo::importFile(const string& path, unsigned threads, ImportResult& result) {
+    result = ImportResult();
+    MappedFile file;
+    if (!file.open(path)) return db.fail("Can't read " + path);
+    char delim = detectDelimiter(file.data, file.size);
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    if (file.size < (1u << 20)) threads = 1;   // not worth the thread start-up
+    result.threads = threads;
+
+    // Chunk boundaries land just after a newline so no line is split. A few
+    // chunks per worker let an idle worker steal from a slow one.
+    const unsigned chunkCount = threads == 1 ? 1 : threads * 4;
+    char* base = file.data;
+    char* end = base + file.size;
+    vector<char*> bounds(chunkCount + 1, end);
+    bounds[0] = base;
+    for (unsigned i = 1; i < chunkCount; i++) {
+        char* p = base + file.size / chunkCount * i;
+        if (p < bounds[i - 1]) p = bounds[i - 1];
+        char* nl = (char*)memchr(p, '\n', (size_t)(end - p));
+        bounds[i] = nl ? nl + 1 : end;
+    }
+
+    auto parseStart = chrono::steady_clock::now();
+    vector<ComplianceChunk> chunks(chunkCount);
+    if (threads == 1) {
+        parseComplianceChunk(bounds[0], bounds[1], delim, true, chunks[0]);
+    } else {
+        TaskPool pool(string(), threads);
+        for (unsigned i = 0; i < chunkCount; i++) {
+            pool.submit([&, i](TaskPool::Context&) {
+                parseComplianceChunk(bounds[i], bounds[i + 1], delim, i == 0, chunks[i]);
+            });
+        }
+        pool.wait();
+    }
+    result.parseSec = chrono::duration<double>(chrono::steady_clock::now() - parseStart).count();
+
+    size_t totalRows = 0, lineBase = 0;
+    for (const ComplianceChunk& c : chunks) totalRows += c.rows.size();
+    result.parsed = totalRows;
+
+    vector<ComplianceRow> rows;
+    rows.reserve(totalRows);
+    for (ComplianceChunk& c : chunks) {
+        rows.insert(rows.end(), c.rows.begin(), c.rows.end());
+        vector<ComplianceRow>().swap(c.rows);
+        for (ParseError& e : c.errors) {
+            e.line += lineBase;
+            result.errors.push_back(move(e));
+        }
+        lineBase += c.lines;
+    }
+
+    // Writing in key order keeps the B-tree inserts local; for repeated IDs the
+    // last line in the file wins, as it would with row-at-a-time upserts.
+    stable_sort(rows.begin(), rows.end(),
+                [](const ComplianceRow& a, const ComplianceRow& b) { return a.studentId < b.studentId; });
+    size_t kept = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i + 1 < rows.size() && rows[i + 1].studentId == rows[i].studentId) continue;
+        rows[kept++] = rows[i];
+    }
+    result.duplicates = rows.size() - kept;
+    rows.resize(kept);
+
+    vector<int> known;
+    if (!loadStudentIds(db, known)) return false;
+
+    string sql =
+        "INSERT INTO COMPLIANCE (STUDENT_ID, CREDIT_HOURS, GPA, LAST_VERIFIED_DATE) "
+        "VALUES (?, ?, ?, " + string(db.today()) + ") "
+        "ON CONFLICT(STUDENT_ID) DO UPDATE SET "
+        "CREDIT_HOURS=excluded.CREDIT_HOURS, "
+        "GPA=excluded.GPA, "
+        "LAST_VERIFIED_DATE=excluded.LAST_VERIFIED_DATE;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+
+    auto writeStart = chrono::steady_clock::now();
+    BatchCommitter batches(db);
+    if (!batches.begin()) {
+        sqlite3_finalize(stmt);
+        return false;
+    }
+
+    bool ok = true;
+    auto k = known.begin();
+    for (const ComplianceRow& r : rows) {
+        k = lower_bound(k, known.end(), r.studentId);
+        if (k == known.end() || *k != r.studentId) {
+            result.unknownIds.push_back(r.studentId);
+            continue;
+        }
+        sqlite3_bind_int(stmt, 1, r.studentId);
+        sqlite3_bind_int(stmt, 2, r.hours);
+        sqlite3_bind_double(stmt, 3, r.gpa);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            db.failSQL("Import failed at student " + to_string(r.studentId));
+            sqlite3_reset(stmt);
+            batches.abort();
+            ok = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+        result.added++;
+        if (!batches.wrote()) {
+            ok = false;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    ok = ok && batches.finish();
+    batches.report(result);
+    if (!ok) {
+        result.added = batches.committed;
+        return false;
+    }
+    result.writeSec = chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+    return true;
+}
+
+// ---------- Compact roster ----------
+static void put24(uint8_t* out, uint32_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+}
+
+static uint32_t get24(const uint8_t* in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16;
+}
+
+// Case-insensitive order; a shorter string sorts before one it is a prefix of.
+static int compareNoCase(string_view a, string_view b) {
+    size_t n = min(a.size(), b.size());
+    for (size_t i = 0; i < n; i++) {
+        int x = toupper((unsigned char)a[i]), y = toupper((unsigned char)b[i]);
+        if (x != y) return x < y ? -1 : 1;
+    }
+    return a.size() == b.size() ? 0 : a.size() < b.size() ? -1 : 1;
+}
+
+// Hands out codes in first-seen order while the rows are read; sorted() then
+// lays the strings out in case-insensitive order and says where each code went.
+struct DictionaryBuilder {
+    unordered_map<string, uint32_t> codes;
+    vector<const string*> byCode;
+
+    uint32_t code(const char* s) {
+        auto it = codes.emplace(s, (uint32_t)byCode.size());
+        if (it.second) byCode.push_back(&it.first->first);
+        return it.first->second;
+    }
+
+    template<class Dictionary>
+    vector<uint32_t> sorted(Dictionary& out) const {
+        vector<uint32_t> order(byCode.size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            int c = compareNoCase(*byCode[a], *byCode[b]);
+            return c ? c < 0 : *byCode[a] < *byCode[b];
+        });
+        vector<uint32_t> remap(order.size());
+        out.text.clear();
+        out.offsets.assign(1, 0);
+        for (uint32_t pos = 0; pos < order.size(); pos++) {
+            remap[order[pos]] = pos;
+            out.text += *byCode[order[pos]];
+            out.offsets.push_back((uint32_t)out.text.size());
+        }
+        out.text.shrink_to_fit();
+        out.offsets.shrink_to_fit();
+        return remap;
+    }
+};
+
+bool CompactRoster::load(Database& db) {
+    const char* sql =
+        "SELECT s.STUDENT_ID, s.FNAME, s.LNAME, COALESCE(s.CLASSIFICATION,''), s.SECTION, "
+        "       COALESCE(s.PRIMARY_ROLE,''), COALESCE(s.ACTIVE,1), "
+        "       COALESCE(c.CREDIT_HOURS,0), COALESCE(c.GPA,0.0), COALESCE(c.DUES_PAID,0) "
+        "FROM STUDENTS s "
+        "LEFT JOIN COMPLIANCE c ON c.STUDENT_ID=s.STUDENT_ID "
+        "ORDER BY s.STUDENT_ID;";
+
+    version = db.dataVersion();
+    changes = db.totalChanges();
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql, -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+
+    // "" is code 0 of the classification and role dictionaries.
+    DictionaryBuilder first, last, classes, sectionNames, roleNames;
+    classes.code("");
+    roleNames.code("");
+    vector<PackedStudent> rows;
+    string problem;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        sqlite3_int64 id = sqlite3_column_int64(stmt, 0);
+        if (id < 0 || id > (sqlite3_int64)UINT32_MAX) {
+            problem = "student " + to_string(id) + ": ID out of range for the compact roster";
+            break;
+        }
+        PackedStudent r;
+        r.id = (uint32_t)id;
+        uint32_t f = first.code(colText(stmt, 1));
+        uint32_t l = last.code(colText(stmt, 2));
+        uint32_t k = classes.code(colText(stmt, 3));
+        uint32_t section = sectionNames.code(colText(stmt, 4));
+        uint32_t role = roleNames.code(colText(stmt, 5));
+        if (f >= (1u << 24) || l >= (1u << 24)) {
+            problem = "more than 16777216 distinct first or last names";
+            break;
+        }
+        if (k > UINT8_MAX || role > UINT8_MAX) {
+            problem = "more than 255 distinct classifications or roles";
+            break;
+        }
+        if (section > SECTION_MASK) {
+            problem = "more than 32 distinct sections";
+            break;
+        }
+        put24(r.first, f);
+        put24(r.last, l);
+        r.classification = (uint8_t)k;
+        r.role = (uint8_t)role;
+
+        Compliance c;
+        c.creditHours = sqlite3_column_int(stmt, 7);
+        c.gpa = sqlite3_column_double(stmt, 8);
+        c.duesPaid = sqlite3_column_int(stmt, 9) == 1;
+        r.flags = (uint8_t)section;
+        if (sqlite3_column_int(stmt, 6) != 0) r.flags |= ACTIVE;
+        if (c.duesPaid) r.flags |= DUES_PAID;
+        if (c.eligible()) r.flags |= ELIGIBLE;
+        r.creditHours = (uint8_t)min(max(c.creditHours, 0), 255);
+        r.gpa = (uint16_t)min((int)(max(c.gpa, 0.0) * 100.0 + 0.5), 65535);
+        rows.push_back(r);
+    }
+    sqlite3_finalize(stmt);
+    if (!problem.empty()) return db.fail(problem);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) return db.failSQL("Roster load failed");
+
+    vector<uint32_t> firstAt = first.sorted(firstNames);
+    vector<uint32_t> lastAt = last.sorted(lastNames);
+    vector<uint32_t> classAt = classes.sorted(classifications);
+    vector<uint32_t> sectionAt = sectionNames.sorted(sections);
+    vector<uint32_t> roleAt = roleNames.sorted(roles);
+    for (PackedStudent& r : rows) {
+        put24(r.first, firstAt[get24(r.first)]);
+        put24(r.last, lastAt[get24(r.last)]);
+        r.classification = (uint8_t)classAt[r.classification];
+        r.flags = (uint8_t)((r.flags & ~SECTION_MASK) | sectionAt[r.flags & SECTION_MASK]);
+        r.role = (uint8_t)roleAt[r.role];
+    }
+    rows.shrink_to_fit();
+    records = move(rows);
+    return true;
+}
+
+bool CompactRoster::stale(Database& db) const {
+    return db.dataVersion() != version || db.totalChanges() != changes;
+}
+
+size_t CompactRoster::bytes() const {
+    return records.capacity() * sizeof(PackedStudent) + firstNames.bytes() + lastNames.bytes() +
+           classifications.bytes() + sections.bytes() + roles.bytes();
+}
+
+const PackedStudent* CompactRoster::find(int studentId) const {
+    if (studentId < 0) return nullptr;
+    auto it = lower_bound(records.begin(), records.end(), (uint32_t)studentId,
+                          [](const PackedStudent& r, uint32_t id) { return r.id < id; });
+    return it != records.end() && it->id == (uint32_t)studentId ? &*it : nullptr;
+}
+
+StudentProfile CompactRoster::profile(const PackedStudent& r) const {
+    StudentProfile p;
+    p.student.id = (int)r.id;
+    p.student.fname = string(firstNames.at(get24(r.first)));
+    p.student.lname = string(lastNames.at(get24(r.last)));
+    p.student.classification = string(classifications.at(r.classification));
+    p.student.section = string(sections.at(r.flags & SECTION_MASK));
+    p.student.role = string(roles.at(r.role));
+    p.student.active = (r.flags & ACTIVE) != 0;
+    p.compliance.creditHours = r.creditHours;
+    p.compliance.gpa = r.gpa / 100.0;
+    p.compliance.duesPaid = (r.flags & DUES_PAID) != 0;
+    return p;
+}
+
+// The dictionary is in case-insensitive order, so the names starting with
+// `prefix` are one run of codes; then one pass over the records.
+void CompactRoster::matchLastName(const string& prefix, vector<const PackedStudent*>& out) const {
+    out.clear();
+    auto head = [&](uint32_t code) { return compareNoCase(lastNames.at(code).substr(0, prefix.size()), prefix); };
+    uint32_t lo = 0, hi = (uint32_t)lastNames.size();
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (head(mid) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    uint32_t from = lo;
+    hi = (uint32_t)lastNames.size();
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (head(mid) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+    uint32_t to = lo;
+    if (from == to) return;
+    for (const PackedStudent& r : records) {
+        uint32_t code = get24(r.last);
+        if (code >= from && code < to) out.push_back(&r);
+    }
+}
+
+// ---------- Change feed ----------
+bool ChangeFeed::version(sqlite3_int64& epoch, sqlite3_int64& version) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(),
+                           "SELECT (SELECT EPOCH FROM CHANGE_EPOCH), "
+                           "       (SELECT seq FROM sqlite_sequence WHERE name='CHANGE_LOG');",
+                           -1, &stmt, nullptr) != SQLITE_OK)
+        return db.failSQL();
+    epoch = version = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        epoch = sqlite3_column_int64(stmt, 0);
+        version = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// Logged rows that are gone from the table now. A row deleted and added back
+// since counts as changed, not removed.
+static bool loadRemoved(Database& db, const LoggedTable& t, sqlite3_int64 since, vector<int>& out) {
+    string sql = string("SELECT DISTINCT l.ROW_ID FROM CHANGE_LOG l "
+                        "WHERE l.VERSION > ? AND l.TBL='") + t.table + "' "
+                 "AND NOT EXISTS (SELECT 1 FROM " + t.table + " WHERE " + t.key + "=l.ROW_ID) "
+                 "ORDER BY l.ROW_ID;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return db.failSQL();
+    sqlite3_bind_int64(stmt, 1, since);
+
+    out.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) out.push_back(sqlite3_column_int(stmt, 0));
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+// VERSION is the rowid, so "VERSION > ?" reads only the tail of the log and
+// each changed row is then a primary-key lookup.
+bool ChangeFeed::since(sqlite3_int64 epoch, sqlite3_int64 since, ChangeSet& out) {
+    out = ChangeSet();
+    if (!version(out.epoch, out.version)) return false;
+    if (epoch != out.epoch || since > out.version) {    // a different (recreated) database
+        out.reload = true;
+        return true;
+    }
+    if (since == out.version) return true;
+
+    // Entries after `since` must all still be there.
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db.handle(), "SELECT MIN(VERSION) FROM CHANGE_LOG;", -1, &stmt, nullptr) != SQLITE_OK)
+        return db.failSQL();
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+        out.reload = since < sqlite3_column_int64(stmt, 0) - 1;
+    sqlite3_finalize(stmt);
+    if (out.reload) return true;
+
+    return loadStudentProfiles(db,
+               "WHERE s.STUDENT_ID IN (SELECT ROW_ID FROM CHANGE_LOG "
+               "  WHERE VERSION > ? AND TBL IN ('STUDENTS','COMPLIANCE')) "
+               "ORDER BY s.STUDENT_ID;", out.students, since) &&
+           loadRemoved(db, LOGGED_TABLES[0], since, out.removedStudents) &&
+           loadInstruments(db,
+               "WHERE INSTRUMENT_ID IN (SELECT ROW_ID FROM CHANGE_LOG WHERE VERSION > ? AND TBL='INSTRUMENTS') "
+               "ORDER BY INSTRUMENT_ID;", out.instruments, since) &&
+           loadRemoved(db, LOGGED_TABLES[2], since, out.removedInstruments) &&
+           loadUniforms(db,
+               "WHERE UNIFORM_ID IN (SELECT ROW_ID FROM CHANGE_LOG WHERE VERSION > ? AND TBL='UNIFORMS') "
+               "ORDER BY UNIFORM_ID;", out.uniforms, since) &&
+           loadRemoved(db, LOGGED_TABLES[3], since, out.removedUniforms) &&
+           loadShakos(db,
+               "WHERE SHAKO_ID IN (SELECT ROW_ID FROM CHANGE_LOG WHERE VERSION > ? AND TBL='SHAKOS') "
+               "ORDER BY SHAKO_ID;", out.shakos, since) &&
+           loadRemoved(db, LOGGED_TABLES[4], since, out.removedShakos);
+}
+
+// ---------- Task pool ----------
+// The worker running the current thread, for submits from inside a task.
+static thread_local const TaskPool* currentPool = nullptr;
+static thread_local unsigned currentWorker = 0;
+
+static double msSince(chrono::steady_clock::time_point t) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
+
+sqlite3* TaskPool::Context::connection() {
+    if (!conn && openError.empty()) {
+        if (!path || path->empty()) openError = "Task pool has no database";
+        else if (openConnection(*path, SQLITE_OPEN_READONLY, conn, &openError)) sqlite3_busy_timeout(conn, 5000);
+    }
+    return conn;
+}
+
+TaskPool::TaskPool(const string& dbPath, unsigned count) : path(dbPath) {
+    if (count == 0) count = max(1u, thread::hardware_concurrency());
+    for (unsigned i = 0; i < count; i++) {
+        workers.push_back(make_unique<Worker>());
+        workers[i]->context.path = &path;
+        workers[i]->context.index = i;
+    }
+    for (unsigned i = 0; i < count; i++) workers[i]->thread = thread(&TaskPool::run, this, i);
+}
+
+TaskPool::~TaskPool() {
+    wait();
+    {
+        lock_guard<mutex> g(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w->thread.join();
+}
+
+void TaskPool::submit(Task task) {
+    unsigned index = currentPool == this ? currentWorker : nextWorker++ % size();
+    // Counted before it is pushed: once on a deque it can be stolen and
+    // finished at once, and wait() must not see zero while the submitter runs.
+    {
+        lock_guard<mutex> g(sleepLock);
+        queued++;
+        unfinished++;
+    }
+    {
+        lock_guard<mutex> g(workers[index]->lock);
+        workers[index]->tasks.push_back({move(task), chrono::steady_clock::now()});
+    }
+    wake.notify_one();
+}
+
+void TaskPool::wait() {
+    unique_lock<mutex> g(sleepLock);
+    idle.wait(g, [&] { return unfinished == 0; });
+}
+
+// Own deque newest-first, then the others oldest-first.
+bool TaskPool::take(unsigned index, Item& item, bool& stolen) {
+    for (unsigned k = 0; k < size(); k++) {
+        Worker& w = *workers[(index + k) % size()];
+        lock_guard<mutex> g(w.lock);
+        if (w.tasks.empty()) continue;
+        if (k == 0) {
+            item = move(w.tasks.back());
+            w.tasks.pop_back();
+        } else {
+            item = move(w.tasks.front());
+            w.tasks.pop_front();
+        }
+        stolen = k != 0;
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::run(unsigned index) {
+    currentPool = this;
+    currentWorker = index;
+    Worker& self = *workers[index];
+
+    while (true) {
+        Item item;
+        bool stolen = false;
+        if (!take(index, item, stolen)) {
+            auto t0 = chrono::steady_clock::now();
+            unique_lock<mutex> g(sleepLock);
+            wake.wait(g, [&] { return stopping || queued > 0; });
+            bool done = stopping && queued == 0;
+            g.unlock();
+            lock_guard<mutex> s(self.lock);
+            self.idleMs += msSince(t0);
+            if (done) break;
+            continue;
+        }
+        {
+            lock_guard<mutex> g(sleepLock);
+            queued--;
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        item.task(self.context);
+        {
+            lock_guard<mutex> g(self.lock);
+            self.ran++;
+            self.stolen += stolen;
+            self.busyMs += msSince(t0);
+            self.latencyMs.push_back(msSince(item.queued));
+        }
+        lock_guard<mutex> g(sleepLock);
+        if (--unfinished == 0) idle.notify_all();
+    }
+    sqlite3_close(self.context.conn);
+    self.context.conn = nullptr;
+}
+
+PoolMetrics TaskPool::metrics() {
+    PoolMetrics m;
+    m.workers = size();
+    vector<double> latency;
+    for (auto& w : workers) {
+        lock_guard<mutex> g(w->lock);
+        m.tasks += w->ran;
+        m.steals += w->stolen;
+        m.busyMs += w->busyMs;
+        m.idleMs += w->idleMs;
+        latency.insert(latency.end(), w->latencyMs.begin(), w->latencyMs.end());
+    }
+    if (!latency.empty()) {
+        sort(latency.begin(), latency.end());
+        m.latencyP50Ms = latency[latency.size() / 2];
+        m.latencyP95Ms = latency[min(latency.size() - 1, latency.size() * 95 / 100)];
+        m.latencyMaxMs = latency.back();
+    }
+    return m;
+}
+
+// ---------- Integrity check ----------
+// Every query returns the offending rows; an empty result is a pass. Slowest
+// first, so the page walk starts while the small checks fill the other threads.
+struct IntegrityQuery {
+    const char* name;
+    const char* description;
+    const char* sql;
+};
+
+static const IntegrityQuery INTEGRITY_CHECKS[] = {
+    {"quick_check", "b-tree and record structure (PRAGMA quick_check)",
+     "SELECT quick_check AS PROBLEM FROM pragma_quick_check WHERE quick_check <> 'ok';"},
+    {"foreign_keys", "references to missing rows (PRAGMA foreign_key_check)",
+     "SELECT \"table\" AS TBL, rowid AS ROW_ID, parent AS PARENT FROM pragma_foreign_key_check;"},
+    {"leader_section", "section leaders who are not in the section they lead",
+     "SELECT l.SECTION, l.LEADER_STUDENT_ID, s.SECTION AS STUDENT_SECTION "
+     "FROM SECTION_LEADERS l JOIN STUDENTS s ON s.STUDENT_ID=l.LEADER_STUDENT_ID "
+     "WHERE s.SECTION <> l.SECTION;"},
+    {"inactive_holders", "inactive students still holding gear or leading a section",
+     "SELECT 'INSTRUMENTS' AS TBL, i.INSTRUMENT_ID AS ROW_ID, s.STUDENT_ID FROM INSTRUMENTS i "
+     "  JOIN STUDENTS s ON s.STUDENT_ID=i.CHECKED_OUT_TO WHERE s.ACTIVE=0 "
+     "UNION ALL SELECT 'UNIFORMS', u.UNIFORM_ID, s.STUDENT_ID FROM UNIFORMS u "
+     "  JOIN STUDENTS s ON s.STUDENT_ID=u.CHECKED_OUT_TO WHERE s.ACTIVE=0 "
+     "UNION ALL SELECT 'SHAKOS', h.SHAKO_ID, s.STUDENT_ID FROM SHAKOS h "
+     "  JOIN STUDENTS s ON s.STUDENT_ID=h.CHECKED_OUT_TO WHERE s.ACTIVE=0 "
+     "UNION ALL SELECT 'SECTION_LEADERS', l.SECTION, s.STUDENT_ID FROM SECTION_LEADERS l "
+     "  JOIN STUDENTS s ON s.STUDENT_ID=l.LEADER_STUDENT_ID WHERE s.ACTIVE=0;"},
+    {"one_item_per_kind", "students holding more than one instrument, uniform or shako",
+     "SELECT 'INSTRUMENTS' AS TBL, CHECKED_OUT_TO AS STUDENT_ID, COUNT(*) AS ITEMS FROM INSTRUMENTS "
+     "  WHERE CHECKED_OUT_TO IS NOT NULL GROUP BY CHECKED_OUT_TO HAVING COUNT(*) > 1 "
+     "UNION ALL SELECT 'UNIFORMS', CHECKED_OUT_TO, COUNT(*) FROM UNIFORMS "
+     "  WHERE CHECKED_OUT_TO IS NOT NULL GROUP BY CHECKED_OUT_TO HAVING COUNT(*) > 1 "
+     "UNION ALL SELECT 'SHAKOS', CHECKED_OUT_TO, COUNT(*) FROM SHAKOS "
+     "  WHERE CHECKED_OUT_TO IS NOT NULL GROUP BY CHECKED_OUT_TO HAVING COUNT(*) > 1;"},
+    {"checkout_columns", "items with a holder but no checkout date, or the reverse",
+     "SELECT 'INSTRUMENTS' AS TBL, INSTRUMENT_ID AS ROW_ID, CHECKED_OUT_TO, CHECKED_OUT_DATE FROM INSTRUMENTS "
+     "  WHERE (CHECKED_OUT_TO IS NULL) <> (CHECKED_OUT_DATE IS NULL) "
+     "UNION ALL SELECT 'UNIFORMS', UNIFORM_ID, CHECKED_OUT_TO, CHECKED_OUT_DATE FROM UNIFORMS "
+     "  WHERE (CHECKED_OUT_TO IS NULL) <> (CHECKED_OUT_DATE IS NULL) "
+     "UNION ALL SELECT 'SHAKOS', SHAKO_ID, CHECKED_OUT_TO, CHECKED_OUT_DATE FROM SHAKOS "
+     "  WHERE (CHECKED_OUT_TO IS NULL) <> (CHECKED_OUT_DATE IS NULL);"},
+    {"uniform_sizes", "uniforms with neither a coat nor a pant size (pre-migration rows)",
+     "SELECT UNIFORM_ID, CHECKED_OUT_TO FROM UNIFORMS "
+     "WHERE COALESCE(COAT_SIZE,'')='' AND COALESCE(PANT_SIZE,'')='';"},
+    {"dates", "dates not stored in the schema's encoding (see DateEncoding) or in the future",
+     "WITH E(T) AS (SELECT lower(type) FROM pragma_table_info('INSTRUMENTS') WHERE name='CHECKED_OUT_DATE') "
+     "SELECT 'INSTRUMENTS' AS TBL, INSTRUMENT_ID AS ROW_ID, CHECKED_OUT_DATE AS VALUE FROM INSTRUMENTS, E "
+     "  WHERE CHECKED_OUT_DATE IS NOT NULL AND (typeof(CHECKED_OUT_DATE) <> E.T "
+     "    OR (E.T = 'text' AND date(CHECKED_OUT_DATE) IS NOT CHECKED_OUT_DATE) "
+     "    OR coalesce(date(CHECKED_OUT_DATE) > date('now','+1 day'), 1)) "
+     "UNION ALL SELECT 'UNIFORMS', UNIFORM_ID, CHECKED_OUT_DATE FROM UNIFORMS, E "
+     "  WHERE CHECKED_OUT_DATE IS NOT NULL AND (typeof(CHECKED_OUT_DATE) <> E.T "
+     "    OR (E.T = 'text' AND date(CHECKED_OUT_DATE) IS NOT CHECKED_OUT_DATE) "
+     "    OR coalesce(date(CHECKED_OUT_DATE) > date('now','+1 day'), 1)) "
+     "UNION ALL SELECT 'SHAKOS', SHAKO_ID, CHECKED_OUT_DATE FROM SHAKOS, E "
+     "  WHERE CHECKED_OUT_DATE IS NOT NULL AND (typeof(CHECKED_OUT_DATE) <> E.T "
+     "    OR (E.T = 'text' AND date(CHECKED_OUT_DATE) IS NOT CHECKED_OUT_DATE) "
+     "    OR coalesce(date(CHECKED_OUT_DATE) > date('now','+1 day'), 1)) "
+     "UNION ALL SELECT 'COMPLIANCE', STUDENT_ID, LAST_VERIFIED_DATE FROM COMPLIANCE, E "
+     "  WHERE LAST_VERIFIED_DATE IS NOT NULL AND (typeof(LAST_VERIFIED_DATE) <> E.T "
+     "    OR (E.T = 'text' AND date(LAST_VERIFIED_DATE) IS NOT LAST_VERIFIED_DATE) "
+     "    OR coalesce(date(LAST_VERIFIED_DATE) > date('now','+1 day'), 1)) "
+     "UNION ALL SELECT 'ELIGIBILITY_EVENTS', EVENT_ID, CHANGED_AT FROM ELIGIBILITY_EVENTS "
+     "  WHERE datetime(CHANGED_AT) IS NOT CHANGED_AT OR CHANGED_AT > datetime('now','+1 day');"},
+    {"compliance_rows", "students without a COMPLIANCE row",
+     "SELECT s.STUDENT_ID FROM STUDENTS s "
+     "WHERE NOT EXISTS (SELECT 1 FROM COMPLIANCE c WHERE c.STUDENT_ID=s.STUDENT_ID);"},
+    {"compliance_values", "GPA outside 0.00-4.00",
+     "SELECT STUDENT_ID, GPA FROM COMPLIANCE WHERE GPA < 0.0 OR GPA > 4.0;"},
+};
+
+size_t IntegrityReport::violations() const {
+    size_t n = 0;
+    for (const CheckResult& c : checks) n += c.violations;
+    return n;
+}
+
+bool IntegrityReport::clean() const {
+    for (const CheckResult& c : checks) {
+        if (c.violations || !c.error.empty()) return false;
+    }
+    return true;
+}
+
+// "COLUMN=value, ..." for a sample row.
+static string describeRow(sqlite3_stmt* stmt) {
+    string out;
+    for (int c = 0; c < sqlite3_column_count(stmt); c++) {
+        if (c) out += ", ";
+        out += sqlite3_column_name(stmt, c);
+        out += '=';
+        out += sqlite3_column_type(stmt, c) == SQLITE_NULL ? "NULL" : colText(stmt, c);
+    }
+    return out;
+}
+
+static void runIntegrityQuery(sqlite3* conn, const IntegrityQuery& q, CheckResult& r) {
+    auto t0 = chrono::steady_clock::now();
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, q.sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        r.error = sqlite3_errmsg(conn);
+        return;
+    }
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (r.samples.size() < IntegrityChecker::SAMPLE_ROWS) r.samples.push_back(describeRow(stmt));
+        r.violations++;
+    }
+    if (rc != SQLITE_DONE) r.error = sqlite3_errmsg(conn);
+    sqlite3_finalize(stmt);
+    r.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+bool IntegrityChecker::run(unsigned threads, IntegrityReport& out) {
+    if (!db.handle()) return db.fail("Database is not open");
+    db.flushCommitBatch();      // the readers only see committed rows
+
+    const size_t n = size(INTEGRITY_CHECKS);
+    out = IntegrityReport();
+    out.checks.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        out.checks[i].name = INTEGRITY_CHECKS[i].name;
+        out.checks[i].description = INTEGRITY_CHECKS[i].description;
+    }
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    out.threads = (unsigned)min<size_t>(threads, n);
+
+    // One task per check, queued slowest first; each result slot has a single
+    // writer.
+    auto t0 = chrono::steady_clock::now();
+    TaskPool pool(db.path(), out.threads);
+    for (size_t i = 0; i < n; i++) {
+        pool.submit([&out, i](TaskPool::Context& ctx) {
+            if (sqlite3* conn = ctx.connection()) runIntegrityQuery(conn, INTEGRITY_CHECKS[i], out.checks[i]);
+            else out.checks[i].error = ctx.error();
+        });
+    }
+    pool.wait();
+    out.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    out.pool = pool.metrics();
+    return true;
+}
+
+} // namespace banddb
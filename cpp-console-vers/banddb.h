@@ -0,0 +1,963 @@
+// libbanddb - the marching band database engine.
+//
+// Everything that touches band.db lives here: schema, durability and
+// checkpointing, the instrument type catalog, the per-table repositories, the
+// bulk importers and the compliance analytics. Calls return typed results
+// and never print; on failure they return false (or Outcome::Failed) and
+// Database::lastError() says why. band.cpp is the console front-end.
+//
+// One Database per connection and per thread. The repositories are thin
+// views over a Database and are cheap to construct.
+
+#ifndef BANDDB_H
+#define BANDDB_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace banddb {
+
+// ---------- Text helpers ----------
+std::string trim(const std::string& s);
+std::string upperCopy(std::string s);
+std::string_view trimView(std::string_view s);
+bool isValidSection(const std::string& s);
+
+// Whole-field number parse (surrounding blanks and a leading '+' allowed).
+template <typename T>
+bool parseNumber(std::string_view field, T& out) {
+    field = trimView(field);
+    if (field.empty()) return false;
+    const char* first = field.data();
+    const char* last = first + field.size();
+    if (*first == '+') first++;
+    auto res = std::from_chars(first, last, out);
+    return res.ec == std::errc() && res.ptr == last;
+}
+
+// ---------- Delimited files ----------
+// Shared by every import path. The file is memory-mapped copy-on-write and
+// records are handed out as string_views into the mapping, so tokenizing does
+// not allocate. Quoted fields ("a, b" and "say ""hi""") are unescaped in place;
+// only the pages that actually hold an escaped quote get copied by the kernel.
+struct MappedFile {
+    char* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+private:
+    bool mapped = false;
+    std::string fallback;   // empty files, or systems where mapping fails
+};
+
+// Reads records from [p, end). `fields` is valid until the next call to next().
+// `line` is the 1-based line the current record started on.
+struct DelimitedReader {
+    char* p;
+    char* end;
+    char delim;
+    size_t line = 0;
+    std::vector<std::string_view> fields;
+
+    DelimitedReader(char* begin, char* stop, char d) : p(begin), end(stop), delim(d) {}
+
+    bool next();
+    bool blank() const { return fields.size() == 1 && fields[0].empty(); }
+
+private:
+    size_t nextLine = 1;
+
+    std::string_view quotedField();
+};
+
+// Tab if the first line has tabs and no commas, otherwise comma.
+char detectDelimiter(const char* data, size_t size);
+
+struct ParseError {
+    size_t line;
+    std::string message;
+};
+
+struct ImportResult {
+    size_t added = 0;               // rows written
+    size_t parsed = 0;              // rows that parsed (registrar import)
+    size_t duplicates = 0;          // duplicate serials / repeated students
+    unsigned threads = 1;
+    double parseSec = 0.0;
+    double writeSec = 0.0;
+    double waitSec = 0.0;           // roster import: writer waiting on the parse/validate stages
+    size_t commits = 0;             // transactions the rows went in (see CommitPolicy)
+    size_t batchRows = 0;           // rows per commit at the end, as tuned
+    double maxBatchMs = 0.0;        // longest a batch held the write lock
+    size_t keysCleared = 0;         // STUDENT_IDs / serials the key filter ruled out without a lookup
+    size_t keysProbed = 0;          // ones it could not, checked against the table
+    size_t falsePositives = 0;      // probed keys that were not there after all
+    std::vector<ParseError> errors;
+    std::vector<int> unknownIds;    // registrar rows for students not on the roster
+};
+
+// What a student removal or merge touched.
+struct StudentCleanup {
+    size_t students = 0;            // STUDENTS rows deleted
+    size_t missing = 0;             // IDs not on the roster, skipped
+    size_t gearReleased = 0;        // instruments, uniforms and shakos checked back in
+    size_t gearReassigned = 0;      // moved to the kept student (merge)
+    size_t leadersCleared = 0;      // sections left without a leader
+    size_t leadersReassigned = 0;   // sections now led by the kept student (merge)
+    size_t complianceMerged = 0;    // kept students that took a duplicate's COMPLIANCE row
+    bool undoable = false;          // small batches go through the undo journal
+};
+
+// ---------- Durability ----------
+// Profiles trade the newest commits for write speed. All of them run in WAL
+// mode, so a crash never corrupts the file; they differ in what a power loss
+// can take away:
+//   full    - fsync on every commit, nothing is lost (registrar import)
+//   normal  - WAL synced at checkpoints only; recent commits can be lost
+//   batched - like normal, and back-to-back writes are grouped into one
+//             transaction committed at least every second (uniform room)
+//   off     - no syncs at all; scratch databases and benchmarks only
+// The lighter the profile, the larger the WAL may grow before a checkpoint
+// (1000, 2000, 4000, 8000 pages): the background checkpointer's threshold,
+// or SQLite's own wal_autocheckpoint with --checkpoint=off. Under normal and
+// batched the checkpoint is the only sync, so spacing them out is where the
+// speed comes from.
+struct DurabilityProfile {
+    const char* name;
+    const char* synchronous;
+    int walAutocheckpoint;      // pages between checkpoints; 0 disables automatic ones
+    int commitIntervalMs;       // 0 = every write commits on its own
+};
+
+extern const DurabilityProfile DURABILITY_PROFILES[4];
+
+const DurabilityProfile* findDurabilityProfile(const std::string& name);
+bool applyDurability(sqlite3* conn, const DurabilityProfile& p, std::string* error = nullptr);
+
+// ---------- Threading ----------
+// How the connections the engine opens are locked. The engine never lets two
+// threads use one connection at once (one Database per thread; the
+// checkpointer and the integrity checker open their own), so multi-thread
+// mode can drop SQLite's per-connection mutex (SQLITE_OPEN_NOMUTEX).
+// Serialized keeps it, for embedders that share a connection between threads:
+// the Python module releases the GIL around engine calls and stays serialized.
+// Every connection gets a private page cache. The mode is process-wide and
+// should be set before anything is opened; it fails on a SQLITE_THREADSAFE=0
+// build, which has no mutexes and is unsafe with the checkpointer thread.
+enum class ThreadingMode { Serialized, MultiThread };
+
+bool setThreadingMode(ThreadingMode mode);
+ThreadingMode threadingMode();
+const char* threadingModeName(ThreadingMode mode);                  // "serialized" | "multi"
+bool findThreadingMode(const std::string& name, ThreadingMode& out);
+// openFlags (SQLITE_OPEN_READONLY, or READWRITE | CREATE) plus the mutex and
+// cache flags for `mode`.
+int connectionFlags(int openFlags, ThreadingMode mode = threadingMode());
+// sqlite3_open_v2 with connectionFlags(); on failure closes the handle,
+// leaves conn null and puts the reason in *error.
+bool openConnection(const std::string& path, int openFlags, sqlite3*& conn, std::string* error = nullptr);
+
+// ---------- Commit policy ----------
+// How the bulk writers (the file imports) split their rows into transactions:
+// a commit every `rows` rows or every `intervalMs`, whichever comes first.
+// One giant transaction holds the write lock for the whole run, readers see
+// none of it until the end, and the WAL grows since nothing past an open
+// transaction can be checkpointed; a commit per row pays a WAL sync per row.
+// With autoTune, `rows` is the current batch size: after each commit it is
+// re-derived from the measured per-row write time and commit latency so that
+// a batch holds the write lock - and readers go without new rows - for about
+// stallMs. The value carries over to the next bulk write. (Another writer
+// still has to catch a gap between batches through its busy handler.)
+// No rows and no interval means a single transaction, as before.
+struct CommitPolicy {
+    size_t rows = 0;
+    int intervalMs = 0;
+    bool autoTune = false;
+    int stallMs = 0;
+
+    static CommitPolicy single();
+    static CommitPolicy every(size_t rows, int intervalMs = 0);
+    static CommitPolicy tuned(int stallMs = 50);
+};
+
+// "single", "auto", "auto:MS", "ROWS" or "ROWS/MS".
+bool parseCommitPolicy(const std::string& text, CommitPolicy& out);
+std::string describeCommitPolicy(const CommitPolicy& p);
+
+// ---------- COMPLIANCE layout ----------
+// COMPLIANCE is keyed by STUDENT_ID either way. As a rowid table STUDENT_ID is
+// the rowid; WITHOUT ROWID keeps the rows in a primary-key B-tree instead.
+// Database::migrateCompliance switches between them; band bench-compliance
+// compares both with a covering index and with the columns folded into
+// STUDENTS.
+enum class ComplianceLayout { Rowid, WithoutRowid };
+
+const char* complianceLayoutName(ComplianceLayout layout);            // "rowid" | "without-rowid"
+bool findComplianceLayout(const std::string& name, ComplianceLayout& out);
+
+// ---------- Date encoding ----------
+// CHECKED_OUT_DATE (INSTRUMENTS, UNIFORMS, SHAKOS) and LAST_VERIFIED_DATE
+// (COMPLIANCE) hold 'YYYY-MM-DD' text, as the GUI writes them, or INTEGER
+// Julian day numbers (2460677 is 2025-01-01): 3 bytes a value instead of 10,
+// and date ranges compare integers. The column names stay the same either way.
+// INSTRUMENTS_TEXT, UNIFORMS_TEXT, SHAKOS_TEXT and COMPLIANCE_TEXT show the
+// tables with the dates as text. The engine reads dates through these views
+// and writes Database::today(). Database::migrateDates switches the encoding.
+enum class DateEncoding { Text, Days };
+
+const char* dateEncodingName(DateEncoding encoding);                  // "text" | "days"
+bool findDateEncoding(const std::string& name, DateEncoding& out);
+
+// ---------- Checkpoints ----------
+struct CheckpointStats {
+    uint64_t runs = 0;
+    uint64_t busy = 0;
+    uint64_t framesCopied = 0;
+    int lastLogFrames = 0;
+    double lastMs = 0.0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+};
+
+struct DatabaseStats {
+    const DurabilityProfile* durability = nullptr;
+    CommitPolicy commitPolicy;
+    ComplianceLayout complianceLayout = ComplianceLayout::Rowid;
+    DateEncoding dateEncoding = DateEncoding::Text;
+    ThreadingMode threading = ThreadingMode::Serialized;
+    int sqliteThreadsafe = 0;       // SQLITE_THREADSAFE of the linked library
+    long long databaseBytes = 0;
+    long long walBytes = 0;
+    int walFramesPending = 0;
+    std::string checkpointMode;
+    bool backgroundCheckpoints = false;
+    int checkpointThresholdPages = 0;
+    int checkpointIdleMs = 0;
+    CheckpointStats checkpoints;
+};
+
+// ---------- Records ----------
+struct InstrumentType {
+    int id;
+    std::string name;
+    std::string section;
+    int rank;       // position in SECTION, TYPE_NAME order
+};
+
+struct Student {
+    int id = 0;
+    std::string fname;
+    std::string lname;
+    std::string classification;
+    std::string section;
+    std::string shirtSize;      // empty = not recorded
+    std::string shoeSize;
+    std::string role;           // PRIMARY_ROLE, kept by the GUI
+    bool active = true;
+};
+
+struct Compliance {
+    int creditHours = 0;
+    double gpa = 0.0;
+    bool duesPaid = false;
+    std::string lastVerified;
+
+    bool hoursOk() const { return creditHours >= 12; }
+    bool gpaOk() const { return gpa >= 3.0; }
+    bool eligible() const { return hoursOk() && gpaOk() && duesPaid; }
+};
+
+// A student with their compliance row (zeros when there is none).
+struct StudentProfile {
+    Student student;
+    Compliance compliance;
+};
+
+struct LeaderRollupRow {
+    std::string section;
+    bool hasLeader = false;
+    int leaderId = 0;
+    std::string leaderName;
+    bool leaderOutsideSection = false;
+    int members = 0;
+    int eligible = 0;
+    int noInstrument = 0;
+    int noUniform = 0;
+    int noShako = 0;
+};
+
+struct Instrument {
+    int id;
+    bool checkedOut;
+    int studentId;
+    int rank;           // catalog rank of the type
+    std::string type;
+    std::string section;
+    std::string serial;
+    std::string date;
+    std::string notes;
+};
+
+struct Uniform {
+    int id = 0;
+    std::string coatSize;
+    std::string pantSize;
+    std::string coatNumber;
+    std::string pantNumber;
+    std::string notes;
+    bool checkedOut = false;
+    int studentId = 0;
+    std::string date;
+};
+
+struct Shako {
+    int id = 0;
+    std::string size;
+    std::string notes;
+    bool checkedOut = false;
+    int studentId = 0;
+    std::string date;
+};
+
+struct EligibilityEvent {
+    sqlite3_int64 eventId;
+    int studentId;
+    std::string name;       // empty when the student has since been deleted
+    bool wasEligible;
+    bool isEligible;
+    std::string changedAt;
+};
+
+enum class Outcome { Done, NotFound, Failed };
+
+// All: available first; Available: catalog/ID order; CheckedOut: ID order.
+enum class Holding { All, Available, CheckedOut };
+
+enum class InventoryKind { Instruments, Uniforms, Shakos };
+
+// ---------- Undo journal ----------
+// Undoable writes record every row they touch as a packed before/after image.
+// Undo checks that those rows still hold their after images and writes the
+// before images back in one savepoint; redo does the reverse. Entries sit in
+// a ring bounded by count and bytes (oldest dropped first) and can be mirrored
+// to UNDO_LOG so they outlive the process. Bulk imports are not journaled.
+enum class UndoTable : uint8_t { Students, Compliance, Instruments, Uniforms, Shakos, SectionLeaders };
+
+struct UndoEntry {
+    sqlite3_int64 seq = 0;      // UNDO_LOG row when persistent
+    std::string label;
+    std::string data;           // packed row images
+};
+
+class Database;
+
+class UndoJournal {
+public:
+    explicit UndoJournal(Database& db) : db(db) {}
+
+    void setLimits(size_t entries, size_t bytes);
+    // Mirrors the journal to UNDO_LOG; loads what is there when the database
+    // is (or later gets) open.
+    bool setPersistent(bool on);
+    bool persistent() const { return persist; }
+
+    size_t undoCount() const { return count; }
+    size_t redoCount() const { return redoStack.size(); }
+    size_t bytes() const { return ringBytes; }
+    const UndoEntry* peekUndo() const;
+    const UndoEntry* peekRedo() const { return redoStack.empty() ? nullptr : &redoStack.back(); }
+
+    // NotFound: nothing to undo/redo. Failed: a row changed since it was
+    // written (lastError says which) or a SQL error; nothing is applied.
+    Outcome undo(std::string& label);
+    Outcome redo(std::string& label);
+
+    // Write side, for the repositories. begin() opens a savepoint; touch()
+    // captures a row before it is written (a missing row counts as created),
+    // inserted() records a row an AUTOINCREMENT insert just created. Calls
+    // nest and only the outermost commit() records an entry.
+    bool begin(const std::string& label);
+    bool touch(UndoTable t, sqlite3_int64 key);
+    bool touch(UndoTable t, const std::string& key);
+    bool inserted(UndoTable t, sqlite3_int64 key);
+    bool commit();
+    void abort();
+
+    bool load();                // called by Database::open
+    void reset();
+
+private:
+    struct Pending {
+        UndoTable table;
+        std::string key;            // packed
+        bool hadBefore;
+        std::string before;
+    };
+
+    Database& db;
+    size_t maxEntries = 100;
+    size_t maxBytes = 256 * 1024;
+    bool persist = false;
+
+    std::vector<UndoEntry> ring;    // maxEntries slots, oldest at head
+    size_t head = 0;
+    size_t count = 0;
+    size_t ringBytes = 0;
+    std::vector<UndoEntry> redoStack;
+
+    int depth = 0;
+    std::string pendingLabel;
+    std::vector<Pending> pending;
+
+    bool record(Pending p);
+    bool push(UndoEntry e);
+    Outcome apply(const UndoEntry& e, bool undoing);
+};
+
+// ---------- Key filters ----------
+// A blocked Bloom filter over 64-bit key hashes. A key sets one bit in each of
+// the eight words of a single 64-byte block, so a lookup reads one cache line.
+// "No" is exact; "maybe" has to be confirmed against the table. At the default
+// 10 bits a key, about 1% of absent keys come back "maybe" while the filter
+// holds no more keys than it was sized for.
+class KeyFilter {
+public:
+    static uint64_t hash(sqlite3_int64 key);
+    static uint64_t hash(std::string_view key);
+
+    // Empties the filter and sizes it for `expectedKeys`.
+    void reset(size_t expectedKeys, unsigned bitsPerKey = 10);
+    void add(uint64_t h);
+    bool mayContain(uint64_t h) const;      // true while not sized
+
+    bool empty() const { return blocks.empty(); }
+    size_t keys() const { return count; }
+    size_t capacity() const { return sizedFor; }
+    size_t bytes() const { return blocks.capacity() * sizeof(Block); }
+
+private:
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+
+    size_t blockIndex(uint64_t h) const { return (size_t)(((h >> 32) * blocks.size()) >> 32); }
+
+    std::vector<Block> blocks;
+    size_t count = 0;
+    size_t sizedFor = 0;
+};
+
+// ---------- Database ----------
+class Database {
+public:
+    Database() = default;
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
+    ~Database() { close(); }
+
+    // Opens (creating if needed) the database, applies the durability
+    // profile, brings the schema up to date and loads the type catalog.
+    bool open(const std::string& path, const DurabilityProfile& profile = DURABILITY_PROFILES[0]);
+    void close();
+
+    sqlite3* handle() const { return conn; }
+    const std::string& path() const { return dbPath; }
+    const std::string& lastError() const { return error; }
+    bool exec(const std::string& sql);
+
+    // PRAGMA data_version moves when another connection commits;
+    // totalChanges moves on our own writes.
+    sqlite3_int64 dataVersion();
+    sqlite3_int64 totalChanges() const { return sqlite3_total_changes64(conn); }
+
+    // Durability. commitPoint is called between user actions; with a commit
+    // interval it opens a batch while more input is pending and commits it
+    // once the interval is up or the input runs dry.
+    const DurabilityProfile& durability() const { return *profile; }
+    void commitPoint(bool inputPending);
+    void flushCommitBatch();
+
+    // Multi-statement writes nest inside an open batch by using a savepoint;
+    // with no transaction open a savepoint behaves like BEGIN ... COMMIT.
+    bool beginWrite();
+    bool commitWrite();
+    void rollbackWrite();
+
+    // Bulk writes commit in batches by this policy (default: auto, 50 ms).
+    void setCommitPolicy(const CommitPolicy& p) { commitRule = p; }
+    const CommitPolicy& commitPolicy() const { return commitRule; }
+
+    // Background checkpoints: passive|restart|truncate|off. Set before open().
+    bool setCheckpointMode(const std::string& name);
+    DatabaseStats stats();
+
+    bool complianceLayout(ComplianceLayout& out);
+    // Rebuilds COMPLIANCE in `layout` in one transaction from its definition
+    // as the database has it, rows, indexes and triggers included; nothing is
+    // logged to the change feed. No-op when it already is.
+    bool migrateCompliance(ComplianceLayout layout);
+
+    // The SQL expression for the current date in this encoding.
+    DateEncoding dateEncoding() const { return dates; }
+    const char* today() const;
+    // Rebuilds the four dated tables with their dates converted to `encoding`,
+    // in one transaction. Each table keeps its definition as the database has
+    // it - the GUI's foreign-key actions included - with only the date column
+    // retyped; indexes, triggers, views and AUTOINCREMENT counters are kept,
+    // and nothing is logged to the change feed. Values that are not dates are
+    // copied as they are. Undo entries recorded before the rebuild no longer
+    // match their rows, so they are refused. Does nothing when the tables are
+    // already in `encoding`.
+    bool migrateDates(DateEncoding encoding);
+
+    // Instrument type catalog, sorted by SECTION, TYPE_NAME.
+    const std::vector<InstrumentType>& instrumentTypes() const { return types; }
+    const InstrumentType* findInstrumentType(int typeId);      // reloads once on a miss
+    const InstrumentType* findInstrumentType(const std::string& name) const;
+    bool loadInstrumentTypes();
+
+    UndoJournal& undo() { return journal; }
+
+    // Existence filters over STUDENT_ID and SERIAL for the bulk imports, each
+    // built by one scan on first use. A filter is rebuilt once another
+    // connection has committed, once it holds more keys than it was sized
+    // for, and after an undo or redo (which can put rows back); keys deleted
+    // since only cost a lookup. Null on a SQL error.
+    const KeyFilter* studentKeys();
+    const KeyFilter* serialKeys();
+    // Writers add the keys they insert. Nothing to do while a filter is unbuilt.
+    void addStudentKey(sqlite3_int64 studentId);
+    void addSerialKey(std::string_view serial);
+    void dropKeyFilters();
+
+    // For the repositories: record why an operation failed and return false.
+    bool fail(const std::string& message);
+    bool failSQL(const std::string& context = "SQL error");   // context + sqlite3_errmsg
+
+private:
+    struct Checkpointer {
+        int mode = SQLITE_CHECKPOINT_PASSIVE;
+        std::string modeName = "passive";
+        bool enabled = true;
+        int walThresholdPages = 1000;
+        int idleIntervalMs = 5000;
+
+        sqlite3* conn = nullptr;
+        std::thread worker;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::atomic<int> walFrames{0};
+        CheckpointStats stats;      // guarded by lock
+    };
+
+    sqlite3* conn = nullptr;
+    std::string dbPath;
+    std::string error;
+
+    const DurabilityProfile* profile = &DURABILITY_PROFILES[0];
+    bool batchOpen = false;
+    std::chrono::steady_clock::time_point batchStarted;
+    CommitPolicy commitRule = CommitPolicy::tuned();
+    DateEncoding dates = DateEncoding::Text;
+
+    Checkpointer checkpointer;
+    UndoJournal journal{*this};
+
+    KeyFilter studentFilter, serialFilter;
+    sqlite3_int64 studentFilterVersion = 0, serialFilterVersion = 0;
+
+    std::vector<InstrumentType> types;
+    std::unordered_map<int, size_t> typeById;           // TYPE_ID -> index
+    std::unordered_map<std::string, size_t> typeByName;  // upper-cased name -> index
+
+    bool columnExists(const std::string& table, const std::string& col);
+    void ensureTables();
+    bool seedInstrumentTypes();
+    const KeyFilter* refreshKeyFilter(KeyFilter& f, sqlite3_int64& version, const char* sql, bool textKeys);
+
+    static int walHook(void* arg, sqlite3*, const char*, int frames);
+    void runCheckpoint();
+    void checkpointLoop();
+    void startCheckpointer();
+    void stopCheckpointer();
+};
+
+// ---------- Repositories ----------
+class StudentRepo {
+public:
+    explicit StudentRepo(Database& db) : db(db) {}
+
+    // Adds the student and an empty COMPLIANCE row.
+    bool add(const Student& s);
+    bool exists(int studentId);
+    Outcome section(int studentId, std::string& section);
+    Outcome find(int studentId, StudentProfile& out);
+    bool list(std::vector<StudentProfile>& out);                 // by SECTION, LNAME, FNAME
+    Outcome setSectionLeader(const std::string& section, int studentId);
+    bool leaderRollup(std::vector<LeaderRollupRow>& out);
+
+    // STUDENT_ID,FNAME,LNAME,CLASSIFICATION,SECTION[,SHIRT_SIZE,SHOE_SIZE]
+    // Parsing, validation and the inserts run as overlapped pipeline stages;
+    // errors come back in line order all the same.
+    bool importFile(const std::string& path, ImportResult& result);
+
+    // Deletes the students and whatever points at them: their gear is checked
+    // back in, sections they lead lose their leader, and COMPLIANCE goes with
+    // the row. Missing IDs are skipped. One transaction, set-wise over a temp
+    // table of IDs, so thousands of students cost a handful of statements.
+    bool remove(const std::vector<int>& ids, StudentCleanup& out);
+    // (duplicate, kept) pairs. A duplicate's gear moves to its kept student
+    // when that student holds none of the kind (otherwise it is checked in),
+    // its leaderships move over, and the most recently verified COMPLIANCE row
+    // of the group wins; then the duplicate is deleted. Fails without writing
+    // when a kept student is missing or is itself merged away.
+    bool merge(const std::vector<std::pair<int, int>>& pairs, StudentCleanup& out);
+    // Removals and merges of up to this many students go through the undo
+    // journal; bigger ones are bulk operations like the imports.
+    static constexpr size_t UNDO_BATCH_LIMIT = 100;
+
+private:
+    Database& db;
+};
+
+class InventoryRepo {
+public:
+    explicit InventoryRepo(Database& db) : db(db) {}
+
+    // NotFound: no instrument type with that ID.
+    Outcome addInstrument(int typeId, const std::string& serial, const std::string& notes);
+    bool instruments(Holding which, std::vector<Instrument>& out);
+    // NotFound: already checked out or no such instrument.
+    Outcome checkoutInstrument(int instrumentId, int studentId);
+    Outcome returnInstrument(int instrumentId);
+
+    // Uniforms and shakos are entered as they are handed out. NotFound: no
+    // such student.
+    Outcome checkoutUniform(int studentId, const Uniform& u);
+    bool uniforms(Holding which, std::vector<Uniform>& out);
+    Outcome returnUniform(int uniformId);
+
+    Outcome checkoutShako(int studentId, const Shako& s);
+    bool shakos(Holding which, std::vector<Shako>& out);
+    Outcome returnShako(int shakoId);
+
+    // Unassigned stock, one item per line:
+    //   instruments: TYPE_NAME,SERIAL[,CONDITION_NOTES]
+    //   uniforms:    COAT_SIZE,PANT_SIZE,COAT_NUMBER,PANT_NUMBER[,CONDITION_NOTES]
+    //   shakos:      SIZE[,CONDITION_NOTES]
+    bool importFile(const std::string& path, InventoryKind kind, ImportResult& result);
+
+private:
+    Database& db;
+};
+
+// ---------- Analytics ----------
+// GPA / credit-hour distributions by section and by class. The roster is
+// copied into a columnar snapshot, then one pass bins every student into a
+// (section, class) cell histogram at 0.01 GPA resolution. Sections and
+// classes outside the known ones are binned as OTHER, the last of each.
+extern const char* const ANALYTICS_SECTIONS[];
+extern const char* const ANALYTICS_CLASSES[];
+constexpr int ANALYTICS_NUM_SECTIONS = 6;
+constexpr int ANALYTICS_NUM_CLASSES = 5;
+constexpr int ANALYTICS_NUM_CELLS = ANALYTICS_NUM_SECTIONS * ANALYTICS_NUM_CLASSES;
+constexpr int GPA_BINS = 401;       // 0.00 .. 4.00 in steps of 0.01
+constexpr int HOUR_BINS = 31;       // 0 .. 30 credit hours
+
+struct ComplianceSnapshot {
+    std::vector<float> gpa;
+    std::vector<uint8_t> hours;
+    std::vector<uint8_t> cell;      // section * ANALYTICS_NUM_CLASSES + class
+};
+
+struct DistributionStats {
+    std::vector<uint32_t> gpaHist;  // GPA_BINS per cell
+    std::vector<uint32_t> hourHist; // HOUR_BINS per cell
+    std::vector<double> gpaSum;     // exact sum per cell
+};
+
+struct GroupSummary {
+    uint64_t count = 0;
+    double gpaSum = 0.0;
+    uint64_t hourSum = 0;
+    std::vector<uint64_t> gpaHist = std::vector<uint64_t>(GPA_BINS, 0);
+
+    void addCell(const DistributionStats& st, int cellIdx);
+    double percentile(double p) const;
+    uint64_t countBetween(int fromBin, int toBin) const;   // GPA bins, inclusive
+};
+
+void buildSyntheticSnapshot(ComplianceSnapshot& snap, size_t n);
+void computeDistributions(const ComplianceSnapshot& snap, DistributionStats& st);
+
+class ComplianceRepo {
+public:
+    explicit ComplianceRepo(Database& db) : db(db) {}
+
+    // NotFound: no such student.
+    Outcome update(int studentId, int creditHours, double gpa, bool duesPaid);
+    // Every student, ineligible first, then SECTION, LNAME, FNAME.
+    bool eligibilityReport(std::vector<StudentProfile>& out);
+    bool recentChanges(int limit, std::vector<EligibilityEvent>& out);     // newest first
+    bool eventsAfter(sqlite3_int64 afterId, std::vector<EligibilityEvent>& out);
+    bool snapshot(ComplianceSnapshot& snap);
+
+    // STUDENT_ID,CREDIT_HOURS,GPA per line; threads = 0 uses every core.
+    // Upserts hours and GPA; dues are left alone.
+    bool importFile(const std::string& path, unsigned threads, ImportResult& result);
+
+private:
+    Database& db;
+};
+
+// ---------- Compact roster ----------
+// A read-only copy of STUDENTS and COMPLIANCE for the check-in kiosks, which
+// are small boxes with little RAM. Each student is one 16-byte record, sorted
+// by STUDENT_ID. Names, classifications, sections and roles are codes into
+// sorted dictionaries that hold each distinct string once; the section code
+// shares a byte with the flags, so it takes 5 bits.
+// Eligibility is decided from the exact values at load time, so it always
+// agrees with Compliance::eligible(). LAST_VERIFIED_DATE and the sizes are
+// left out. band bench-kiosk compares the footprint with SQLite's page cache.
+struct PackedStudent {
+    uint32_t id;
+    uint8_t first[3];           // FNAME code
+    uint8_t last[3];            // LNAME code
+    uint8_t classification;     // code; 0 = none
+    uint8_t role;               // PRIMARY_ROLE code; 0 = none
+    uint8_t flags;              // SECTION code | ACTIVE | DUES_PAID | eligible
+    uint8_t creditHours;        // capped at 255
+    uint16_t gpa;               // GPA * 100, rounded
+};
+static_assert(sizeof(PackedStudent) == 16, "PackedStudent is a 16-byte record");
+
+class CompactRoster {
+public:
+    // One read of STUDENTS joined to COMPLIANCE. Fails (db.lastError) on a SQL
+    // error, on more than 2^24 distinct first or last names, on more than 255
+    // distinct classifications or roles, or on more than 32 distinct sections.
+    bool load(Database& db);
+    // True once another connection has committed since load().
+    bool stale(Database& db) const;
+
+    size_t size() const { return records.size(); }
+    size_t bytes() const;               // records and dictionaries
+    size_t distinctNames() const { return firstNames.size() + lastNames.size(); }
+
+    const PackedStudent* find(int studentId) const;
+    bool eligible(const PackedStudent& r) const { return r.flags & ELIGIBLE; }
+    // Everything but the sizes and LAST_VERIFIED_DATE.
+    StudentProfile profile(const PackedStudent& r) const;
+    // Students whose last name starts with `prefix`, ignoring case, by ID.
+    void matchLastName(const std::string& prefix, std::vector<const PackedStudent*>& out) const;
+
+private:
+    static constexpr uint8_t SECTION_MASK = 0x1F, ACTIVE = 0x20, DUES_PAID = 0x40, ELIGIBLE = 0x80;
+
+    // Distinct strings in case-insensitive order; a code is a position.
+    struct Dictionary {
+        std::string text;
+        std::vector<uint32_t> offsets;  // size() + 1 entries
+
+        size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+        std::string_view at(uint32_t code) const {
+            return std::string_view(text).substr(offsets[code], offsets[code + 1] - offsets[code]);
+        }
+        size_t bytes() const { return text.capacity() + offsets.capacity() * sizeof(uint32_t); }
+    };
+
+    std::vector<PackedStudent> records;
+    Dictionary firstNames, lastNames, classifications, sections, roles;
+    sqlite3_int64 version = 0;
+    sqlite3_int64 changes = 0;
+};
+
+// ---------- Change feed ----------
+// Triggers append every insert, update and delete on STUDENTS, COMPLIANCE,
+// INSTRUMENTS, UNIFORMS and SHAKOS - from any connection, the GUI's included -
+// to CHANGE_LOG under the next change version. A front-end that remembers the
+// epoch and version of its last refresh reads back only the rows that moved
+// since. The epoch tells a recreated database from the one the version came from.
+struct ChangeSet {
+    sqlite3_int64 epoch = 0;        // pass both back next time
+    sqlite3_int64 version = 0;      // ... this one as `since`
+    bool reload = false;            // `since` is older than the log or from another database file
+    std::vector<StudentProfile> students;       // added or changed, compliance included
+    std::vector<int> removedStudents;
+    std::vector<Instrument> instruments;
+    std::vector<int> removedInstruments;
+    std::vector<Uniform> uniforms;
+    std::vector<int> removedUniforms;
+    std::vector<Shako> shakos;
+    std::vector<int> removedShakos;
+
+    size_t size() const {
+        return students.size() + removedStudents.size() + instruments.size() + removedInstruments.size() +
+               uniforms.size() + removedUniforms.size() + shakos.size() + removedShakos.size();
+    }
+};
+
+class ChangeFeed {
+public:
+    explicit ChangeFeed(Database& db) : db(db) {}
+
+    // The database's epoch and latest change version; the version is 0
+    // before the first logged write.
+    bool version(sqlite3_int64& epoch, sqlite3_int64& version);
+    // Rows changed after `since` in `epoch`. The version is read before the
+    // rows, so a write racing the call may show up again next time but is
+    // never missed.
+    bool since(sqlite3_int64 epoch, sqlite3_int64 since, ChangeSet& out);
+
+private:
+    Database& db;
+};
+
+// ---------- Task pool ----------
+// A small work-stealing pool for the engine's parallel jobs. Each worker has
+// its own deque: it runs its newest task first, and an idle worker steals
+// the oldest task from another worker's deque. Tasks submitted from a task
+// land on that worker's deque; from outside they are dealt round-robin.
+// A worker opens a read-only connection to the pool's database the first time
+// a task asks for one and keeps it until the pool is destroyed. Tasks must not
+// throw or call wait().
+struct PoolMetrics {
+    unsigned workers = 0;
+    uint64_t tasks = 0;
+    uint64_t steals = 0;            // tasks run by a worker other than the one queued on
+    double busyMs = 0.0;            // summed over workers
+    double idleMs = 0.0;            // summed over workers, waiting for work
+    double latencyP50Ms = 0.0;      // submit to finish, per task
+    double latencyP95Ms = 0.0;
+    double latencyMaxMs = 0.0;
+};
+
+class TaskPool {
+public:
+    class Context {
+    public:
+        unsigned worker() const { return index; }
+        // Read-only connection bound to this worker; null when it could not be
+        // opened (error() says why) or the pool has no database.
+        sqlite3* connection();
+        const std::string& error() const { return openError; }
+
+    private:
+        friend class TaskPool;
+        const std::string* path = nullptr;
+        unsigned index = 0;
+        sqlite3* conn = nullptr;
+        std::string openError;
+    };
+
+    using Task = std::function<void(Context&)>;
+
+    // workers = 0 uses every core. dbPath may be empty when no task needs a
+    // connection.
+    explicit TaskPool(const std::string& dbPath = std::string(), unsigned workers = 0);
+    ~TaskPool();
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void submit(Task task);
+    void wait();                    // until every submitted task has finished
+    unsigned size() const { return (unsigned)workers.size(); }
+    PoolMetrics metrics();          // since the pool started
+
+private:
+    struct Item {
+        Task task;
+        std::chrono::steady_clock::time_point queued;
+    };
+    struct Worker {
+        std::mutex lock;            // guards tasks and the counters below
+        std::deque<Item> tasks;
+        std::thread thread;
+        Context context;
+        uint64_t ran = 0;
+        uint64_t stolen = 0;
+        double busyMs = 0.0;
+        double idleMs = 0.0;
+        std::vector<double> latencyMs;
+    };
+
+    std::string path;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex sleepLock;
+    std::condition_variable wake;   // work queued or stopping
+    std::condition_variable idle;   // unfinished reached zero
+    size_t queued = 0;              // guarded by sleepLock
+    size_t unfinished = 0;          // guarded by sleepLock
+    bool stopping = false;          // guarded by sleepLock
+    std::atomic<unsigned> nextWorker{0};
+
+    void run(unsigned index);
+    bool take(unsigned index, Item& item, bool& stolen);
+};
+
+// ---------- Integrity check ----------
+// PRAGMA quick_check and foreign_key_check plus the invariants the schema
+// cannot express (leaders in their own section, one item of a kind per
+// student, checkout columns set together, well-formed dates, ...). Each check
+// is one query; they are shared out over read-only connections, one per
+// thread, so a large database is checked at the speed of its slowest query.
+struct CheckResult {
+    const char* name;
+    const char* description;
+    size_t violations = 0;
+    std::vector<std::string> samples;   // the first few offending rows
+    std::string error;                  // set when the check could not run
+    double ms = 0.0;
+};
+
+struct IntegrityReport {
+    std::vector<CheckResult> checks;
+    unsigned threads = 1;
+    double seconds = 0.0;
+    PoolMetrics pool;
+
+    size_t violations() const;
+    bool clean() const;                 // no violations and no errors
+};
+
+class IntegrityChecker {
+public:
+    explicit IntegrityChecker(Database& db) : db(db) {}
+
+    // Runs on a TaskPool of `threads` workers; 0 uses every core (never more
+    // than there are checks). Each worker connection reads its own snapshot,
+    // taken after our pending writes are committed; a writer racing the check
+    // can show up in some checks only.
+    bool run(unsigned threads, IntegrityReport& out);
+
+    static const size_t SAMPLE_ROWS = 5;
+
+private:
+    Database& db;
+};
+
+} // namespace banddb
+
+#endif
@@ -0,0 +1,771 @@
+// banddb_python.cpp - CPython extension exposing libbanddb to the GUI.
+//
+// Build (Linux/Mac), from this directory:
+//   g++ -std=c++17 -O2 -shared -fPIC -pthread $(python3-config --includes)
+//       banddb_python.cpp banddb.cpp
+//       -o ../python-gui/banddb$(python3-config --extension-suffix) -lsqlite3
+// (one command line; the module lands next to bandapp.py, which imports it
+// when present and falls back to its own queries otherwise)
+//
+// List calls return (rows, {column: (typecode, bytes)}) instead of a tuple per
+// row. Numeric columns are packed native arrays for memoryview(b).cast(code)
+// ('i' int32, 'd' double, 'B' 0/1 flag); text columns ('s') are the values
+// joined with '\0', so one decode().split('\0') yields the whole column.
+//
+// Each list is cached until the database changes (PRAGMA data_version for
+// other connections such as the GUI's own, total_changes for ours). An
+// unchanged list comes back as the very same object, so a caller can skip
+// repainting a table with an `is` check. The GIL is released while the engine
+// runs; each Engine has a lock of its own, so calls on one Engine from several
+// Python threads take turns and close() waits for the call in progress.
+//
+// Opening a database runs the engine's schema setup, as the console does. On
+// the GUI's band.db that leaves the GUI's tables and rows as they are and adds
+// what the engine reads and writes through: the instrument type catalog (when
+// it is empty), the *_TEXT views, the ELIGIBILITY_EVENTS, CHANGE_LOG,
+// CHANGE_EPOCH and UNDO_LOG tables with their triggers, and any student
+// columns it lacks.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "banddb.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace banddb;
+
+static PyObject* EngineError = nullptr;
+
+// ---------- Column buffers ----------
+struct Column {
+    const char* name;
+    char code;
+    string data;
+};
+
+struct ColumnSet {
+    size_t rows = 0;
+    deque<Column> cols;     // add() hands out references that must stay put
+
+    Column& add(const char* name, char code) {
+        cols.push_back({name, code, string()});
+        return cols.back();
+    }
+};
+
+template <typename T>
+static void putNumber(Column& c, T v) {
+    c.data.append((const char*)&v, sizeof v);
+}
+
+static void putText(Column& c, size_t row, const string& s) {
+    if (row) c.data += '\0';
+    c.data += s;
+}
+
+static PyObject* toPython(const ColumnSet& set) {
+    PyObject* cols = PyDict_New();
+    if (!cols) return nullptr;
+    for (const Column& c : set.cols) {
+        PyObject* v = Py_BuildValue("(Cy#)", (int)c.code, c.data.data(), (Py_ssize_t)c.data.size());
+        if (!v || PyDict_SetItemString(cols, c.name, v) < 0) {
+            Py_XDECREF(v);
+            Py_DECREF(cols);
+            return nullptr;
+        }
+        Py_DECREF(v);
+    }
+    PyObject* result = Py_BuildValue("(nO)", (Py_ssize_t)set.rows, cols);
+    Py_DECREF(cols);
+    return result;
+}
+
+// ---------- Engine ----------
+enum CachedList { LIST_STUDENTS, LIST_INSTRUMENTS, LIST_UNIFORMS, LIST_SHAKOS, LIST_TYPES, NUM_LISTS };
+
+struct EngineObject {
+    PyObject_HEAD
+    Database* db;               // guarded by lock
+    mutex* lock;
+    PyObject* cache[NUM_LISTS];
+    sqlite3_int64 cacheVersion[NUM_LISTS];
+    sqlite3_int64 cacheChanges[NUM_LISTS];
+};
+
+static void clearCache(EngineObject* self) {
+    for (int i = 0; i < NUM_LISTS; i++) Py_CLEAR(self->cache[i]);
+}
+
+// Runs work(db) with the GIL released and the engine lock held. The GIL goes
+// first, so a thread waiting for the lock never holds up the rest of Python.
+// False with banddb.Error set when the engine is closed or work returns false;
+// the message is lastError, read before the lock is let go.
+template <class Work>
+static bool runLocked(EngineObject* self, Work work) {
+    bool open, ok = false;
+    string error;
+    Py_BEGIN_ALLOW_THREADS
+    {
+        lock_guard<mutex> guard(*self->lock);
+        open = self->db != nullptr;
+        if (open) {
+            ok = work(*self->db);
+            if (!ok) error = self->db->lastError();
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (!open) PyErr_SetString(EngineError, "engine is closed");
+    else if (!ok) PyErr_SetString(EngineError, error.c_str());
+    return ok;
+}
+
+// Done -> True, NotFound -> False, Failed -> banddb.Error.
+template <class Work>
+static PyObject* outcomeResult(EngineObject* self, Work work) {
+    Outcome o = Outcome::Failed;
+    if (!runLocked(self, [&](Database& db) { return (o = work(db)) != Outcome::Failed; })) return nullptr;
+    return PyBool_FromLong(o == Outcome::Done);
+}
+
+static PyObject* Engine_new(PyTypeObject* type, PyObject*, PyObject*) {
+    EngineObject* self = (EngineObject*)type->tp_alloc(type, 0);
+    if (!self) return nullptr;
+    self->db = nullptr;
+    for (int i = 0; i < NUM_LISTS; i++) self->cache[i] = nullptr;
+    self->lock = new (nothrow) mutex;
+    if (!self->lock) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return (PyObject*)self;
+}
+
+// Swaps `db` in (nullptr to close) once no call is using the old one.
+static void replaceDatabase(EngineObject* self, Database* db) {
+    clearCache(self);
+    if (!self->lock) return;
+    Database* old;
+    Py_BEGIN_ALLOW_THREADS
+    {
+        lock_guard<mutex> guard(*self->lock);
+        old = self->db;
+        self->db = db;
+    }
+    delete old;
+    Py_END_ALLOW_THREADS
+}
+
+static void closeEngine(EngineObject* self) {
+    replaceDatabase(self, nullptr);
+}
+
+// Engine(path="band.db", durability="normal", checkpoint="off", undo_log=False,
+//        commit="auto")
+// The GUI writes through its own connection, which checkpoints as usual, so
+// the engine's background checkpointer is off unless asked for. undo_log
+// shares the console's persistent undo history (UNDO_LOG). commit is the
+// import batching policy, as for band --commit=.
+static int Engine_init(EngineObject* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[] = {"path", "durability", "checkpoint", "undo_log", "commit", nullptr};
+    const char* path = "band.db";
+    const char* durability = "normal";
+    const char* checkpoint = "off";
+    int undoLog = 0;
+    const char* commit = "auto";
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sssps", (char**)kwlist, &path, &durability, &checkpoint,
+                                     &undoLog, &commit))
+        return -1;
+
+    const DurabilityProfile* profile = findDurabilityProfile(durability);
+    if (!profile) {
+        PyErr_Format(PyExc_ValueError, "unknown durability profile '%s'", durability);
+        return -1;
+    }
+
+    CommitPolicy policy;
+    if (!parseCommitPolicy(commit, policy)) {
+        PyErr_Format(PyExc_ValueError, "unknown commit policy '%s'", commit);
+        return -1;
+    }
+
+    closeEngine(self);
+    Database* db = new Database();
+    db->setCommitPolicy(policy);
+    if (!db->setCheckpointMode(checkpoint)) {
+        delete db;
+        PyErr_Format(PyExc_ValueError, "unknown checkpoint mode '%s'", checkpoint);
+        return -1;
+    }
+
+    bool ok;
+    string where = path;
+    db->undo().setPersistent(undoLog);
+    Py_BEGIN_ALLOW_THREADS
+    ok = db->open(where, *profile);
+    Py_END_ALLOW_THREADS
+    if (!ok) {
+        PyErr_SetString(EngineError, db->lastError().c_str());
+        delete db;
+        return -1;
+    }
+    replaceDatabase(self, db);
+    return 0;
+}
+
+static void Engine_dealloc(EngineObject* self) {
+    PyTypeObject* type = Py_TYPE(self);
+    closeEngine(self);
+    delete self->lock;
+    type->tp_free((PyObject*)self);
+    Py_DECREF(type);
+}
+
+static PyObject* Engine_close(EngineObject* self, PyObject*) {
+    closeEngine(self);
+    Py_RETURN_NONE;
+}
+
+// ---------- Lists ----------
+static void studentColumns(const vector<StudentProfile>& rows, ColumnSet& set) {
+    Column& id = set.add("id", 'i');
+    Column& fname = set.add("fname", 's');
+    Column& lname = set.add("lname", 's');
+    Column& cls = set.add("classification", 's');
+    Column& section = set.add("section", 's');
+    Column& role = set.add("role", 's');
+    Column& shirt = set.add("shirt_size", 's');
+    Column& shoe = set.add("shoe_size", 's');
+    Column& active = set.add("active", 'B');
+    Column& hours = set.add("credit_hours", 'i');
+    Column& gpa = set.add("gpa", 'd');
+    Column& dues = set.add("dues_paid", 'B');
+    Column& eligible = set.add("eligible", 'B');
+    Column& verified = set.add("last_verified", 's');
+
+    for (size_t r = 0; r < rows.size(); r++) {
+        const Student& s = rows[r].student;
+        const Compliance& c = rows[r].compliance;
+        putNumber<int32_t>(id, s.id);
+        putText(fname, r, s.fname);
+        putText(lname, r, s.lname);
+        putText(cls, r, s.classification);
+        putText(section, r, s.section);
+        putText(role, r, s.role);
+        putText(shirt, r, s.shirtSize);
+        putText(shoe, r, s.shoeSize);
+        putNumber<uint8_t>(active, s.active);
+        putNumber<int32_t>(hours, c.creditHours);
+        putNumber<double>(gpa, c.gpa);
+        putNumber<uint8_t>(dues, c.duesPaid);
+        putNumber<uint8_t>(eligible, c.eligible());
+        putText(verified, r, c.lastVerified);
+    }
+    set.rows = rows.size();
+}
+
+static bool buildStudents(Database& db, ColumnSet& set) {
+    vector<StudentProfile> rows;
+    if (!StudentRepo(db).list(rows)) return false;
+    studentColumns(rows, set);
+    return true;
+}
+
+static void instrumentColumns(const vector<Instrument>& rows, ColumnSet& set) {
+    Column& id = set.add("id", 'i');
+    Column& type = set.add("type", 's');
+    Column& section = set.add("section", 's');
+    Column& serial = set.add("serial", 's');
+    Column& notes = set.add("notes", 's');
+    Column& student = set.add("student_id", 'i');
+    Column& date = set.add("date", 's');
+    Column& out = set.add("checked_out", 'B');
+
+    for (size_t r = 0; r < rows.size(); r++) {
+        const Instrument& i = rows[r];
+        putNumber<int32_t>(id, i.id);
+        putText(type, r, i.type);
+        putText(section, r, i.section);
+        putText(serial, r, i.serial);
+        putText(notes, r, i.notes);
+        putNumber<int32_t>(student, i.studentId);
+        putText(date, r, i.date);
+        putNumber<uint8_t>(out, i.checkedOut);
+    }
+    set.rows = rows.size();
+}
+
+// Catalog order (SECTION, TYPE_NAME), then ID, checked out or not.
+static bool buildInstruments(Database& db, ColumnSet& set) {
+    vector<Instrument> rows;
+    if (!InventoryRepo(db).instruments(Holding::All, rows)) return false;
+    sort(rows.begin(), rows.end(), [](const Instrument& a, const Instrument& b) {
+        return a.rank != b.rank ? a.rank < b.rank : a.id < b.id;
+    });
+    instrumentColumns(rows, set);
+    return true;
+}
+
+static void uniformColumns(const vector<Uniform>& rows, ColumnSet& set) {
+    Column& id = set.add("id", 'i');
+    Column& coat = set.add("coat_size", 's');
+    Column& pant = set.add("pant_size", 's');
+    Column& coatNo = set.add("coat_number", 's');
+    Column& pantNo = set.add("pant_number", 's');
+    Column& notes = set.add("notes", 's');
+    Column& student = set.add("student_id", 'i');
+    Column& date = set.add("date", 's');
+    Column& out = set.add("checked_out", 'B');
+
+    for (size_t r = 0; r < rows.size(); r++) {
+        const Uniform& u = rows[r];
+        putNumber<int32_t>(id, u.id);
+        putText(coat, r, u.coatSize);
+        putText(pant, r, u.pantSize);
+        putText(coatNo, r, u.coatNumber);
+        putText(pantNo, r, u.pantNumber);
+        putText(notes, r, u.notes);
+        putNumber<int32_t>(student, u.studentId);
+        putText(date, r, u.date);
+        putNumber<uint8_t>(out, u.checkedOut);
+    }
+    set.rows = rows.size();
+}
+
+static bool buildUniforms(Database& db, ColumnSet& set) {
+    vector<Uniform> rows;
+    if (!InventoryRepo(db).uniforms(Holding::All, rows)) return false;
+    uniformColumns(rows, set);
+    return true;
+}
+
+static void shakoColumns(const vector<Shako>& rows, ColumnSet& set) {
+    Column& id = set.add("id", 'i');
+    Column& size = set.add("size", 's');
+    Column& notes = set.add("notes", 's');
+    Column& student = set.add("student_id", 'i');
+    Column& date = set.add("date", 's');
+    Column& out = set.add("checked_out", 'B');
+
+    for (size_t r = 0; r < rows.size(); r++) {
+        const Shako& s = rows[r];
+        putNumber<int32_t>(id, s.id);
+        putText(size, r, s.size);
+        putText(notes, r, s.notes);
+        putNumber<int32_t>(student, s.studentId);
+        putText(date, r, s.date);
+        putNumber<uint8_t>(out, s.checkedOut);
+    }
+    set.rows = rows.size();
+}
+
+static bool buildShakos(Database& db, ColumnSet& set) {
+    vector<Shako> rows;
+    if (!InventoryRepo(db).shakos(Holding::All, rows)) return false;
+    shakoColumns(rows, set);
+    return true;
+}
+
+static bool buildTypes(Database& db, ColumnSet& set) {
+    if (!db.loadInstrumentTypes()) return false;
+    const vector<InstrumentType>& types = db.instrumentTypes();
+
+    Column& id = set.add("id", 'i');
+    Column& name = set.add("name", 's');
+    Column& section = set.add("section", 's');
+    for (size_t r = 0; r < types.size(); r++) {
+        putNumber<int32_t>(id, types[r].id);
+        putText(name, r, types[r].name);
+        putText(section, r, types[r].section);
+    }
+    set.rows = types.size();
+    return true;
+}
+
+static PyObject* cachedList(EngineObject* self, CachedList which, bool (*build)(Database&, ColumnSet&)) {
+    bool cached = self->cache[which] != nullptr;
+    sqlite3_int64 cachedVersion = self->cacheVersion[which], cachedChanges = self->cacheChanges[which];
+
+    sqlite3_int64 version, changes;
+    ColumnSet set;
+    bool fresh = false;
+    if (!runLocked(self, [&](Database& db) {
+            version = db.dataVersion();
+            changes = db.totalChanges();
+            fresh = cached && version != -1 && cachedVersion == version && cachedChanges == changes;
+            return fresh || build(db, set);
+        }))
+        return nullptr;
+
+    // A close() or re-init from another thread may have dropped the entry
+    // meanwhile; asking again sorts out which.
+    if (fresh) {
+        if (!self->cache[which]) return cachedList(self, which, build);
+        Py_INCREF(self->cache[which]);
+        return self->cache[which];
+    }
+    PyObject* result = toPython(set);
+    if (!result) return nullptr;
+    Py_XSETREF(self->cache[which], result);
+    Py_INCREF(result);
+    self->cacheVersion[which] = version;
+    self->cacheChanges[which] = changes;
+    return result;
+}
+
+static PyObject* Engine_students(EngineObject* self, PyObject*) {
+    return cachedList(self, LIST_STUDENTS, buildStudents);
+}
+
+static PyObject* Engine_instruments(EngineObject* self, PyObject*) {
+    return cachedList(self, LIST_INSTRUMENTS, buildInstruments);
+}
+
+static PyObject* Engine_uniforms(EngineObject* self, PyObject*) {
+    return cachedList(self, LIST_UNIFORMS, buildUniforms);
+}
+
+static PyObject* Engine_shakos(EngineObject* self, PyObject*) {
+    return cachedList(self, LIST_SHAKOS, buildShakos);
+}
+
+static PyObject* Engine_instrument_types(EngineObject* self, PyObject*) {
+    return cachedList(self, LIST_TYPES, buildTypes);
+}
+
+// ---------- Writes ----------
+static PyObject* Engine_add_student(EngineObject* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[] = {"student_id", "fname", "lname", "classification", "section",
+                                   "shirt_size", "shoe_size", nullptr};
+    Student s;
+    const char *fname, *lname, *cls = "", *section, *shirt = "", *shoe = "";
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "isss|sss", (char**)kwlist, &s.id, &fname, &lname,
+                                     &section, &cls, &shirt, &shoe))
+        return nullptr;
+    s.fname = fname;
+    s.lname = lname;
+    s.classification = cls;
+    s.section = upperCopy(section);
+    s.shirtSize = shirt;
+    s.shoeSize = shoe;
+
+    if (!runLocked(self, [&](Database& db) { return StudentRepo(db).add(s); })) return nullptr;
+    Py_RETURN_NONE;
+}
+
+static PyObject* Engine_update_compliance(EngineObject* self, PyObject* args) {
+    int id, hours, dues;
+    double gpa;
+    if (!PyArg_ParseTuple(args, "iidp", &id, &hours, &gpa, &dues)) return nullptr;
+    return outcomeResult(self, [&](Database& db) { return ComplianceRepo(db).update(id, hours, gpa, dues != 0); });
+}
+
+static PyObject* Engine_set_section_leader(EngineObject* self, PyObject* args) {
+    const char* section;
+    int id;
+    if (!PyArg_ParseTuple(args, "si", &section, &id)) return nullptr;
+    string sec = upperCopy(section);
+    return outcomeResult(self, [&](Database& db) { return StudentRepo(db).setSectionLeader(sec, id); });
+}
+
+static PyObject* Engine_checkout_instrument(EngineObject* self, PyObject* args) {
+    int instrumentId, studentId;
+    if (!PyArg_ParseTuple(args, "ii", &instrumentId, &studentId)) return nullptr;
+    return outcomeResult(self, [&](Database& db) {
+        return InventoryRepo(db).checkoutInstrument(instrumentId, studentId);
+    });
+}
+
+// return_instrument / return_uniform / return_shako
+static PyObject* returnItem(EngineObject* self, PyObject* args, Outcome (InventoryRepo::*ret)(int)) {
+    int itemId;
+    if (!PyArg_ParseTuple(args, "i", &itemId)) return nullptr;
+    return outcomeResult(self, [&](Database& db) {
+        InventoryRepo inventory(db);
+        return (inventory.*ret)(itemId);
+    });
+}
+
+static PyObject* Engine_return_instrument(EngineObject* self, PyObject* args) {
+    return returnItem(self, args, &InventoryRepo::returnInstrument);
+}
+
+static PyObject* Engine_return_uniform(EngineObject* self, PyObject* args) {
+    return returnItem(self, args, &InventoryRepo::returnUniform);
+}
+
+static PyObject* Engine_return_shako(EngineObject* self, PyObject* args) {
+    return returnItem(self, args, &InventoryRepo::returnShako);
+}
+
+// ---------- Imports ----------
+static PyObject* importResult(const ImportResult& r) {
+    PyObject* errors = PyList_New((Py_ssize_t)r.errors.size());
+    if (!errors) return nullptr;
+    for (size_t i = 0; i < r.errors.size(); i++) {
+        PyObject* e = Py_BuildValue("(ns)", (Py_ssize_t)r.errors[i].line, r.errors[i].message.c_str());
+        if (!e) {
+            Py_DECREF(errors);
+            return nullptr;
+        }
+        PyList_SET_ITEM(errors, (Py_ssize_t)i, e);
+    }
+    return Py_BuildValue("{s:n,s:n,s:n,s:n,s:d,s:d,s:d,s:n,s:n,s:n,s:n,s:N}",
+                         "added", (Py_ssize_t)r.added,
+                         "parsed", (Py_ssize_t)r.parsed,
+                         "duplicates", (Py_ssize_t)r.duplicates,
+                         "unknown_ids", (Py_ssize_t)r.unknownIds.size(),
+                         "parse_seconds", r.parseSec,
+                         "write_seconds", r.writeSec,
+                         "wait_seconds", r.waitSec,
+                         "commits", (Py_ssize_t)r.commits,
+                         "keys_cleared", (Py_ssize_t)r.keysCleared,
+                         "keys_probed", (Py_ssize_t)r.keysProbed,
+                         "false_positives", (Py_ssize_t)r.falsePositives,
+                         "errors", errors);
+}
+
+static PyObject* Engine_import_roster(EngineObject* self, PyObject* args) {
+    const char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) return nullptr;
+    string file = path;
+    ImportResult r;
+    if (!runLocked(self, [&](Database& db) { return StudentRepo(db).importFile(file, r); })) return nullptr;
+    return importResult(r);
+}
+
+static PyObject* Engine_import_compliance(EngineObject* self, PyObject* args) {
+    const char* path;
+    unsigned threads = 0;
+    if (!PyArg_ParseTuple(args, "s|I", &path, &threads)) return nullptr;
+    string file = path;
+    ImportResult r;
+    if (!runLocked(self, [&](Database& db) { return ComplianceRepo(db).importFile(file, threads, r); }))
+        return nullptr;
+    return importResult(r);
+}
+
+// import_inventory(path, kind) with kind "instruments", "uniforms" or "shakos".
+static PyObject* Engine_import_inventory(EngineObject* self, PyObject* args) {
+    const char* path;
+    const char* kindName;
+    if (!PyArg_ParseTuple(args, "ss", &path, &kindName)) return nullptr;
+
+    string k = kindName;
+    InventoryKind kind;
+    if (k == "instruments") kind = InventoryKind::Instruments;
+    else if (k == "uniforms") kind = InventoryKind::Uniforms;
+    else if (k == "shakos") kind = InventoryKind::Shakos;
+    else {
+        PyErr_Format(PyExc_ValueError, "unknown inventory kind '%s'", kindName);
+        return nullptr;
+    }
+
+    string file = path;
+    ImportResult r;
+    if (!runLocked(self, [&](Database& db) { return InventoryRepo(db).importFile(file, kind, r); }))
+        return nullptr;
+    return importResult(r);
+}
+
+// ---------- Change feed ----------
+static PyObject* idList(const vector<int>& ids) {
+    PyObject* list = PyList_New((Py_ssize_t)ids.size());
+    if (!list) return nullptr;
+    for (size_t i = 0; i < ids.size(); i++) {
+        PyObject* id = PyLong_FromLong(ids[i]);
+        if (!id) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, (Py_ssize_t)i, id);
+    }
+    return list;
+}
+
+static PyObject* Engine_change_version(EngineObject* self, PyObject*) {
+    sqlite3_int64 epoch, version;
+    if (!runLocked(self, [&](Database& db) { return ChangeFeed(db).version(epoch, version); })) return nullptr;
+    return Py_BuildValue("(LL)", (long long)epoch, (long long)version);
+}
+
+// changes(epoch, since) -> None when the caller has to reload everything,
+// else a dict with the new "version", changed rows per list in the same
+// column layout as the list calls, and removed IDs under "<list>_removed".
+static PyObject* Engine_changes(EngineObject* self, PyObject* args) {
+    long long epoch, since;
+    if (!PyArg_ParseTuple(args, "LL", &epoch, &since)) return nullptr;
+
+    ChangeSet changes;
+    ColumnSet lists[4];
+    if (!runLocked(self, [&](Database& db) {
+            if (!ChangeFeed(db).since(epoch, since, changes)) return false;
+            if (!changes.reload) {
+                studentColumns(changes.students, lists[0]);
+                instrumentColumns(changes.instruments, lists[1]);
+                uniformColumns(changes.uniforms, lists[2]);
+                shakoColumns(changes.shakos, lists[3]);
+            }
+            return true;
+        }))
+        return nullptr;
+    if (changes.reload) Py_RETURN_NONE;
+
+    PyObject* parts[8] = {
+        toPython(lists[0]), idList(changes.removedStudents),
+        toPython(lists[1]), idList(changes.removedInstruments),
+        toPython(lists[2]), idList(changes.removedUniforms),
+        toPython(lists[3]), idList(changes.removedShakos),
+    };
+    for (PyObject* part : parts) {
+        if (part) continue;
+        for (PyObject* built : parts) Py_XDECREF(built);
+        return nullptr;
+    }
+    // N hands each part over to the dict, on failure too.
+    return Py_BuildValue("{s:L,s:N,s:N,s:N,s:N,s:N,s:N,s:N,s:N}",
+                         "version", (long long)changes.version,
+                         "students", parts[0],
+                         "students_removed", parts[1],
+                         "instruments", parts[2],
+                         "instruments_removed", parts[3],
+                         "uniforms", parts[4],
+                         "uniforms_removed", parts[5],
+                         "shakos", parts[6],
+                         "shakos_removed", parts[7]);
+}
+
+// undo() / redo() -> label of the change stepped over, or None when there is
+// nothing to step over. Raises banddb.Error when a row changed since.
+static PyObject* stepJournal(EngineObject* self, bool redoing) {
+    string label;
+    Outcome o = Outcome::Failed;
+    if (!runLocked(self, [&](Database& db) {
+            o = redoing ? db.undo().redo(label) : db.undo().undo(label);
+            return o != Outcome::Failed;
+        }))
+        return nullptr;
+    if (o == Outcome::NotFound) Py_RETURN_NONE;
+    return PyUnicode_FromStringAndSize(label.data(), (Py_ssize_t)label.size());
+}
+
+static PyObject* Engine_undo(EngineObject* self, PyObject*) {
+    return stepJournal(self, false);
+}
+
+static PyObject* Engine_redo(EngineObject* self, PyObject*) {
+    return stepJournal(self, true);
+}
+
+static PyObject* Engine_data_version(EngineObject* self, PyObject*) {
+    sqlite3_int64 version, changes;
+    if (!runLocked(self, [&](Database& db) {
+            version = db.dataVersion();
+            changes = db.totalChanges();
+            return true;
+        }))
+        return nullptr;
+    return Py_BuildValue("(LL)", (long long)version, (long long)changes);
+}
+
+static PyMethodDef Engine_methods[] = {
+    {"close", (PyCFunction)Engine_close, METH_NOARGS, "Close the database."},
+    {"students", (PyCFunction)Engine_students, METH_NOARGS,
+     "All students with compliance, by SECTION, LNAME, FNAME, as (rows, columns)."},
+    {"instruments", (PyCFunction)Engine_instruments, METH_NOARGS,
+     "All instruments in catalog order, as (rows, columns)."},
+    {"uniforms", (PyCFunction)Engine_uniforms, METH_NOARGS,
+     "All uniforms, available first, as (rows, columns)."},
+    {"shakos", (PyCFunction)Engine_shakos, METH_NOARGS,
+     "All shakos, available first, as (rows, columns)."},
+    {"instrument_types", (PyCFunction)Engine_instrument_types, METH_NOARGS,
+     "The instrument type catalog by SECTION, TYPE_NAME, as (rows, columns)."},
+    {"add_student", (PyCFunction)(void (*)(void))Engine_add_student, METH_VARARGS | METH_KEYWORDS,
+     "add_student(id, fname, lname, section, classification='', shirt_size='', shoe_size='')"},
+    {"update_compliance", (PyCFunction)Engine_update_compliance, METH_VARARGS,
+     "update_compliance(id, credit_hours, gpa, dues_paid) -> False if no such student."},
+    {"set_section_leader", (PyCFunction)Engine_set_section_leader, METH_VARARGS,
+     "set_section_leader(section, id) -> False if no such student."},
+    {"checkout_instrument", (PyCFunction)Engine_checkout_instrument, METH_VARARGS,
+     "checkout_instrument(instrument_id, student_id) -> False if taken or missing."},
+    {"return_instrument", (PyCFunction)Engine_return_instrument, METH_VARARGS,
+     "return_instrument(instrument_id) -> False if no such instrument."},
+    {"return_uniform", (PyCFunction)Engine_return_uniform, METH_VARARGS,
+     "return_uniform(uniform_id) -> False if no such uniform."},
+    {"return_shako", (PyCFunction)Engine_return_shako, METH_VARARGS,
+     "return_shako(shako_id) -> False if no such shako."},
+    {"import_roster", (PyCFunction)Engine_import_roster, METH_VARARGS,
+     "import_roster(path) -> dict with added and errors."},
+    {"import_compliance", (PyCFunction)Engine_import_compliance, METH_VARARGS,
+     "import_compliance(path, threads=0) -> dict with added, unknown_ids and errors."},
+    {"import_inventory", (PyCFunction)Engine_import_inventory, METH_VARARGS,
+     "import_inventory(path, 'instruments'|'uniforms'|'shakos') -> dict."},
+    {"change_version", (PyCFunction)Engine_change_version, METH_NOARGS,
+     "(epoch, latest CHANGE_LOG version); read it before a full load, pass both to changes() after."},
+    {"changes", (PyCFunction)Engine_changes, METH_VARARGS,
+     "changes(epoch, since) -> dict of rows changed and IDs removed since, or None to reload."},
+    {"undo", (PyCFunction)Engine_undo, METH_NOARGS,
+     "Undo the newest journaled write; returns its label, or None."},
+    {"redo", (PyCFunction)Engine_redo, METH_NOARGS,
+     "Redo the newest undone write; returns its label, or None."},
+    {"data_version", (PyCFunction)Engine_data_version, METH_NOARGS,
+     "(PRAGMA data_version, total_changes); moves whenever the database does."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyType_Slot Engine_slots[] = {
+    {Py_tp_doc, (void*)"Engine(path='band.db', durability='normal', checkpoint='off', undo_log=False, commit='auto')"},
+    {Py_tp_new, (void*)Engine_new},
+    {Py_tp_init, (void*)Engine_init},
+    {Py_tp_dealloc, (void*)Engine_dealloc},
+    {Py_tp_methods, Engine_methods},
+    {0, nullptr}
+};
+
+static PyType_Spec Engine_spec = {
+    "banddb.Engine",
+    sizeof(EngineObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Engine_slots,
+};
+
+static PyModuleDef banddbModule = {
+    PyModuleDef_HEAD_INIT,
+    "banddb",
+    "Marching band database engine (libbanddb).",
+    -1,
+    nullptr,    // methods
+    nullptr,    // slots
+    nullptr,    // traverse
+    nullptr,    // clear
+    nullptr,    // free
+};
+
+PyMODINIT_FUNC PyInit_banddb(void) {
+    PyObject* m = PyModule_Create(&banddbModule);
+    if (!m) return nullptr;
+
+    PyObject* engineType = PyType_FromSpec(&Engine_spec);
+    EngineError = PyErr_NewException("banddb.Error", nullptr, nullptr);
+    Py_XINCREF(EngineError);
+    if (!engineType || !EngineError ||
+        PyModule_AddObject(m, "Engine", engineType) < 0) {
+        Py_XDECREF(engineType);
+        Py_XDECREF(EngineError);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    if (PyModule_AddObject(m, "Error", EngineError) < 0) {
+        Py_DECREF(EngineError);
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}
@@ -15,6 +15,13 @@ from PySide6.QtWidgets import (
     QGraphicsDropShadowEffect, QCompleter, QStyle, QFrame
 )
 
+# Optional C++ engine (cpp-console-vers/banddb_python.cpp). When it is built
+# next to this file the tables load through it; otherwise through SQL below.
+try:
+    import banddb
+except ImportError:
+    banddb = None
+
 DB_PATH = "band.db"
 
 SECTIONS = ["WOODWIND", "BRASS", "PERCUSSION", "FLAG CORP", "DRUM MAJOR", "OTHER"]
@@ -163,6 +170,89 @@ def make_table_item(text, align_right=False, align_center=False):
 
     return item
 
+def open_engine():
+    if banddb is None:
+        return None
+    try:
+        return banddb.Engine(DB_PATH)
+    except banddb.Error:
+        return None
+
+def engine_rows(result, names):
+    """Turn a banddb (rows, columns) result into row tuples of the named columns."""
+    count, cols = result
+    out = []
+    for name in names:
+        code, buf = cols[name]
+        if code == "s":
+            out.append(buf.decode().split("\0") if count else [])
+        else:
+            out.append(memoryview(buf).cast(code).tolist())
+    return list(zip(*out))
+
+def text_matches(q, *fields):
+    # Same test as the SQL searches: case-insensitive LIKE '%q%'
+    q = q.lower()
+    return any(q in str(f).lower() for f in fields)
+
+# Row tuples below have the shape the load_* queries select, whichever path
+# produced them.
+def student_tuples(result):
+    return engine_rows(result, [
+        "id", "fname", "lname", "classification", "section", "role",
+        "shirt_size", "shoe_size", "active", "credit_hours", "gpa", "dues_paid"
+    ])
+
+def uniform_tuples(result):
+    return [
+        (uid, coat, pant, coatn, pantn, notes, sid if out else "", dt, "No" if out else "Yes")
+        for uid, coat, pant, coatn, pantn, notes, sid, dt, out in engine_rows(result, [
+            "id", "coat_size", "pant_size", "coat_number", "pant_number", "notes",
+            "student_id", "date", "checked_out"
+        ])
+    ]
+
+def shako_tuples(result):
+    return [
+        (sid, size, notes, student if out else "", dt, "No" if out else "Yes")
+        for sid, size, notes, student, dt, out in engine_rows(result, [
+            "id", "size", "notes", "student_id", "date", "checked_out"
+        ])
+    ]
+
+def instrument_tuples(result):
+    return [
+        (iid, typ, section, serial, notes, sid if out else "", dt, "No" if out else "Yes")
+        for iid, typ, section, serial, notes, sid, dt, out in engine_rows(result, [
+            "id", "type", "section", "serial", "notes", "student_id", "date", "checked_out"
+        ])
+    ]
+
+def student_visible(r, q, active_only):
+    return (not active_only or r[8] == 1) and (not q or text_matches(q, r[0], r[1], r[2], r[4], r[5]))
+
+def uniform_visible(r, q):
+    return not q or text_matches(q, *r[1:7])
+
+def shako_visible(r, q):
+    return not q or text_matches(q, *r[1:4])
+
+def instrument_visible(r, q, sec):
+    return (sec == "All Sections" or r[2] == sec) and (not q or text_matches(q, r[1], r[3], r[4], r[5]))
+
+# Sort keys matching each load_* ORDER BY, ignoring the ID tiebreak.
+def student_order(r):
+    return (r[4], r[2], r[1])
+
+def uniform_order(r):
+    return r[8]
+
+def shako_order(r):
+    return r[5]
+
+def instrument_order(r):
+    return (r[2], r[1])
+
 def is_eligible(credit_hours, gpa, dues_paid):
     return credit_hours >= 12 and gpa >= 3.0 and dues_paid == 1
 
@@ -609,6 +699,10 @@ class BandDatabaseApp(QMainWindow):
         self.conn = connect_db()
         create_tables(self.conn)
         seed_sample_data(self.conn)
+        self.engine = open_engine()
+        self.feed_epoch = 0
+        self.feed_version = 0
+        self.shown = {}
 
         self.students_requires_school_year = (
             table_has_column(self.conn, "STUDENTS", "SCHOOL_YEAR") and
@@ -1082,6 +1176,8 @@ class BandDatabaseApp(QMainWindow):
             self.conn.close()
         except Exception:
             pass
+        if self.engine:
+            self.engine.close()
         try:
             if os.path.exists(DB_PATH):
                 os.remove(DB_PATH)
@@ -1089,10 +1185,13 @@ class BandDatabaseApp(QMainWindow):
             self.show_error(f"Could not remove database file: {str(e)}")
             self.conn = connect_db()
             create_tables(self.conn)
+            self.engine = open_engine()
             return
 
         self.conn = connect_db()
         create_tables(self.conn)
+        self.engine = open_engine()
+        self.shown = {}
         self.undo_stack.clear()
         self.refresh_all()
         self.rebuild_completers()
@@ -1366,7 +1465,10 @@ Accessibility:
 
         where_sql = ("WHERE " + " AND ".join(where)) if where else ""
 
-        cur = self.conn.execute(f"""
+        if self.engine:
+            rows = self.engine_students(q, active_only)
+        else:
+            rows = self.conn.execute(f"""
             SELECT s.STUDENT_ID, s.FNAME, s.LNAME,
                    COALESCE(s.CLASSIFICATION,''), COALESCE(s.SECTION,''),
                    COALESCE(s.PRIMARY_ROLE,''), COALESCE(s.SHIRT_SIZE,''), COALESCE(s.SHOE_SIZE,''),
@@ -1376,31 +1478,37 @@ Accessibility:
             LEFT JOIN COMPLIANCE c ON s.STUDENT_ID = c.STUDENT_ID
             {where_sql}
             ORDER BY s.SECTION, s.LNAME, s.FNAME
-        """, params)
+        """, params).fetchall()
 
-        rows = cur.fetchall()
         self.students_table.setRowCount(0)
         for r in rows:
-            sid, fn, ln, cl, sec, role, shirt, shoe, active, credits, gpa, dues = r
-            eligible = is_eligible(credits, gpa, dues)
-
             row = self.students_table.rowCount()
             self.students_table.insertRow(row)
-            self.students_table.setItem(row, 0, make_table_item(sid, True))
-            self.students_table.setItem(row, 1, make_table_item(fn))
-            self.students_table.setItem(row, 2, make_table_item(ln))
-            self.students_table.setItem(row, 3, make_table_item(cl))
-            self.students_table.setItem(row, 4, make_table_item(sec))
-            self.students_table.setItem(row, 5, make_table_item(role))
-            self.students_table.setItem(row, 6, make_table_item(shirt))
-            self.students_table.setItem(row, 7, make_table_item(shoe))
-            self.students_table.setItem(row, 8, make_table_item("Yes" if active == 1 else "No"))
-            self.students_table.setItem(row, 9, make_table_item("YES" if eligible else "NO", align_center=True))
+            self.fill_student_row(row, r)
+        self.shown["students"] = {r[0]: (i, student_order(r)) for i, r in enumerate(rows)}
 
         self.students_table.resizeColumnsToContents()
         self.update_status(f"Loaded {len(rows)} students")
         self.rebuild_completers()
 
+    def fill_student_row(self, row, r):
+        sid, fn, ln, cl, sec, role, shirt, shoe, active, credits, gpa, dues = r
+        eligible = is_eligible(credits, gpa, dues)
+
+        self.students_table.setItem(row, 0, make_table_item(sid, True))
+        self.students_table.setItem(row, 1, make_table_item(fn))
+        self.students_table.setItem(row, 2, make_table_item(ln))
+        self.students_table.setItem(row, 3, make_table_item(cl))
+        self.students_table.setItem(row, 4, make_table_item(sec))
+        self.students_table.setItem(row, 5, make_table_item(role))
+        self.students_table.setItem(row, 6, make_table_item(shirt))
+        self.students_table.setItem(row, 7, make_table_item(shoe))
+        self.students_table.setItem(row, 8, make_table_item("Yes" if active == 1 else "No"))
+        self.students_table.setItem(row, 9, make_table_item("YES" if eligible else "NO", align_center=True))
+
+    def engine_students(self, q, active_only):
+        return [r for r in student_tuples(self.engine.students()) if student_visible(r, q, active_only)]
+
     def jump_to_student(self):
         sid = self.find_id.text().strip()
         if not sid.isdigit():
@@ -1755,7 +1863,10 @@ Accessibility:
                        OR COALESCE(CONDITION_NOTES,'') LIKE ? OR COALESCE(CHECKED_OUT_TO,'') LIKE ?"""
             params = [f"%{q}%"] * 6
 
-        cur = self.conn.execute(f"""
+        if self.engine:
+            rows = self.engine_uniforms(q)
+        else:
+            rows = self.conn.execute(f"""
             SELECT UNIFORM_ID, COALESCE(COAT_SIZE,''), COALESCE(PANT_SIZE,''),
                    COALESCE(COAT_NUMBER,''), COALESCE(PANT_NUMBER,''),
                    COALESCE(CONDITION_NOTES,''),
@@ -1764,18 +1875,22 @@ Accessibility:
             FROM UNIFORMS
             {where}
             ORDER BY (CHECKED_OUT_TO IS NULL) DESC, UNIFORM_ID
-        """, params)
+        """, params).fetchall()
 
         self.uniforms_table.setRowCount(0)
-        for r in cur.fetchall():
+        for r in rows:
             row = self.uniforms_table.rowCount()
             self.uniforms_table.insertRow(row)
             for c in range(9):
                 self.uniforms_table.setItem(row, c, make_table_item(r[c]))
+        self.shown["uniforms"] = {r[0]: (i, uniform_order(r)) for i, r in enumerate(rows)}
 
         self.uniforms_table.resizeColumnsToContents()
         self.update_status(f"Loaded {self.uniforms_table.rowCount()} uniforms")
 
+    def engine_uniforms(self, q):
+        return [r for r in uniform_tuples(self.engine.uniforms()) if uniform_visible(r, q)]
+
     def add_uniform(self):
         coat = self.coat_size.text().strip() or None
         pant = self.pant_size.text().strip() or None
@@ -1981,25 +2096,32 @@ Accessibility:
             where = "WHERE COALESCE(SIZE,'') LIKE ? OR COALESCE(CONDITION_NOTES,'') LIKE ? OR COALESCE(CHECKED_OUT_TO,'') LIKE ?"
             params = [f"%{q}%"] * 3
 
-        cur = self.conn.execute(f"""
+        if self.engine:
+            rows = self.engine_shakos(q)
+        else:
+            rows = self.conn.execute(f"""
             SELECT SHAKO_ID, COALESCE(SIZE,''), COALESCE(CONDITION_NOTES,''),
                    COALESCE(CHECKED_OUT_TO,''), COALESCE(CHECKED_OUT_DATE,''),
                    CASE WHEN CHECKED_OUT_TO IS NULL THEN 'Yes' ELSE 'No' END
             FROM SHAKOS
             {where}
             ORDER BY (CHECKED_OUT_TO IS NULL) DESC, SHAKO_ID
-        """, params)
+        """, params).fetchall()
 
         self.shakos_table.setRowCount(0)
-        for r in cur.fetchall():
+        for r in rows:
             row = self.shakos_table.rowCount()
             self.shakos_table.insertRow(row)
             for c in range(6):
                 self.shakos_table.setItem(row, c, make_table_item(r[c]))
+        self.shown["shakos"] = {r[0]: (i, shako_order(r)) for i, r in enumerate(rows)}
 
         self.shakos_table.resizeColumnsToContents()
         self.update_status(f"Loaded {self.shakos_table.rowCount()} shakos")
 
+    def engine_shakos(self, q):
+        return [r for r in shako_tuples(self.engine.shakos()) if shako_visible(r, q)]
+
     def add_shako(self):
         size = self.shako_size.text().strip() or None
         cond = self.shako_condition.text().strip() or None
@@ -2213,7 +2335,10 @@ Accessibility:
 
         where_sql = ("WHERE " + " AND ".join(where)) if where else ""
 
-        cur = self.conn.execute(f"""
+        if self.engine:
+            rows = self.engine_instruments(q, sec)
+        else:
+            rows = self.conn.execute(f"""
             SELECT i.INSTRUMENT_ID, t.TYPE_NAME, t.SECTION,
                    COALESCE(i.SERIAL,''), COALESCE(i.CONDITION_NOTES,''),
                    COALESCE(i.CHECKED_OUT_TO,''), COALESCE(i.CHECKED_OUT_DATE,''),
@@ -2222,18 +2347,22 @@ Accessibility:
             JOIN INSTRUMENT_TYPES t ON i.TYPE_ID=t.TYPE_ID
             {where_sql}
             ORDER BY t.SECTION, t.TYPE_NAME, i.INSTRUMENT_ID
-        """, params)
+        """, params).fetchall()
 
         self.instruments_table.setRowCount(0)
-        for r in cur.fetchall():
+        for r in rows:
             row = self.instruments_table.rowCount()
             self.instruments_table.insertRow(row)
             for c in range(8):
                 self.instruments_table.setItem(row, c, make_table_item(r[c]))
+        self.shown["instruments"] = {r[0]: (i, instrument_order(r)) for i, r in enumerate(rows)}
 
         self.instruments_table.resizeColumnsToContents()
         self.update_status(f"Loaded {self.instruments_table.rowCount()} instruments")
 
+    def engine_instruments(self, q, sec):
+        return [r for r in instrument_tuples(self.engine.instruments()) if instrument_visible(r, q, sec)]
+
     def add_instrument(self):
         tid = self.instrument_type_combo.currentData()
         if not tid:
@@ -2356,11 +2485,76 @@ Accessibility:
             self.show_error(f"Error: {str(e)}")
 
     def refresh_all(self):
+        if self.engine and self.refresh_changes():
+            return
+        if self.engine:
+            self.feed_epoch, self.feed_version = self.engine.change_version()
         self.load_students()
         self.load_uniforms()
         self.load_shakos()
         self.load_instruments()
 
+    def refresh_changes(self):
+        """Apply only the rows changed since the last refresh. False means reload everything."""
+        if len(self.shown) < 4:
+            return False
+        ch = self.engine.changes(self.feed_epoch, self.feed_version)
+        if ch is None:
+            return False
+
+        q = self.student_search.text().strip()
+        active_only = self.active_only.isChecked()
+        students = student_tuples(ch["students"])
+        if not self.patch_rows("students", students, ch["students_removed"],
+                               lambda r: student_visible(r, q, active_only), student_order,
+                               self.fill_student_row):
+            self.load_students()
+        elif students or ch["students_removed"]:
+            self.rebuild_completers()
+
+        q = self.uniform_search.text().strip()
+        if not self.patch_rows("uniforms", uniform_tuples(ch["uniforms"]), ch["uniforms_removed"],
+                               lambda r: uniform_visible(r, q), uniform_order,
+                               lambda row, r: self.fill_row(self.uniforms_table, row, r)):
+            self.load_uniforms()
+
+        q = self.shako_search.text().strip()
+        if not self.patch_rows("shakos", shako_tuples(ch["shakos"]), ch["shakos_removed"],
+                               lambda r: shako_visible(r, q), shako_order,
+                               lambda row, r: self.fill_row(self.shakos_table, row, r)):
+            self.load_shakos()
+
+        q = self.instrument_search.text().strip()
+        sec = self.section_filter.currentText()
+        if not self.patch_rows("instruments", instrument_tuples(ch["instruments"]), ch["instruments_removed"],
+                               lambda r: instrument_visible(r, q, sec), instrument_order,
+                               lambda row, r: self.fill_row(self.instruments_table, row, r)):
+            self.load_instruments()
+
+        self.feed_version = ch["version"]
+        return True
+
+    def patch_rows(self, name, rows, removed, visible, order, fill):
+        """Rewrite changed rows where they sit. False when a row has to appear,
+        disappear or move, which the caller handles by reloading the table."""
+        shown = self.shown.get(name)
+        if shown is None or any(i in shown for i in removed):
+            return False
+        for r in rows:
+            at = shown.get(r[0])
+            if at is None:
+                if visible(r):
+                    return False
+            elif not visible(r) or order(r) != at[1]:
+                return False
+            else:
+                fill(at[0], r)
+        return True
+
+    def fill_row(self, table, row, r):
+        for c, value in enumerate(r):
+            table.setItem(row, c, make_table_item(value))
+
 def seed_sample_data(conn):
         """
         Inserts sample data ONLY if the database is empty.